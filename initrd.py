@@ -2,6 +2,16 @@
 
 import os
 import struct
+import sys
+
+# Archive format, see sys/vfs/initrd.cpp
+# Uncompressed data is page aligned so the kernel can serve it in place
+INITRD_MAGIC = 0x44524446 # 'FDRD'
+INITRD_VERSION = 1
+INITRD_COMPRESSED = 1
+PAGE_SIZE = 4096
+
+compress = '--compress' in sys.argv
 
 def objdump(filepath):
 	path = os.path.dirname(filepath)
@@ -21,15 +31,82 @@ def dumpSymbols(filepath):
 	os.chdir(path)
 	os.system(command)
 
+def lz4Length(length):
+	result = b''
+	while length >= 255:
+		result += b'\xff'
+		length -= 255
+
+	return result + struct.pack('<B', length)
+
+def lz4Sequence(literals, offset, matchLength):
+	token = min(len(literals), 15) << 4
+	if matchLength:
+		token |= min(matchLength - 4, 15)
+
+	result = struct.pack('<B', token)
+	if len(literals) >= 15:
+		result += lz4Length(len(literals) - 15)
+
+	result += literals
+
+	if matchLength:
+		result += struct.pack('<H', offset)
+		if matchLength - 4 >= 15:
+			result += lz4Length(matchLength - 19)
+
+	return result
+
+# Greedy LZ4 block compressor, the kernel only implements the decoder
+def lz4Compress(data):
+	out = b''
+	table = {}
+	anchor = 0
+	i = 0
+	limit = len(data) - 12 # The last 5 bytes have to be literals and the last match has to start 12 bytes before the end
+
+	while i < limit:
+		key = data[i:i + 4]
+		candidate = table.get(key)
+		table[key] = i
+
+		if candidate is None or i - candidate > 0xffff:
+			i += 1
+			continue
+
+		length = 4
+		while i + length < len(data) - 5 and data[candidate + length] == data[i + length]:
+			length += 1
+
+		out += lz4Sequence(data[anchor:i], i - candidate, length)
+
+		i += length
+		anchor = i
+
+	return out + lz4Sequence(data[anchor:], 0, 0)
+
 def appendFile(out, filepath, path):
 	f = open(filepath, 'rb')
 	b = f.read()
 	f.close()
 
-	path = os.path.join(path, os.path.basename(filepath))
+	path = os.path.join(path, os.path.basename(filepath)).encode('ascii', 'replace')
+
+	flags = 0
+	stored = b
+
+	if compress:
+		compressed = lz4Compress(b)
+		if len(compressed) < len(b):
+			flags = INITRD_COMPRESSED
+			stored = compressed
+
+	out.write(struct.pack('<IIII%is' %(len(path)), len(path), len(b), len(stored), flags, path))
+
+	if not (flags & INITRD_COMPRESSED):
+		out.write(b'\0' * (-out.tell() % PAGE_SIZE))
 
-	out.write(struct.pack('<II%is' %(len(path)), len(path), len(b), path.encode('ascii', 'replace')))
-	out.write(b)
+	out.write(stored)
 
 def scanFolder(out, path, target):
 	for filename in os.listdir(path):
@@ -60,6 +137,7 @@ def appendFolder(out, path, folder):
 
 directory = os.path.dirname(os.path.realpath(__file__))
 out = open(os.path.join(directory, 'boot/initrd'), 'wb')
+out.write(struct.pack('<II', INITRD_MAGIC, INITRD_VERSION))
 
 scanFolder(out, os.path.join(directory, 'build/bin'), '/bin')
 scanFolder(out, os.path.join(directory, 'build/lib'), '/lib')
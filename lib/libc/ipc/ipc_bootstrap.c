@@ -18,26 +18,146 @@
 
 #include "../string.h"
 #include "../sys/kern_return.h"
+#include "../sys/spinlock.h"
 #include "ipc_message.h"
 #include "ipc_port.h"
+#include "ipc_bootstrap.h"
+
+// Lookup cache
+// Maps names to the send rights handed out by the bootstrap server. Entries are
+// dropped when a write to their port fails because the receiver died, or when
+// the right is deallocated
+
+#define IPC_BOOTSTRAP_CACHE_SIZE 32
+#define IPC_BOOTSTRAP_CACHE_NAME_MAX 63
+
+typedef struct
+{
+	char name[IPC_BOOTSTRAP_CACHE_NAME_MAX + 1];
+	ipc_port_t port;
+} ipc_bootstrap_cache_entry_t;
+
+static ipc_bootstrap_cache_entry_t _bootstrapCache[IPC_BOOTSTRAP_CACHE_SIZE];
+static size_t _bootstrapCacheNext = 0;
+static spinlock_t _bootstrapCacheLock = SPINLOCK_INIT;
+
+static ipc_port_t ipc_bootstrap_cache_find(const char *name)
+{
+	ipc_port_t port = IPC_PORT_NULL;
+
+	spinlock_lock(&_bootstrapCacheLock);
+
+	for(size_t i = 0; i < IPC_BOOTSTRAP_CACHE_SIZE; i ++)
+	{
+		if(_bootstrapCache[i].port != IPC_PORT_NULL && strcmp(_bootstrapCache[i].name, name) == 0)
+		{
+			port = _bootstrapCache[i].port;
+			break;
+		}
+	}
+
+	spinlock_unlock(&_bootstrapCacheLock);
+
+	return port;
+}
+
+static void ipc_bootstrap_cache_insert(const char *name, ipc_port_t port)
+{
+	if(strlen(name) > IPC_BOOTSTRAP_CACHE_NAME_MAX)
+		return;
+
+	spinlock_lock(&_bootstrapCacheLock);
+
+	ipc_bootstrap_cache_entry_t *entry = NULL;
+
+	for(size_t i = 0; i < IPC_BOOTSTRAP_CACHE_SIZE; i ++)
+	{
+		if(_bootstrapCache[i].port == IPC_PORT_NULL)
+		{
+			entry = &_bootstrapCache[i];
+			break;
+		}
+	}
+
+	if(!entry)
+	{
+		entry = &_bootstrapCache[_bootstrapCacheNext];
+		_bootstrapCacheNext = (_bootstrapCacheNext + 1) % IPC_BOOTSTRAP_CACHE_SIZE;
+	}
+
+	strlcpy(entry->name, name, sizeof(entry->name));
+	entry->port = port;
+
+	spinlock_unlock(&_bootstrapCacheLock);
+}
+
+static void ipc_bootstrap_cache_remove_name(const char *name)
+{
+	spinlock_lock(&_bootstrapCacheLock);
+
+	for(size_t i = 0; i < IPC_BOOTSTRAP_CACHE_SIZE; i ++)
+	{
+		if(_bootstrapCache[i].port != IPC_PORT_NULL && strcmp(_bootstrapCache[i].name, name) == 0)
+			_bootstrapCache[i].port = IPC_PORT_NULL;
+	}
+
+	spinlock_unlock(&_bootstrapCacheLock);
+}
+
+void ipc_bootstrap_cache_remove_port(ipc_port_t port)
+{
+	spinlock_lock(&_bootstrapCacheLock);
+
+	for(size_t i = 0; i < IPC_BOOTSTRAP_CACHE_SIZE; i ++)
+	{
+		if(_bootstrapCache[i].port == port)
+			_bootstrapCache[i].port = IPC_PORT_NULL;
+	}
+
+	spinlock_unlock(&_bootstrapCacheLock);
+}
+
+void ipc_bootstrap_cache_invalidate(ipc_port_t port)
+{
+	int found = 0;
+
+	spinlock_lock(&_bootstrapCacheLock);
+
+	for(size_t i = 0; i < IPC_BOOTSTRAP_CACHE_SIZE; i ++)
+	{
+		if(_bootstrapCache[i].port == port)
+		{
+			_bootstrapCache[i].port = IPC_PORT_NULL;
+			found = 1;
+		}
+	}
+
+	spinlock_unlock(&_bootstrapCacheLock);
+
+	// The right points to a dead receiver, nothing can be done with it anymore
+	if(found)
+		ipc_deallocate_port(port);
+}
+
+// Server requests
 
 ipc_return_t ipc_bootstrap_register(ipc_port_t port, const char *name)
 {
 	struct
 	{
 		ipc_header_t header;
-		char buffer[255];
+		char buffer[IPC_BOOTSTRAP_NAME_MAX];
 	} message;
 
 	size_t length = strlen(name);
-	if(length > 255)
-		length = 255;
+	if(length > IPC_BOOTSTRAP_NAME_MAX)
+		length = IPC_BOOTSTRAP_NAME_MAX;
 
 	message.header.reply = port;
 	message.header.port = ipc_get_special_port(IPC_SPECIAL_PORT_BOOTSTRAP);
 	message.header.flags = IPC_HEADER_FLAG_RESPONSE | IPC_HEADER_FLAG_RESPONSE_BITS(IPC_MESSAGE_RIGHT_COPY_SEND);
 	message.header.size = length;
-	message.header.id = 0;
+	message.header.id = IPC_BOOTSTRAP_REGISTER;
 
 	memcpy(message.buffer, name, length);
 
@@ -49,24 +169,33 @@ ipc_return_t ipc_bootstrap_unregister(const char *name)
 	struct
 	{
 		ipc_header_t header;
-		char buffer[255];
+		char buffer[IPC_BOOTSTRAP_NAME_MAX];
 	} message;
 
 	size_t length = strlen(name);
-	if(length > 255)
-		length = 255;
+	if(length > IPC_BOOTSTRAP_NAME_MAX)
+		length = IPC_BOOTSTRAP_NAME_MAX;
 
 	message.header.port = ipc_get_special_port(IPC_SPECIAL_PORT_BOOTSTRAP);
 	message.header.size = length;
-	message.header.id = 2;
+	message.header.id = IPC_BOOTSTRAP_UNREGISTER;
 
 	memcpy(message.buffer, name, length);
 
+	ipc_bootstrap_cache_remove_name(name);
+
 	return ipc_write(&message.header);
 }
 
 ipc_return_t ipc_bootstrap_lookup(ipc_port_t *port, const char *name)
 {
+	ipc_port_t cached = ipc_bootstrap_cache_find(name);
+	if(cached != IPC_PORT_NULL)
+	{
+		*port = cached;
+		return KERN_SUCCESS;
+	}
+
 	ipc_port_t replyPort;
 
 	ipc_return_t result = ipc_allocate_port(&replyPort);
@@ -78,20 +207,20 @@ ipc_return_t ipc_bootstrap_lookup(ipc_port_t *port, const char *name)
 		ipc_header_t header;
 		union
 		{
-			char buffer[255];
+			char buffer[IPC_BOOTSTRAP_NAME_MAX];
 			ipc_return_t response;
 		} data;
 	} message;
 
 	size_t length = strlen(name);
-	if(length > 255)
-		length = 255;
+	if(length > IPC_BOOTSTRAP_NAME_MAX)
+		length = IPC_BOOTSTRAP_NAME_MAX;
 
 	message.header.reply = replyPort;
 	message.header.port = ipc_get_special_port(IPC_SPECIAL_PORT_BOOTSTRAP);
 	message.header.flags = IPC_HEADER_FLAG_RESPONSE | IPC_HEADER_FLAG_RESPONSE_BITS(IPC_MESSAGE_RIGHT_COPY_SEND_ONCE);
 	message.header.size = length;
-	message.header.id = 1;
+	message.header.id = IPC_BOOTSTRAP_LOOKUP;
 
 	memcpy(message.data.buffer, name, length);
 
@@ -118,6 +247,115 @@ ipc_return_t ipc_bootstrap_lookup(ipc_port_t *port, const char *name)
 		return message.data.response;
 
 	*port = message.header.port;
+	ipc_bootstrap_cache_insert(name, *port);
 
 	return KERN_SUCCESS;
 }
+
+static ipc_return_t ipc_bootstrap_resolve_batch(ipc_port_t *ports, const char **names, const size_t *indices, size_t count)
+{
+	ipc_port_t replyPort;
+
+	ipc_return_t result = ipc_allocate_port(&replyPort);
+	if(result != KERN_SUCCESS)
+		return result;
+
+	struct
+	{
+		ipc_header_t header;
+		union
+		{
+			char buffer[IPC_BOOTSTRAP_BATCH_MAX * (IPC_BOOTSTRAP_NAME_MAX + 1)];
+			ipc_bootstrap_batch_entry_t entries[IPC_BOOTSTRAP_BATCH_MAX];
+		} data;
+	} message;
+
+	size_t offset = 0;
+
+	for(size_t i = 0; i < count; i ++)
+	{
+		const char *name = names[indices[i]];
+
+		size_t length = strlen(name);
+		if(length > IPC_BOOTSTRAP_NAME_MAX)
+			length = IPC_BOOTSTRAP_NAME_MAX;
+
+		memcpy(message.data.buffer + offset, name, length);
+		message.data.buffer[offset + length] = '\0';
+
+		offset += length + 1;
+	}
+
+	message.header.reply = replyPort;
+	message.header.port = ipc_get_special_port(IPC_SPECIAL_PORT_BOOTSTRAP);
+	message.header.flags = IPC_HEADER_FLAG_RESPONSE | IPC_HEADER_FLAG_RESPONSE_BITS(IPC_MESSAGE_RIGHT_COPY_SEND_ONCE);
+	message.header.size = offset;
+	message.header.id = IPC_BOOTSTRAP_LOOKUP_BATCH;
+
+	result = ipc_write(&message.header);
+
+	if(result != KERN_SUCCESS)
+	{
+		ipc_deallocate_port(replyPort);
+		return result;
+	}
+
+	// Retrieve the response
+	message.header.port = replyPort;
+	message.header.flags = IPC_HEADER_FLAG_BLOCK;
+	message.header.size = sizeof(message.data.entries);
+
+	result = ipc_read(&message.header);
+	ipc_deallocate_port(replyPort);
+
+	if(result != KERN_SUCCESS)
+		return result;
+
+	size_t received = message.header.size / sizeof(ipc_bootstrap_batch_entry_t);
+	result = KERN_SUCCESS;
+
+	for(size_t i = 0; i < count; i ++)
+	{
+		ipc_bootstrap_batch_entry_t *entry = &message.data.entries[i];
+
+		if(i >= received || entry->result != KERN_SUCCESS)
+		{
+			result = KERN_RESOURCE_NOT_FOUND;
+			continue;
+		}
+
+		ports[indices[i]] = entry->port;
+		ipc_bootstrap_cache_insert(names[indices[i]], entry->port);
+	}
+
+	return result;
+}
+
+ipc_return_t ipc_bootstrap_lookup_batch(ipc_port_t *ports, const char **names, size_t count)
+{
+	size_t pending[IPC_BOOTSTRAP_BATCH_MAX];
+	size_t pendingCount = 0;
+
+	ipc_return_t result = KERN_SUCCESS;
+
+	for(size_t i = 0; i < count; i ++)
+	{
+		ports[i] = ipc_bootstrap_cache_find(names[i]);
+
+		if(ports[i] == IPC_PORT_NULL)
+			pending[pendingCount ++] = i;
+
+		if(pendingCount == IPC_BOOTSTRAP_BATCH_MAX || (i == count - 1 && pendingCount > 0))
+		{
+			ipc_return_t batchResult = ipc_bootstrap_resolve_batch(ports, names, pending, pendingCount);
+			pendingCount = 0;
+
+			if(batchResult == KERN_RESOURCE_NOT_FOUND)
+				result = batchResult;
+			else if(batchResult != KERN_SUCCESS)
+				return batchResult;
+		}
+	}
+
+	return result;
+}
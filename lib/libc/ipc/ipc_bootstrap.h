@@ -20,14 +20,36 @@
 #define _IPC_IPC_BOOTSTRAP_H_
 
 #include "../sys/cdefs.h"
+#include "../sys/types.h"
 #include "ipc_types.h"
 
 __BEGIN_DECLS
 
+#define IPC_BOOTSTRAP_REGISTER     0
+#define IPC_BOOTSTRAP_LOOKUP       1
+#define IPC_BOOTSTRAP_UNREGISTER   2
+#define IPC_BOOTSTRAP_LOOKUP_BATCH 3
+
+#define IPC_BOOTSTRAP_NAME_MAX  255
+#define IPC_BOOTSTRAP_BATCH_MAX 16
+
+// Reply entry of IPC_BOOTSTRAP_LOOKUP_BATCH, the request is a list of NULL terminated names
+typedef struct
+{
+	ipc_return_t result;
+	ipc_port_t port;
+} ipc_bootstrap_batch_entry_t;
+
 ipc_return_t ipc_bootstrap_register(ipc_port_t port, const char *name);
 ipc_return_t ipc_bootstrap_lookup(ipc_port_t *port, const char *name);
+ipc_return_t ipc_bootstrap_lookup_batch(ipc_port_t *ports, const char **names, size_t count);
 ipc_return_t ipc_bootstrap_unregister(const char *name);
 
+// Drops the cached lookup result for a port, called by ipc_write() when the receiver is gone
+void ipc_bootstrap_cache_invalidate(ipc_port_t port);
+// Drops the cached lookup result without releasing the right, called by ipc_deallocate_port()
+void ipc_bootstrap_cache_remove_port(ipc_port_t port);
+
 __END_DECLS
 
-#endif /* _IPC_IPC_MESSAGE_H_ */
+#endif /* _IPC_IPC_BOOTSTRAP_H_ */
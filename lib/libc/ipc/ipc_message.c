@@ -20,10 +20,21 @@
 
 #ifndef __LIBKERN
 #include "../sys/kern_trap.h"
+#include "../sys/kern_return.h"
+#include "ipc_bootstrap.h"
 
 ipc_return_t ipc_write(ipc_header_t *header)
 {
-	return KERN_TRAP3(KERN_IPC_Message, header, header->size, (int)IPC_WRITE);
+	ipc_return_t result = KERN_TRAP3(KERN_IPC_Message, header, header->size, (int)IPC_WRITE);
+
+	if(result == KERN_IPC_NO_RECEIVER)
+		ipc_bootstrap_cache_invalidate(header->port);
+
+	return result;
+}
+ipc_return_t ipc_write_async(ipc_header_t *header, ipc_port_t completion)
+{
+	return KERN_TRAP4(KERN_IPC_Message, header, header->size, (int)IPC_WRITE_ASYNC, completion);
 }
 ipc_return_t ipc_read(ipc_header_t *header)
 {
@@ -37,6 +48,10 @@ ipc_return_t ipc_write(__unused ipc_header_t *header)
 {
 	panic("ipc_write() called");
 }
+ipc_return_t ipc_write_async(__unused ipc_header_t *header, __unused ipc_port_t completion)
+{
+	panic("ipc_write_async() called");
+}
 ipc_return_t ipc_read(__unused ipc_header_t *header)
 {
 	panic("ipc_read() called");
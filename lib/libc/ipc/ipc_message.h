@@ -26,6 +26,7 @@ __BEGIN_DECLS
 
 #define IPC_WRITE 0
 #define IPC_READ  1
+#define IPC_WRITE_ASYNC 2
 
 #define IPC_HEADER_FLAG_BLOCK (1 << 0)
 #define IPC_HEADER_FLAG_RESPONSE (1 << 1)
@@ -47,7 +48,16 @@ typedef struct
 	ipc_size_t size;
 } ipc_header_t;
 
+// Payload of the message posted to the completion port of ipc_write_async() when the send failed
+// The message id is the one of the failed message, the port is its destination
+typedef struct
+{
+	ipc_return_t result;
+	ipc_port_t port;
+} ipc_completion_t;
+
 ipc_return_t ipc_write(ipc_header_t *header);
+ipc_return_t ipc_write_async(ipc_header_t *header, ipc_port_t completion);
 ipc_return_t ipc_read(ipc_header_t *header);
 
 __END_DECLS
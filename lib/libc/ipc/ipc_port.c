@@ -20,6 +20,7 @@
 
 #ifndef __LIBKERN
 #include "../sys/kern_trap.h"
+#include "ipc_bootstrap.h"
 
 ipc_return_t ipc_task_space(ipc_space_t *space, pid_t pid)
 {
@@ -59,6 +60,8 @@ ipc_return_t ipc_insert_port(ipc_space_t space, ipc_port_t target, ipc_port_t po
 
 ipc_return_t ipc_deallocate_port(ipc_port_t port)
 {
+	// The name may be reused for an unrelated port once the right is gone
+	ipc_bootstrap_cache_remove_port(port);
 	return (ipc_return_t)KERN_TRAP1(KERN_IPC_DeallocatePort, port);
 }
 
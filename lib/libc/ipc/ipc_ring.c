@@ -0,0 +1,173 @@
+//
+//  ipc_ring.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "../string.h"
+#include "../stddef.h"
+#include "../sys/kern_return.h"
+#include "ipc_ring.h"
+
+#ifndef __LIBKERN
+#include "../sys/kern_trap.h"
+
+static void ipc_ring_attach(ipc_ring_t *ring, ipc_port_t port, void *address, size_t size)
+{
+	ring->header = (ipc_ring_header_t *)address;
+	ring->data = ((unsigned char *)address) + IPC_RING_DATA_OFFSET;
+	ring->capacity = (unsigned int)size;
+	ring->port = port;
+}
+
+ipc_return_t ipc_ring_create(ipc_ring_t *ring, ipc_port_t port, size_t size)
+{
+	void *address = NULL;
+
+	ipc_return_t result = (ipc_return_t)KERN_TRAP3(KERN_IPC_RingCreate, port, size, &address);
+	if(result != KERN_SUCCESS)
+		return result;
+
+	ipc_ring_attach(ring, port, address, size);
+	return KERN_SUCCESS;
+}
+
+ipc_return_t ipc_ring_map(ipc_ring_t *ring, ipc_port_t port)
+{
+	void *address = NULL;
+	size_t size = 0;
+
+	ipc_return_t result = (ipc_return_t)KERN_TRAP3(KERN_IPC_RingMap, port, &address, &size);
+	if(result != KERN_SUCCESS)
+		return result;
+
+	ipc_ring_attach(ring, port, address, size);
+	return KERN_SUCCESS;
+}
+
+// Sets the waiting flag and sleeps until the word at offset moves away from value
+// The flag is set before the re-check so that the peer either sees it and rings
+// the doorbell, or we see its update and don't go to sleep at all
+static void ipc_ring_wait(ipc_ring_t *ring, unsigned int *waiting, unsigned int *word, unsigned int value)
+{
+	__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(word, __ATOMIC_SEQ_CST) == value)
+		KERN_TRAP3(KERN_IPC_RingWait, ring->port, (unsigned int)((unsigned char *)word - (unsigned char *)ring->header), value);
+
+	__atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+static void ipc_ring_notify(ipc_ring_t *ring, unsigned int *waiting)
+{
+	if(__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+		KERN_TRAP1(KERN_IPC_RingNotify, ring->port);
+}
+
+size_t ipc_ring_write(ipc_ring_t *ring, const void *data, size_t size, int flags)
+{
+	ipc_ring_header_t *header = ring->header;
+	const unsigned char *bytes = (const unsigned char *)data;
+
+	unsigned int capacity = ring->capacity;
+	size_t written = 0;
+
+	while(written < size)
+	{
+		unsigned int head = header->head;
+		unsigned int tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+
+		// The indices are shared with the peer, never trust them to be within the capacity
+		unsigned int used = head - tail;
+		if(used > capacity)
+			used = capacity;
+
+		unsigned int available = capacity - used;
+
+		if(available == 0)
+		{
+			if(!(flags & IPC_RING_BLOCK))
+				break;
+
+			ipc_ring_wait(ring, &header->writerWaiting, &header->tail, tail);
+			continue;
+		}
+
+		size_t length = size - written;
+		if(length > available)
+			length = available;
+
+		size_t offset = head & (capacity - 1);
+		size_t first = capacity - offset;
+		if(first > length)
+			first = length;
+
+		memcpy(ring->data + offset, bytes + written, first);
+		memcpy(ring->data, bytes + written + first, length - first);
+
+		__atomic_store_n(&header->head, head + (unsigned int)length, __ATOMIC_SEQ_CST);
+		written += length;
+
+		ipc_ring_notify(ring, &header->readerWaiting);
+	}
+
+	return written;
+}
+
+size_t ipc_ring_read(ipc_ring_t *ring, void *data, size_t size, int flags)
+{
+	ipc_ring_header_t *header = ring->header;
+	unsigned char *bytes = (unsigned char *)data;
+
+	unsigned int capacity = ring->capacity;
+
+	while(size > 0)
+	{
+		unsigned int tail = header->tail;
+		unsigned int head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+
+		if(head == tail)
+		{
+			if(!(flags & IPC_RING_BLOCK))
+				break;
+
+			ipc_ring_wait(ring, &header->readerWaiting, &header->head, head);
+			continue;
+		}
+
+		size_t length = head - tail;
+		if(length > capacity)
+			length = capacity;
+		if(length > size)
+			length = size;
+
+		size_t offset = tail & (capacity - 1);
+		size_t first = capacity - offset;
+		if(first > length)
+			first = length;
+
+		memcpy(bytes, ring->data + offset, first);
+		memcpy(bytes + first, ring->data, length - first);
+
+		__atomic_store_n(&header->tail, tail + (unsigned int)length, __ATOMIC_SEQ_CST);
+		ipc_ring_notify(ring, &header->writerWaiting);
+
+		return length;
+	}
+
+	return 0;
+}
+
+#endif
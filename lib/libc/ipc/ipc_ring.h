@@ -0,0 +1,61 @@
+//
+//  ipc_ring.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _IPC_IPC_RING_H_
+#define _IPC_IPC_RING_H_
+
+#include "../sys/cdefs.h"
+#include "../sys/types.h"
+#include "ipc_types.h"
+
+__BEGIN_DECLS
+
+#define IPC_RING_BLOCK (1 << 0)
+
+#define IPC_RING_DATA_OFFSET 64
+
+// Lives at the start of the shared pages, the data area follows at IPC_RING_DATA_OFFSET
+// head is only written by the producer, tail only by the consumer. The waiting flags
+// are set by a side before it blocks in the kernel, so the other side only has
+// to take the doorbell trap when there is actually someone to wake up
+typedef struct
+{
+	unsigned int size; // Size of the data area, always a power of two
+	unsigned int head;
+	unsigned int tail;
+	unsigned int readerWaiting;
+	unsigned int writerWaiting;
+} ipc_ring_header_t;
+
+typedef struct
+{
+	ipc_ring_header_t *header;
+	unsigned char *data;
+	unsigned int capacity; // Private copy of the data area size, the peer can rewrite header->size
+	ipc_port_t port;
+} ipc_ring_t;
+
+ipc_return_t ipc_ring_create(ipc_ring_t *ring, ipc_port_t port, size_t size);
+ipc_return_t ipc_ring_map(ipc_ring_t *ring, ipc_port_t port);
+
+size_t ipc_ring_write(ipc_ring_t *ring, const void *data, size_t size, int flags);
+size_t ipc_ring_read(ipc_ring_t *ring, void *data, size_t size, int flags);
+
+__END_DECLS
+
+#endif /* _IPC_IPC_RING_H_ */
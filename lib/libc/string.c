@@ -106,7 +106,7 @@ size_t strnlen_np(const char *string, size_t maxSize)
 {
 	const char *s = string;
 
-	for(; *s != '\0' && (size_t)(s - string) < maxSize; s++)
+	for(; (size_t)(s - string) < maxSize && *s != '\0'; s++)
 	{}
 
 	return s - string;
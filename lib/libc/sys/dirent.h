@@ -28,11 +28,27 @@ struct dirent
 	int type;
 };
 
+// Variable length record as returned by getdents(). Records are packed back to back,
+// length is the distance to the next record. The name extends past the end of the
+// struct, the record size is offsetof(struct dirent_record, name) plus the name.
+struct dirent_record
+{
+	ino_t id;
+	off_t cookie; // Pass to lseek() with SEEK_SET to continue after this entry
+	unsigned short length;
+	unsigned char type;
+	char name[1]; // NUL terminated
+};
+
+#define DIRENT_RECORD_NEXT(record) \
+	((struct dirent_record *)((char *)(record) + (record)->length))
+
 __BEGIN_DECLS
 
 #ifndef __KERNEL
 
 off_t readdir(int fd, struct dirent *entp, size_t count);
+size_t getdents(int fd, void *buffer, size_t size); // Returns the number of bytes filled with records, 0 at the end
 
 #endif /* __KERNEL */
 
@@ -0,0 +1,41 @@
+//
+//  futex.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYS_FUTEX_H_
+#define _SYS_FUTEX_H_
+
+#include "cdefs.h"
+#include "../stdint.h"
+
+__BEGIN_DECLS
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#ifndef __KERNEL
+
+// Sleeps as long as *address still contains expected, fails with EAGAIN if it doesn't
+int futex_wait(volatile uint32_t *address, uint32_t expected);
+// Wakes up to count waiters and returns how many were woken
+int futex_wake(volatile uint32_t *address, int count);
+
+#endif
+
+__END_DECLS
+
+#endif /* _SYS_FUTEX_H_ */
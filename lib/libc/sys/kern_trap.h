@@ -31,6 +31,10 @@ __BEGIN_DECLS
 #define KERN_IPC_DeallocatePort 5
 #define KERN_IPC_TaskSpace 6
 #define KERN_IPC_InsertPort 7
+#define KERN_IPC_RingCreate 8
+#define KERN_IPC_RingMap 9
+#define KERN_IPC_RingWait 10
+#define KERN_IPC_RingNotify 11
 
 unsigned int __kern_trap(int type, ...);
 
@@ -0,0 +1,70 @@
+//
+//  kernel_data.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "kernel_data.h"
+#include "tls.h"
+
+static const struct kernel_data *kernel_data_get()
+{
+	const struct kernel_data *data;
+	TLS_GET_CPU_DATA_MEMBER(data, kernelData);
+
+	return data;
+}
+
+// Retries until it got a copy that no clock tick raced with
+static void kernel_data_read_clock(struct kernel_data *result)
+{
+	const struct kernel_data *data = kernel_data_get();
+	uint32_t sequence;
+
+	do {
+		while((sequence = __atomic_load_n(&data->sequence, __ATOMIC_ACQUIRE)) & 1)
+			__asm__ volatile("pause");
+
+		result->ticks = data->ticks;
+		result->microseconds = data->microseconds;
+		result->microsecondsPerTick = data->microsecondsPerTick;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&data->sequence, __ATOMIC_RELAXED) != sequence);
+}
+
+uint64_t clock_ticks()
+{
+	struct kernel_data copy;
+	kernel_data_read_clock(&copy);
+
+	return copy.ticks;
+}
+
+uint64_t clock_microseconds()
+{
+	struct kernel_data copy;
+	kernel_data_read_clock(&copy);
+
+	return copy.microseconds;
+}
+
+uint32_t clock_microseconds_per_tick()
+{
+	struct kernel_data copy;
+	kernel_data_read_clock(&copy);
+
+	return copy.microsecondsPerTick;
+}
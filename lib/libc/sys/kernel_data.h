@@ -0,0 +1,48 @@
+//
+//  kernel_data.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYS_KERNEL_DATA_H_
+#define _SYS_KERNEL_DATA_H_
+
+#include "cdefs.h"
+#include "../stdint.h"
+
+__BEGIN_DECLS
+
+// Read-only page the kernel maps into every task, found through the CPU data
+// The clock fields are updated under sequence, which is odd while a write is in progress
+struct kernel_data
+{
+	uint32_t sequence;
+	uint32_t microsecondsPerTick;
+	uint64_t ticks;
+	uint64_t microseconds;
+};
+
+#ifndef __KERNEL
+
+// Monotonic, read without entering the kernel
+uint64_t clock_ticks();
+uint64_t clock_microseconds();
+uint32_t clock_microseconds_per_tick();
+
+#endif
+
+__END_DECLS
+
+#endif /* _SYS_KERNEL_DATA_H_ */
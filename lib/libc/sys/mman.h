@@ -33,6 +33,7 @@
 #define MAP_PRIVATE     0x0002
 #define MAP_ANONYMOUS   0x0004
 #define MAP_FIXED       0x0008
+#define MAP_URING       0x0010 // Maps the submission/completion rings set up with uring_setup()
 
 __BEGIN_DECLS
 
@@ -0,0 +1,85 @@
+//
+//  mutex.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "mutex.h"
+#include "futex.h"
+
+void mutex_init(mutex_t *mutex)
+{
+	mutex->state = 0;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+	uint32_t state = 0;
+	if(__atomic_compare_exchange_n(&mutex->state, &state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	// Mark the mutex as contended before sleeping, so the owner knows it has to wake someone up
+	if(state != 2)
+		state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+
+	while(state != 0)
+	{
+		futex_wait(&mutex->state, 2);
+		state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+bool mutex_trylock(mutex_t *mutex)
+{
+	uint32_t state = 0;
+	return __atomic_compare_exchange_n(&mutex->state, &state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+	if(__atomic_exchange_n(&mutex->state, 0, __ATOMIC_RELEASE) == 2)
+		futex_wake(&mutex->state, 1);
+}
+
+
+void condvar_init(condvar_t *condvar)
+{
+	condvar->sequence = 0;
+}
+
+void condvar_wait(condvar_t *condvar, mutex_t *mutex)
+{
+	// A signal after the mutex is dropped changes the sequence, so the wait returns right away
+	uint32_t sequence = __atomic_load_n(&condvar->sequence, __ATOMIC_RELAXED);
+
+	mutex_unlock(mutex);
+	futex_wait(&condvar->sequence, sequence);
+
+	// The waiter can't tell whether the mutex is contended anymore, so it has to assume it is
+	while(__atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE) != 0)
+		futex_wait(&mutex->state, 2);
+}
+
+void condvar_signal(condvar_t *condvar)
+{
+	__atomic_add_fetch(&condvar->sequence, 1, __ATOMIC_RELEASE);
+	futex_wake(&condvar->sequence, 1);
+}
+
+void condvar_broadcast(condvar_t *condvar)
+{
+	__atomic_add_fetch(&condvar->sequence, 1, __ATOMIC_RELEASE);
+	futex_wake(&condvar->sequence, INT32_MAX);
+}
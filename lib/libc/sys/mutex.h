@@ -0,0 +1,59 @@
+//
+//  mutex.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYS_MUTEX_H_
+#define _SYS_MUTEX_H_
+
+#include "cdefs.h"
+#include "../stdint.h"
+#include "../stdbool.h"
+
+__BEGIN_DECLS
+
+// Only enters the kernel when contended
+// state is 0 when unlocked, 1 when locked and 2 when locked with possible waiters
+typedef struct
+{
+	uint32_t state;
+} mutex_t;
+
+typedef struct
+{
+	uint32_t sequence;
+} condvar_t;
+
+#define MUTEX_INIT   { 0 }
+#define CONDVAR_INIT { 0 }
+
+#ifndef __KERNEL
+
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+bool mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+void condvar_init(condvar_t *condvar);
+void condvar_wait(condvar_t *condvar, mutex_t *mutex);
+void condvar_signal(condvar_t *condvar);
+void condvar_broadcast(condvar_t *condvar);
+
+#endif
+
+__END_DECLS
+
+#endif /* _SYS_MUTEX_H_ */
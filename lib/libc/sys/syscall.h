@@ -20,6 +20,8 @@
 #define _SYS_SYSCALL_H_
 
 #include "cdefs.h"
+#include "types.h"
+#include "../stdint.h"
 
 __BEGIN_DECLS
 
@@ -39,14 +41,39 @@ __BEGIN_DECLS
 #define SYS_Fork         13
 #define SYS_Exec         14
 #define SYS_Spawn        15
+#define SYS_Pread        16
+#define SYS_Pwrite       17
+#define SYS_Readv        18
+#define SYS_Writev       19
 
 #define SYS_Mmap     20
 #define SYS_Munmap   21
 #define SYS_Mprotect 22
 #define SYS_Msync    23
 
+#define SYS_Batch       24
+#define SYS_UringSetup  25
+#define SYS_UringEnter  26
+#define SYS_Futex       27
+#define SYS_Getdents    28
+
+#define SYSCALL_BATCH_MAX 32
+#define SYSCALL_BATCH_STOP_ON_ERROR (1 << 0)
+
+typedef struct
+{
+	uint32_t type; // One of the SYS_ constants, except exit, fork, exec, spawn and batch
+	uint32_t args[8];
+	uint32_t result;
+	uint32_t error; // errno of the call, 0 on success
+} syscall_batch_entry_t;
+
 unsigned int __syscall(int type, ...);
 
+#ifndef __KERNEL
+int syscall_batch(syscall_batch_entry_t *entries, size_t count, int flags);
+#endif
+
 #define SYSCALL8(type, arg0, arg1, arg2, arg3, arg4, arg5, arg6, arg7) \
 	__syscall(type, (arg0), (arg1), (arg2), (arg3), (arg4), (arg5), (arg6), (arg7))
 
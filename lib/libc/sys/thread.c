@@ -43,6 +43,14 @@ tid_t thread_gettid()
 	return result;
 }
 
+unsigned int thread_getcpu()
+{
+	uint16_t result;
+	TLS_GET_CPU_DATA_MEMBER(result, cpuID);
+
+	return result;
+}
+
 void thread_join(tid_t thread)
 {
 	SYSCALL1(SYS_ThreadJoin, thread);
@@ -26,6 +26,7 @@ __BEGIN_DECLS
 
 tid_t thread_create(void (*entry)(void *), void *argument);
 tid_t thread_gettid();
+unsigned int thread_getcpu(); // Only a hint, the thread can migrate right after
 void thread_join(tid_t thread);
 void thread_yield();
 
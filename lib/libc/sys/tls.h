@@ -22,6 +22,7 @@
 #include "cdefs.h"
 #include "../stddef.h"
 #include "../stdint.h"
+#include "kernel_data.h"
 
 #ifndef __KERNEL
 __BEGIN_DECLS
@@ -32,8 +33,13 @@ struct cpu_data
 	pid_t pid;
 	tid_t tid;
 	void *tls;
+	uint32_t features;
+	pid_t ppid;
+	const struct kernel_data *kernelData;
 };
 
+#define CPU_DATA_FEATURE_SYSENTER (1 << 0)
+
 #define TLS_GET_CPU_DATA_MEMBER(val, member) \
 	__asm__ volatile("mov %%fs:%P1, %0" : "=r" (val) : "i" (offsetof(struct cpu_data, member)))
 
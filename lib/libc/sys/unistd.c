@@ -43,10 +43,27 @@ off_t lseek(int fd, off_t offset, int whence)
 {
 	return (off_t)SYSCALL3(SYS_Seek, fd, offset, whence);
 }
+size_t pread(int fd, void *buffer, size_t count, off_t offset)
+{
+	return (size_t)SYSCALL4(SYS_Pread, fd, buffer, count, offset);
+}
+size_t pwrite(int fd, const void *buffer, size_t count, off_t offset)
+{
+	return (size_t)SYSCALL4(SYS_Pwrite, fd, buffer, count, offset);
+}
 off_t readdir(int fd, struct dirent *entp, size_t count)
 {
 	return (off_t)SYSCALL4(SYS_Read, fd, entp, count, 1);
 }
+size_t getdents(int fd, void *buffer, size_t size)
+{
+	return (size_t)SYSCALL3(SYS_Getdents, fd, buffer, size);
+}
+
+int syscall_batch(syscall_batch_entry_t *entries, size_t count, int flags)
+{
+	return (int)SYSCALL3(SYS_Batch, entries, count, flags);
+}
 
 
 int mkdir(__unused const char *path)
@@ -81,7 +98,10 @@ pid_t getpid()
 }
 pid_t getppid()
 {
-	return (pid_t)SYSCALL1(SYS_Pid, 1);
+	pid_t result;
+	TLS_GET_CPU_DATA_MEMBER(result, ppid);
+
+	return result;
 }
 
 pid_t fork()
@@ -48,6 +48,9 @@ size_t read(int fd, void *buffer, size_t count);
 size_t write(int fd, const void *buffer, size_t count);
 off_t lseek(int fd, off_t offset, int whence);
 
+size_t pread(int fd, void *buffer, size_t count, off_t offset);
+size_t pwrite(int fd, const void *buffer, size_t count, off_t offset);
+
 int mkdir(const char *path);
 int remove(const char *path);
 int move(const char *source, const char *target);
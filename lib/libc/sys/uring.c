@@ -0,0 +1,112 @@
+//
+//  uring.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "uring.h"
+#include "mman.h"
+#include "syscall.h"
+#include "../string.h"
+
+int uring_setup(unsigned int entries, uring_params_t *params)
+{
+	return (int)SYSCALL2(SYS_UringSetup, entries, params);
+}
+int uring_enter(unsigned int toSubmit, unsigned int minComplete, int flags)
+{
+	return (int)SYSCALL3(SYS_UringEnter, toSubmit, minComplete, flags);
+}
+
+int uring_init(uring_t *ring, unsigned int entries)
+{
+	uring_params_t params;
+	if(uring_setup(entries, &params) == -1)
+		return -1;
+
+	void *address = mmap(NULL, params.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_URING, -1, 0);
+	if(address == MAP_FAILED)
+		return -1;
+
+	ring->header = (uring_header_t *)address;
+	ring->sqes = (uring_sqe_t *)((unsigned char *)address + ring->header->sqOffset);
+	ring->cqes = (uring_cqe_t *)((unsigned char *)address + ring->header->cqOffset);
+	ring->sqTail = ring->header->sqTail;
+
+	return 0;
+}
+
+uring_sqe_t *uring_get_sqe(uring_t *ring)
+{
+	uring_header_t *header = ring->header;
+	unsigned int head = __atomic_load_n(&header->sqHead, __ATOMIC_ACQUIRE);
+
+	if(ring->sqTail - head >= header->sqEntries)
+		return NULL;
+
+	uring_sqe_t *sqe = ring->sqes + (ring->sqTail & (header->sqEntries - 1));
+	ring->sqTail ++;
+
+	memset(sqe, 0, sizeof(uring_sqe_t));
+	return sqe;
+}
+
+int uring_submit(uring_t *ring)
+{
+	uring_header_t *header = ring->header;
+	unsigned int submitted = ring->sqTail - header->sqTail;
+
+	if(submitted == 0)
+		return 0;
+
+	__atomic_store_n(&header->sqTail, ring->sqTail, __ATOMIC_RELEASE);
+
+	if(uring_enter(submitted, 0, 0) == -1)
+		return -1;
+
+	return (int)submitted;
+}
+
+uring_cqe_t *uring_peek_cqe(uring_t *ring)
+{
+	uring_header_t *header = ring->header;
+
+	unsigned int head = header->cqHead;
+	unsigned int tail = __atomic_load_n(&header->cqTail, __ATOMIC_ACQUIRE);
+
+	if(head == tail)
+		return NULL;
+
+	return ring->cqes + (head & (header->cqEntries - 1));
+}
+
+uring_cqe_t *uring_wait_cqe(uring_t *ring)
+{
+	uring_cqe_t *cqe;
+
+	while(!(cqe = uring_peek_cqe(ring)))
+	{
+		if(uring_enter(0, 1, URING_ENTER_GETEVENTS) == -1)
+			return NULL;
+	}
+
+	return cqe;
+}
+
+void uring_cqe_seen(uring_t *ring)
+{
+	uring_header_t *header = ring->header;
+	__atomic_store_n(&header->cqHead, header->cqHead + 1, __ATOMIC_RELEASE);
+}
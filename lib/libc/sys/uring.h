@@ -0,0 +1,105 @@
+//
+//  uring.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYS_URING_H_
+#define _SYS_URING_H_
+
+#include "cdefs.h"
+#include "types.h"
+#include "../stdint.h"
+
+__BEGIN_DECLS
+
+#define URING_MAX_ENTRIES 256
+
+#define URING_OP_NOP      0
+#define URING_OP_READ     1 // address/length is the buffer, offset -1 uses and advances the file offset
+#define URING_OP_WRITE    2
+#define URING_OP_READV    3 // address is a struct iovec array, length the number of vectors
+#define URING_OP_WRITEV   4
+#define URING_OP_IPC_SEND 5 // address is an ipc_header_t followed by length bytes of payload
+
+#define URING_ENTER_GETEVENTS (1 << 0)
+
+// Lives at the start of the shared pages, the submission and completion arrays
+// follow at the offsets given in the header. sqTail and cqHead are only written
+// by userland, sqHead and cqTail only by the kernel
+typedef struct
+{
+	unsigned int sqHead;
+	unsigned int sqTail;
+	unsigned int cqHead;
+	unsigned int cqTail;
+	unsigned int sqEntries; // Always a power of two
+	unsigned int cqEntries; // Twice the number of submission entries
+	unsigned int sqOffset;
+	unsigned int cqOffset;
+} uring_header_t;
+
+typedef struct
+{
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t reserved;
+	int fd;
+	off_t offset;
+	void *address;
+	uint32_t length;
+	uint64_t userData;
+} uring_sqe_t;
+
+typedef struct
+{
+	uint64_t userData;
+	uint32_t result;
+	uint32_t error; // errno of the operation, 0 on success
+} uring_cqe_t;
+
+typedef struct
+{
+	unsigned int entries;
+	unsigned int size; // Size of the shared mapping, passed to mmap() with MAP_URING
+} uring_params_t;
+
+#ifndef __KERNEL
+
+typedef struct
+{
+	uring_header_t *header;
+	uring_sqe_t *sqes;
+	uring_cqe_t *cqes;
+	unsigned int sqTail; // Local tail, published by uring_submit()
+} uring_t;
+
+int uring_setup(unsigned int entries, uring_params_t *params);
+int uring_enter(unsigned int toSubmit, unsigned int minComplete, int flags);
+
+int uring_init(uring_t *ring, unsigned int entries);
+
+uring_sqe_t *uring_get_sqe(uring_t *ring);
+int uring_submit(uring_t *ring);
+
+uring_cqe_t *uring_peek_cqe(uring_t *ring);
+uring_cqe_t *uring_wait_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+
+#endif /* __KERNEL */
+
+__END_DECLS
+
+#endif /* _SYS_URING_H_ */
@@ -0,0 +1,74 @@
+//
+//  histogram.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <libc/string.h>
+
+// Power of two histogram, bucket n counts the samples in [2^n, 2^(n+1))
+// Not synchronized, the owner has to serialize Record() and the readers
+class Histogram
+{
+public:
+	static constexpr size_t kBuckets = 32;
+
+	Histogram()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		memset(_buckets, 0, sizeof(_buckets));
+
+		_count = 0;
+		_sum = 0;
+		_max = 0;
+	}
+
+	void Record(uint64_t value)
+	{
+		size_t bucket = 0;
+		while(bucket < kBuckets - 1 && (value >> (bucket + 1)) != 0)
+			bucket ++;
+
+		_buckets[bucket] ++;
+		_count ++;
+		_sum += value;
+
+		if(value > _max)
+			_max = value;
+	}
+
+	uint64_t GetBucket(size_t index) const { return _buckets[index]; }
+	uint64_t GetCount() const { return _count; }
+	uint64_t GetSum() const { return _sum; }
+	uint64_t GetMax() const { return _max; }
+
+private:
+	uint64_t _buckets[kBuckets];
+	uint64_t _count;
+	uint64_t _sum;
+	uint64_t _max;
+};
+
+#endif /* _HISTOGRAM_H_ */
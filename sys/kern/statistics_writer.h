@@ -0,0 +1,78 @@
+//
+//  statistics_writer.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _STATISTICS_WRITER_H_
+#define _STATISTICS_WRITER_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <libc/stdio.h>
+#include <libc/stdarg.h>
+#include <libc/sys/types.h>
+#include <libcpp/algorithm.h>
+#include <vfs/context.h>
+
+// Formats a text snapshot into a fixed buffer, output past the end is silently dropped
+// Used by the read callbacks of the statistics CFS nodes
+class StatisticsWriter
+{
+public:
+	StatisticsWriter(char *buffer, size_t size) :
+		_buffer(buffer),
+		_size(size),
+		_length(0)
+	{}
+
+	void Print(const char *format, ...)
+	{
+		if(_length >= _size)
+			return;
+
+		va_list args;
+		va_start(args, format);
+		int written = vsnprintf(_buffer + _length, _size - _length, format, args);
+		va_end(args);
+
+		if(written > 0)
+			_length = std::min(_size, _length + written);
+	}
+
+	// Copies the part of the snapshot at offset out to the reader, returns -1 on failure
+	size_t CopyOut(VFS::Context *context, off_t offset, void *data, size_t size) const
+	{
+		if(offset < 0 || static_cast<size_t>(offset) >= _length)
+			return 0;
+
+		size_t result = std::min(size, _length - static_cast<size_t>(offset));
+
+		if(!context->CopyDataIn(_buffer + offset, data, result).IsValid())
+			return static_cast<size_t>(-1);
+
+		return result;
+	}
+
+	size_t GetLength() const { return _length; }
+
+private:
+	char *_buffer;
+	size_t _size;
+	size_t _length;
+};
+
+#endif /* _STATISTICS_WRITER_H_ */
@@ -20,6 +20,7 @@
 #include <kern/kprintf.h>
 #include <libcpp/atomic.h>
 #include <os/scheduler/scheduler.h>
+#include <machine/interrupts/trampoline.h>
 #include "clock.h"
 
 namespace Sys
@@ -157,19 +158,43 @@ namespace Sys
 
 
 
+		// Every CPU ticks the clock, but only the bootstrap CPU publishes it to keep a single writer
+		static void PublishTime(Sys::CPU *cpu)
+		{
+			if(cpu->GetID() != 0)
+				return;
+
+			KernelData *data = TrampolineGetKernelData();
+			if(!data)
+				return;
+
+			__atomic_store_n(&data->sequence, data->sequence + 1, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+
+			data->ticks = _timeTicks;
+			data->microseconds = _timeMsec;
+			data->microsecondsPerTick = _timeMsecPerTick;
+
+			__atomic_store_n(&data->sequence, data->sequence + 1, __ATOMIC_RELEASE);
+		}
+
 		uint32_t ClockTick(uint32_t esp, Sys::CPU *cpu)
 		{
 			_timeTicks ++;
 			_timeMsec += _timeMsecPerTick;
 
+			PublishTime(cpu);
+
 			return OS::Scheduler::GetScheduler()->ScheduleOnCPU(esp, cpu);
 		}
 
-		uint32_t ClockTickSimple(uint32_t esp, __unused Sys::CPU *cpu)
+		uint32_t ClockTickSimple(uint32_t esp, Sys::CPU *cpu)
 		{
 			_timeTicks ++;
 			_timeMsec += _timeMsecPerTick;
 
+			PublishTime(cpu);
+
 			return esp;
 		}
 
@@ -94,8 +94,24 @@ namespace Sys
 		pid_t pid;
 		tid_t tid;
 		vm_address_t tls;
+		uint32_t features;
+		pid_t ppid;
+		vm_address_t kernelData; // Userland address of the KernelData page
 	};
 
+	// Global page mapped read-only into every task, must match lib/libc/sys/kernel_data.h
+	// Updated under a sequence count, readers retry while it's odd or changed under them
+	struct KernelData
+	{
+		uint32_t sequence;
+		uint32_t microsecondsPerTick;
+		uint64_t ticks;
+		uint64_t microseconds;
+	};
+
+	// Bits in CPUData::features, must match lib/libc/sys/tls.h
+	constexpr uint32_t kCPUDataFeatureSysenter = (1 << 0);
+
 	enum class CPUVendor
 	{
 		Intel,
@@ -272,6 +288,10 @@ namespace Sys
 	};
 
 
+	constexpr uint32_t kMSRSysenterCS  = 0x174;
+	constexpr uint32_t kMSRSysenterESP = 0x175;
+	constexpr uint32_t kMSRSysenterEIP = 0x176;
+
 	static inline void CPUWriteMSR(uint32_t msr, uint64_t value)
 	{
 		uint32_t high = value >> 32;
@@ -287,7 +307,17 @@ namespace Sys
 
 		__asm__ volatile("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
 
-		return (low | (high << 31));
+		return (low | (static_cast<uint64_t>(high) << 32));
+	}
+
+	static inline uint64_t CPUReadTimestamp()
+	{
+		uint32_t high;
+		uint32_t low;
+
+		__asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+		return (low | (static_cast<uint64_t>(high) << 32));
 	}
 
 	static inline void CPUPause()
@@ -17,6 +17,7 @@
 //
 
 #include <machine/interrupts/interrupts.h>
+#include <machine/interrupts/trampoline.h>
 #include <libc/backtrace.h>
 #include <kern/kprintf.h>
 #include "debug.h"
@@ -115,6 +116,15 @@ namespace Sys
 		uint32_t dr6;
 		__asm__ volatile("mov %%dr6, %0" : "=r" (dr6));
 
+		// Userland entered sysenter with TF set, the single step trap hits the entry before it could clear the flag
+		if((dr6 & (1 << 14)) && state->cs == 0x8 && TrampolineIsSysenterEntry(state->eip))
+		{
+			state->eflags &= ~(1 << 8);
+
+			__asm__ volatile("mov %0, %%dr6" : : "r" (0));
+			return esp;
+		}
+
 		int watchpoint;
 		uintptr_t address;
 
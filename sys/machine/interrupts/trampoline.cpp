@@ -28,6 +28,9 @@
 
 extern "C" uintptr_t idt_begin;
 extern "C" uintptr_t idt_end;
+extern "C" uintptr_t idt_syscall_return;
+extern "C" uintptr_t idt_sysenter_entry;
+extern "C" uintptr_t idt_sysenter_flags_clean;
 
 namespace Sys
 {
@@ -39,6 +42,12 @@ namespace Sys
 
 		char padding[(VM_PAGE_COUNT((sizeof(Trampoline) * CONFIG_MAX_CPUS)) * VM_PAGE_SIZE) - (sizeof(Trampoline) * CONFIG_MAX_CPUS)]; // Pad to the next page
 		CPUData trampolineData[CONFIG_MAX_CPUS];
+
+		char padding2[(VM_PAGE_COUNT((sizeof(CPUData) * CONFIG_MAX_CPUS)) * VM_PAGE_SIZE) - (sizeof(CPUData) * CONFIG_MAX_CPUS)]; // Pad to the next page
+		KernelData kernelData;
+
+		char padding3[(VM_PAGE_COUNT(sizeof(KernelData)) * VM_PAGE_SIZE) - sizeof(KernelData)]; // Keep the stacks off the shared page
+		uint32_t sysenterStack[CONFIG_MAX_CPUS][kSysenterStackWords]; // Scratch stacks SYSENTER_ESP points to
 	};
 	
 	TrampolineMap *_map = nullptr;
@@ -101,11 +110,31 @@ namespace Sys
 		GDTInit(trampoline->gdt, &trampoline->tss, trampolineData);
 
 		trampolineData->cpuID = cpu->GetID();
+		trampolineData->kernelData = reinterpret_cast<vm_address_t>(&_map->kernelData);
 
 		// Hacky hackery hack
 		uint32_t *esp = Alloc<uint32_t>(directory, 1, kVMFlagsKernel);
-		trampoline->tss.esp0 = reinterpret_cast<uint32_t>(esp) + (VM_PAGE_SIZE - sizeof(Sys::CPUState));
 		trampoline->tss.ss0  = 0x10;
+		TrampolineSetKernelStack(trampoline, reinterpret_cast<uint32_t>(esp) + (VM_PAGE_SIZE - sizeof(Sys::CPUState)));
+
+		// SYSENTER loads its stack from the MSR. It points to the top word of a per CPU scratch stack, which mirrors
+		// esp0 so the entry can switch to the threads kernel stack with a single load. Userland may enter with TF
+		// set, the resulting debug trap must always find a usable stack until the entry clears the flag
+		CPUInfo info;
+		trampolineData->features = 0;
+
+		if(info.GetFeatures() & CPUInfo::Feature::SEP)
+		{
+			uintptr_t entry = IR_TRAMPOLINE_BEGIN + (reinterpret_cast<uintptr_t>(&idt_sysenter_entry) - idtBegin);
+
+			uint32_t *stack = &_map->sysenterStack[cpu->GetID()][kSysenterStackWords - 1];
+
+			CPUWriteMSR(kMSRSysenterCS, 0x8);
+			CPUWriteMSR(kMSRSysenterESP, reinterpret_cast<uint32_t>(stack));
+			CPUWriteMSR(kMSRSysenterEIP, entry);
+
+			trampolineData->features |= kCPUDataFeatureSysenter;
+		}
 
 		return ErrorNone;
 	}
@@ -121,6 +150,47 @@ namespace Sys
 
 		directory->MapPageRange(_physicalTrampoline + offset, IR_TRAMPOLINE_BEGIN + offset, 2, kVMFlagsUserlandR);
 
+		offset = offsetof(TrampolineMap, kernelData);
+		directory->MapPageRange(_physicalTrampoline + offset, IR_TRAMPOLINE_BEGIN + offset, 1, kVMFlagsUserlandR);
+
 		return ErrorNone;
 	}
+
+	void TrampolineSetKernelStack(Trampoline *trampoline, uint32_t esp0)
+	{
+		size_t index = static_cast<size_t>(trampoline - _map->trampoline);
+
+		trampoline->tss.esp0 = esp0;
+		_map->sysenterStack[index][kSysenterStackWords - 1] = esp0;
+	}
+
+	bool TrampolineIsSysenterEntry(uint32_t eip)
+	{
+		uintptr_t idtBegin = reinterpret_cast<uintptr_t>(&idt_begin);
+
+		uintptr_t begin = IR_TRAMPOLINE_BEGIN + (reinterpret_cast<uintptr_t>(&idt_sysenter_entry) - idtBegin);
+		uintptr_t end = IR_TRAMPOLINE_BEGIN + (reinterpret_cast<uintptr_t>(&idt_sysenter_flags_clean) - idtBegin);
+
+		return (eip >= begin && eip <= end);
+	}
+
+	KernelData *TrampolineGetKernelData()
+	{
+		return _map ? &_map->kernelData : nullptr;
+	}
+
+	void TrampolineReturnToUserland(VM::Directory *directory, CPUState *state)
+	{
+		Trampoline *trampoline = CPU::GetCurrentCPU()->GetTrampoline();
+
+		trampoline->pageDirectory = directory->GetPhysicalDirectory();
+		TrampolineSetKernelStack(trampoline, reinterpret_cast<uint32_t>(state) + sizeof(CPUState));
+
+		// The kernel image isn't mapped in the userland directory, so the stub has to run from the trampoline copy
+		uintptr_t idtBegin = reinterpret_cast<uintptr_t>(&idt_begin);
+		uintptr_t entry = IR_TRAMPOLINE_BEGIN + (reinterpret_cast<uintptr_t>(&idt_syscall_return) - idtBegin);
+
+		reinterpret_cast<void (*)(CPUState *)>(entry)(state);
+		__builtin_unreachable();
+	}
 }
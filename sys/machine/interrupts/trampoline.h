@@ -39,10 +39,24 @@ namespace Sys
 
 	static_assert(sizeof(Sys::Trampoline) == 0x8a4, "Sys::Trampoline size must match the size in idt.S");
 
+	static constexpr size_t kSysenterStackWords = 1024;
+
 	KernReturn<void> TrampolineInit();
 	KernReturn<void> TrampolineInitCPU();
 
 	KernReturn<void> TrampolineMapIntoDirectory(VM::Directory *directory);
+
+	// Updates esp0 in the TSS and the copy the sysenter entry loads its kernel stack from
+	void TrampolineSetKernelStack(Trampoline *trampoline, uint32_t esp0);
+
+	// True if eip lies in the part of the sysenter entry that still runs with userland's eflags
+	bool TrampolineIsSysenterEntry(uint32_t eip);
+
+	// Kernel side pointer to the page that is shared read-only with all tasks
+	KernelData *TrampolineGetKernelData();
+
+	// Restores the userland CPU state through the trampoline area, expects interrupts to be disabled
+	void TrampolineReturnToUserland(VM::Directory *directory, CPUState *state) __attribute__((noreturn));
 }
 
 #endif /* _TRAMPOLINE_H_ */
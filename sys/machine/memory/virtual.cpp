@@ -19,7 +19,10 @@
 #include <libc/string.h>
 #include <libc/assert.h>
 #include <libcpp/new.h>
+#include <libcpp/algorithm.h>
 #include <kern/kprintf.h>
+#include <machine/cpu.h>
+#include <machine/interrupts/interrupts.h>
 #include "virtual.h"
 #include "physical.h"
 #include "memory.h"
@@ -234,6 +237,27 @@ namespace Sys
 			return resolved;
 		}
 
+		KernReturn<uintptr_t> Directory::ResolveUserAddress(vm_address_t address, bool write)
+		{
+			ScopedDirectory scoped(_directory);
+			uint32_t *mapped = scoped.GetDirectory();
+
+			if(!mapped)
+				return Error(KERN_NO_MEMORY);
+
+			KernReturn<uint32_t> entry = GetPageTableEntry(mapped, address);
+
+			if(entry.IsValid() == false)
+				return entry.GetError();
+
+			uint32_t required = Flags::Userspace | (write ? Flags::Writeable : 0);
+			if((entry.Get() & required) != required)
+				return Error(KERN_INVALID_ADDRESS);
+
+			uintptr_t resolved = (entry.Get() & ~0xfff) | (address & 0xfff);
+			return resolved;
+		}
+
 		KernReturn<uint32_t> Directory::GetPageTableEntry(uint32_t *pageDirectory, vm_address_t vaddress)
 		{
 			uint32_t index = vaddress / VM_PAGE_SIZE;
@@ -335,6 +359,178 @@ namespace Sys
 			return ErrorNone;	
 		}
 
+		KernReturn<void> Directory::CopyDataOut(vm_address_t address, void *target, size_t length)
+		{
+			uint8_t *buffer = reinterpret_cast<uint8_t *>(target);
+
+			while(length > 0)
+			{
+				size_t offset = address - VM_PAGE_ALIGN_DOWN(address);
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - offset);
+
+				KernReturn<uintptr_t> physical = ResolveAddress(address);
+				if(!physical.IsValid())
+					return physical.GetError();
+
+				KernReturn<void> result = CopyFromPhysical(buffer, physical, chunk);
+				if(!result.IsValid())
+					return result;
+
+				buffer += chunk;
+				address += chunk;
+				length -= chunk;
+			}
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> Directory::CopyUserDataOut(vm_address_t address, void *target, size_t length)
+		{
+			uint8_t *buffer = reinterpret_cast<uint8_t *>(target);
+
+			if(address + length < address)
+				return Error(KERN_INVALID_ADDRESS);
+
+			while(length > 0)
+			{
+				size_t offset = address - VM_PAGE_ALIGN_DOWN(address);
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - offset);
+
+				KernReturn<uintptr_t> physical = ResolveUserAddress(address, false);
+				if(!physical.IsValid())
+					return physical.GetError();
+
+				KernReturn<void> result = CopyFromPhysical(buffer, physical, chunk);
+				if(!result.IsValid())
+					return result;
+
+				buffer += chunk;
+				address += chunk;
+				length -= chunk;
+			}
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> Directory::CopyUserDataIn(const void *data, vm_address_t address, size_t length)
+		{
+			const uint8_t *buffer = reinterpret_cast<const uint8_t *>(data);
+
+			if(address + length < address)
+				return Error(KERN_INVALID_ADDRESS);
+
+			while(length > 0)
+			{
+				size_t offset = address - VM_PAGE_ALIGN_DOWN(address);
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - offset);
+
+				KernReturn<uintptr_t> physical = ResolveUserAddress(address, true);
+				if(!physical.IsValid())
+					return physical.GetError();
+
+				KernReturn<void> result = CopyToPhysical(physical, buffer, chunk);
+				if(!result.IsValid())
+					return result;
+
+				buffer += chunk;
+				address += chunk;
+				length -= chunk;
+			}
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> Directory::CopyDataIn(const void *data, vm_address_t address, size_t length)
+		{
+			const uint8_t *buffer = reinterpret_cast<const uint8_t *>(data);
+
+			while(length > 0)
+			{
+				size_t offset = address - VM_PAGE_ALIGN_DOWN(address);
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - offset);
+
+				KernReturn<uintptr_t> physical = ResolveAddress(address);
+				if(!physical.IsValid())
+					return physical.GetError();
+
+				KernReturn<void> result = CopyToPhysical(physical, buffer, chunk);
+				if(!result.IsValid())
+					return result;
+
+				buffer += chunk;
+				address += chunk;
+				length -= chunk;
+			}
+
+			return ErrorNone;
+		}
+
+		// --------------------
+		// MARK: -
+		// MARK: Copy window
+		// --------------------
+
+		static vm_address_t _copyWindow = 0; // CONFIG_MAX_CPUS pages, reserved in VMInit()
+
+		// Maps the page containing physical into the CPUs copy window and returns the address of physical in it.
+		// Must be called with interrupts disabled, the window (and its TLB entry) is only valid on the current CPU
+		static uint8_t *MapCopyWindow(uintptr_t physical)
+		{
+			vm_address_t window = _copyWindow + (CPU::GetCurrentCPU()->GetID() * VM_PAGE_SIZE);
+			uintptr_t page = VM_PAGE_ALIGN_DOWN(physical);
+
+			// The page table of the window already exists, so this only rewrites the entry and doesn't need the directory lock
+			__MapPageNoCheck(_kernelPageDirectory, page, window, kVMFlagsKernel, true).Suppress();
+
+			return reinterpret_cast<uint8_t *>(window + (physical - page));
+		}
+
+		KernReturn<void> CopyFromPhysical(void *target, uintptr_t physical, size_t length)
+		{
+			uint8_t *buffer = reinterpret_cast<uint8_t *>(target);
+			bool enabled = DisableInterrupts();
+
+			while(length > 0)
+			{
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - (physical - VM_PAGE_ALIGN_DOWN(physical)));
+
+				uint8_t *window = MapCopyWindow(physical);
+				memcpy(buffer, window, chunk);
+
+				buffer += chunk;
+				physical += chunk;
+				length -= chunk;
+			}
+
+			if(enabled)
+				EnableInterrupts();
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> CopyToPhysical(uintptr_t physical, const void *data, size_t length)
+		{
+			const uint8_t *buffer = reinterpret_cast<const uint8_t *>(data);
+			bool enabled = DisableInterrupts();
+
+			while(length > 0)
+			{
+				size_t chunk = std::min<size_t>(length, VM_PAGE_SIZE - (physical - VM_PAGE_ALIGN_DOWN(physical)));
+
+				uint8_t *window = MapCopyWindow(physical);
+				memcpy(window, buffer, chunk);
+
+				buffer += chunk;
+				physical += chunk;
+				length -= chunk;
+			}
+
+			if(enabled)
+				EnableInterrupts();
+
+			return ErrorNone;
+		}
+
 		KernReturn<vm_address_t> __FindFreePagesUser(uint32_t *pageDirectory, size_t pages, vm_address_t lowerLimit, vm_address_t upperLimit)
 		{
 			if((lowerLimit % VM_PAGE_SIZE) || (upperLimit % VM_PAGE_SIZE))
@@ -766,6 +962,16 @@ namespace Sys
 
 		VM::MarkMultiboot(bootInfo);
 
+		// Reserve the per CPU copy windows, they get remapped on every use
+		KernReturn<vm_address_t> window = VM::_kernelDirectory->Alloc(VM_PAGE_ALIGN_DOWN(kernelBegin), CONFIG_MAX_CPUS, kVMFlagsKernel);
+		if(!window.IsValid())
+		{
+			kprintf("Failed to reserve the copy windows!\n");
+			return window.GetError();
+		}
+
+		VM::_copyWindow = window;
+
 		// Activate the kernel directory and virtual memory
 		uint32_t cr0;
 		__asm__ volatile("mov %0, %%cr3" : : "r" (reinterpret_cast<uint32_t>(VM::_kernelPageDirectory)));
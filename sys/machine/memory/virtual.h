@@ -74,12 +74,19 @@ namespace Sys
 			KernReturn<void> MapPageRange(uintptr_t physical, vm_address_t virtAddress, size_t pages, Flags flags);
 
 			KernReturn<uintptr_t> ResolveAddress(vm_address_t address);
+			KernReturn<uintptr_t> ResolveUserAddress(vm_address_t address, bool write); // Fails for pages userland can't access
 
 			KernReturn<vm_address_t> Alloc(uintptr_t physical, size_t pages, Flags flags);
 			KernReturn<vm_address_t> AllocLimit(uintptr_t physical, vm_address_t lower, vm_address_t upper, size_t pages, Flags flags);
 			KernReturn<vm_address_t> AllocTwoSidedLimit(uintptr_t physical, vm_address_t lower, vm_address_t upper, size_t pages, Flags flags);
 			KernReturn<void> Free(vm_address_t address, size_t pages);
 
+			// Copy between the kernel and this address space without creating mappings for the whole range
+			KernReturn<void> CopyDataOut(vm_address_t address, void *target, size_t length);
+			KernReturn<void> CopyDataIn(const void *data, vm_address_t address, size_t length);
+			KernReturn<void> CopyUserDataOut(vm_address_t address, void *target, size_t length);
+			KernReturn<void> CopyUserDataIn(const void *data, vm_address_t address, size_t length);
+
 			KernReturn<vm_address_t> __Alloc_NoLockPrivate(uintptr_t physical, size_t pages, Flags flags);
 
 			uint32_t *GetPhysicalDirectory() const { return _directory; }
@@ -91,6 +98,10 @@ namespace Sys
 			spinlock_t _lock;
 		};
 
+		// Copy from and to physical memory through a per CPU window, without allocating virtual memory
+		KernReturn<void> CopyFromPhysical(void *target, uintptr_t physical, size_t length);
+		KernReturn<void> CopyToPhysical(uintptr_t physical, const void *data, size_t length);
+
 		static inline Directory::Flags TranslateMmapProtection(int protection)
 		{
 			Directory::Flags vmflags = Directory::Flags::Present;
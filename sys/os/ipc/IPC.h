@@ -24,6 +24,7 @@
 #include "IPCPort.h"
 #include "IPCSpace.h"
 #include "IPCMessage.h"
+#include "IPCRing.h"
 
 namespace OS
 {
@@ -17,6 +17,7 @@
 //
 
 #include <kern/kalloc.h>
+#include <libc/ipc/ipc_port.h>
 #include "IPCMessage.h"
 
 namespace OS
@@ -32,6 +33,8 @@ namespace OS
 
 			_header = header;
 			_ownsData = false;
+			_timestamp = 0;
+			_completionPort = IPC_PORT_NULL;
 
 			return this;
 		}
@@ -48,6 +51,8 @@ namespace OS
 
 			_header = reinterpret_cast<ipc_header_t *>(blob);
 			_ownsData = true;
+			_timestamp = 0;
+			_completionPort = IPC_PORT_NULL;
 
 			return this;
 		}
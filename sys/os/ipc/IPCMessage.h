@@ -41,6 +41,11 @@ namespace OS
 
 			ipc_header_t *GetHeader() const { return _header; }
 			ipc_port_t GetPort() const { return _header->port; }
+			uint64_t GetTimestamp() const { return _timestamp; }
+			ipc_port_t GetCompletionPort() const { return _completionPort; }
+
+			void SetTimestamp(uint64_t timestamp) { _timestamp = timestamp; }
+			void SetCompletionPort(ipc_port_t port) { _completionPort = port; }
 
 			template<class T>
 			const T *GetData() const { return reinterpret_cast<const T *>(IPC_GET_DATA(_header)); }
@@ -48,6 +53,8 @@ namespace OS
 		private:
 			ipc_header_t *_header;
 			bool _ownsData;
+			uint64_t _timestamp;
+			ipc_port_t _completionPort;
 
 			IODeclareMeta(Message)
 		};
@@ -19,6 +19,8 @@
 #include <os/scheduler/task.h>
 #include <libio/core/IONumber.h>
 #include <kern/kprintf.h>
+#include <libc/string.h>
+#include <libcpp/algorithm.h>
 #include "IPCPort.h"
 #include "IPCMessage.h"
 
@@ -38,6 +40,9 @@ namespace OS
 			_type = type;
 			_isDead = false;
 			_context = nullptr;
+			_ring = nullptr;
+
+			memset(&_statistics, 0, sizeof(Statistics));
 
 			return this;
 		}
@@ -93,6 +98,7 @@ namespace OS
 				}
 			}
 
+			IO::SafeRelease(_ring);
 			IO::Object::Dealloc();
 		}
 		
@@ -104,6 +110,9 @@ namespace OS
 
 			IO::SafeRelease(_queue);
 			IO::SafeRelease(_targetPort);
+			IO::SafeRelease(_ring);
+
+			_ring = nullptr;
 		}
 
 		void Port::SetContext(void *context)
@@ -111,6 +120,22 @@ namespace OS
 			_context = context;
 		}
 
+		void Port::SetRing(Ring *ring)
+		{
+			IO::SafeRelease(_ring);
+			_ring = IO::SafeRetain(ring);
+		}
+		Ring *Port::GetRing() const
+		{
+			if(_isDead)
+				return nullptr;
+
+			if(_type == Type::Regular && _right != Right::Receive)
+				return _targetPort->IsDead() ? nullptr : _targetPort->_ring;
+
+			return _ring;
+		}
+
 		void Port::PushMessage(Message *msg)
 		{
 			IOAssert(_right == Right::Receive, "Port must be a receive port");
@@ -119,6 +144,9 @@ namespace OS
 			{
 				case Type::Regular:
 					_queue->AddObject(msg);
+
+					_statistics.queueDepth ++;
+					_statistics.queueHighWater = std::max(_statistics.queueHighWater, _statistics.queueDepth);
 					break;
 				case Type::Callback:
 					_callback(this, msg);
@@ -140,6 +168,7 @@ namespace OS
 		{
 			IOAssert(_right == Right::Receive && _type == Type::Regular, "Port must be a regular receive port");
 			_queue->RemoveObjectAtIndex(0);
+			_statistics.queueDepth --;
 		}
 	}
 }
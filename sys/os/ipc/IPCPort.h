@@ -31,6 +31,7 @@
 #include <libio/core/IOArray.h>
 #include <libio/core/IOSet.h>
 #include "IPCMessage.h"
+#include "IPCRing.h"
 
 namespace OS
 {
@@ -60,6 +61,18 @@ namespace OS
 				Callback // A port that isn't actually attached to anything but rather invokes a kernel callback
 			};
 
+			// Protected by the lock of the owning space
+			struct Statistics
+			{
+				uint64_t messagesSent; // Send rights only
+				uint64_t bytesSent;
+				uint64_t messagesReceived; // Receive rights only
+				uint64_t bytesReceived;
+				uint32_t queueDepth;
+				uint32_t queueHighWater;
+				uint32_t deadReceiverErrors;
+			};
+
 			void Dealloc() override;
 			void MarkDead();
 
@@ -70,11 +83,16 @@ namespace OS
 			Right GetRight() const { return _right; }
 			Type GetType() const { return _type; }
 			Port *GetTarget() const { return _targetPort; }
+			const Statistics &GetStatistics() const { return _statistics; }
 
 			template<class T>
 			T *GetContext() const { return reinterpret_cast<T *>(_context); }
 
 			void SetContext(void *context);
+			void SetRing(Ring *ring);
+
+			// Receive ports return their own ring, send rights the one of their target
+			Ring *GetRing() const;
 			void PushMessage(Message *message);
 
 			Message *PeekMessage();
@@ -103,6 +121,8 @@ namespace OS
 			};
 
 			void *_context;
+			Ring *_ring;
+			Statistics _statistics;
 			
 			IODeclareMeta(Port)
 		};
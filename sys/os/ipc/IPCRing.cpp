@@ -0,0 +1,127 @@
+//
+//  IPCRing.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libc/sys/mman.h>
+#include <os/scheduler/task.h>
+#include <os/waitqueue.h>
+#include "IPCRing.h"
+
+namespace OS
+{
+	namespace IPC
+	{
+		IODefineMeta(Ring, IO::Object)
+
+		Ring *Ring::Init(size_t size)
+		{
+			if(!IO::Object::Init())
+				return nullptr;
+
+			_header = nullptr;
+			_pages = 0;
+			_size = size;
+			spinlock_init(&_lock);
+
+			if(size == 0 || size > kMaxSize || (size & (size - 1)) != 0)
+				return nullptr;
+
+			_pages = VM_PAGE_COUNT(size + IPC_RING_DATA_OFFSET);
+			_header = Sys::Alloc<ipc_ring_header_t>(Sys::VM::Directory::GetKernelDirectory(), _pages, kVMFlagsKernel);
+
+			if(!_header)
+				return nullptr;
+
+			_pmemory = Sys::VM::Directory::GetKernelDirectory()->ResolveAddress(reinterpret_cast<vm_address_t>(_header));
+
+			memset(_header, 0, _pages * VM_PAGE_SIZE);
+			_header->size = static_cast<unsigned int>(size);
+
+			return this;
+		}
+
+		void Ring::Dealloc()
+		{
+			if(_header)
+				Sys::Free(_header, Sys::VM::Directory::GetKernelDirectory(), _pages);
+
+			IO::Object::Dealloc();
+		}
+
+		KernReturn<vm_address_t> Ring::MapIntoTask(Task *task)
+		{
+			Sys::VM::Directory *directory = task->GetDirectory();
+
+			KernReturn<vm_address_t> vmemory = directory->Alloc(_pmemory, _pages, kVMFlagsUserlandRW);
+			if(!vmemory.IsValid())
+				return vmemory.GetError();
+
+			MmapTaskEntry *entry = new MmapTaskEntry(nullptr);
+			if(!entry)
+			{
+				directory->Free(vmemory, _pages);
+				return Error(KERN_NO_MEMORY);
+			}
+
+			// The pages belong to the ring, so the entry keeps it alive for as long as the mapping exists
+			entry->phaddress = _pmemory;
+			entry->vmaddress = vmemory;
+			entry->protection = PROT_READ | PROT_WRITE;
+			entry->pages = _pages;
+			entry->flags = MAP_SHARED | MAP_ANONYMOUS;
+			entry->offset = 0;
+			entry->object = Retain();
+
+			task->Lock();
+			task->mmapList.push_front(entry->taskEntry);
+			task->Unlock();
+
+			return vmemory;
+		}
+
+		KernReturn<void> Ring::Wait(Thread *thread, size_t offset, uint32_t expected)
+		{
+			if(offset > sizeof(ipc_ring_header_t) - sizeof(uint32_t) || (offset % sizeof(uint32_t)) != 0)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			const volatile uint32_t *word = reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(_header) + offset);
+
+			// The peer publishes its index before checking the waiting flag and Notify() takes
+			// the same lock, so a wakeup can't slip in between the check and the wait
+			spinlock_lock(&_lock);
+
+			if(*word != expected)
+			{
+				spinlock_unlock(&_lock);
+				return ErrorNone;
+			}
+
+			KernReturn<void> result = WaitThread(thread, this);
+			spinlock_unlock(&_lock);
+
+			return result;
+		}
+
+		void Ring::Notify()
+		{
+			spinlock_lock(&_lock);
+			Wakeup(this);
+			spinlock_unlock(&_lock);
+		}
+	}
+}
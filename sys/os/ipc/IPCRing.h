@@ -0,0 +1,69 @@
+//
+//  IPCRing.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _IPCRING_H_
+#define _IPCRING_H_
+
+#include <prefix.h>
+#include <kern/kern_return.h>
+#include <libc/stdint.h>
+#include <libc/sys/spinlock.h>
+#include <libc/ipc/ipc_ring.h>
+#include <libio/core/IOObject.h>
+#include <machine/memory/memory.h>
+
+namespace OS
+{
+	class Task;
+	class Thread;
+
+	namespace IPC
+	{
+		// Shared memory ring between two tasks. The ring is attached to a receive port,
+		// the peer gets to it through a send right to that port. Data is moved entirely
+		// in userland, the kernel only brokers the mapping and provides the doorbell
+		class Ring : public IO::Object
+		{
+		public:
+			static constexpr size_t kMaxSize = 256 * VM_PAGE_SIZE;
+
+			Ring *Init(size_t size);
+			void Dealloc() override;
+
+			KernReturn<vm_address_t> MapIntoTask(Task *task);
+
+			// Blocks the thread unless the word at offset in the header differs from expected
+			KernReturn<void> Wait(Thread *thread, size_t offset, uint32_t expected);
+			void Notify();
+
+			size_t GetPages() const { return _pages; }
+			size_t GetSize() const { return _size; } // Size of the data area, the header copy is writeable by both peers
+
+		private:
+			ipc_ring_header_t *_header; // Kernel side mapping of the shared pages
+			uintptr_t _pmemory;
+			size_t _pages;
+			size_t _size;
+			spinlock_t _lock;
+
+			IODeclareMeta(Ring)
+		};
+	}
+}
+
+#endif /* _IPCRING_H_ */
@@ -17,7 +17,11 @@
 //
 
 #include <libio/core/IONumber.h>
+#include <libio/core/IOArray.h>
+#include <machine/cpu.h>
 #include <os/waitqueue.h>
+#include <os/interruptguard.h>
+#include <os/workqueue.h>
 #include <kern/kprintf.h>
 #include <libc/ipc/ipc_message.h>
 #include "IPCSpace.h"
@@ -29,11 +33,25 @@ namespace OS
 	{
 		IODefineMeta(Space, IO::Object)
 
-		static IO::Dictionary *_spaceMap;
-		static Mutex _spaceLock;
+		// Spaces are hashed by name into shards with their own lock, so lookups of
+		// different spaces don't serialize on one global lock. Each shard retains its spaces
+		static constexpr size_t kSpaceShardCount = 16;
+
+		struct SpaceShard
+		{
+			spinlock_t lock;
+			Space *head;
+		};
+
+		static SpaceShard _spaceShards[kSpaceShardCount];
 		static std::atomic<ipc_space_t> _spaceName;
 		static Space *_kernelSpace;
 
+		static inline SpaceShard *GetShardForName(ipc_space_t name)
+		{
+			return _spaceShards + (name % kSpaceShardCount);
+		}
+
 		Space *Space::Init()
 		{
 			if(!IO::Object::Init())
@@ -43,18 +61,25 @@ namespace OS
 			_name = _spaceName ++;
 			_portNames = 1;
 
+			_asyncQueue = IO::Array::Alloc()->Init();
+			_asyncScheduled = false;
+			spinlock_init(&_asyncLock);
+
 			{
-				_spaceLock.Lock();
+				SpaceShard *shard = GetShardForName(_name);
 
-				IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(_name)));
-				_spaceMap->SetObjectForKey(this, lookup);
+				spinlock_lock(&shard->lock);
 
-				if(!_kernelSpace)
-					_kernelSpace = this;
+				_shardNext = shard->head;
+				shard->head = Retain();
 
-				_spaceLock.Unlock();
+				spinlock_unlock(&shard->lock);
 			}
 
+			// The kernel task creates the very first space before any other CPU can
+			if(!_kernelSpace)
+				_kernelSpace = this;
+
 			return this;
 		}
 		void Space::Dealloc()
@@ -65,14 +90,19 @@ namespace OS
 
 		IO::StrongRef<Space> Space::GetSpaceWithName(ipc_space_t name)
 		{
-			_spaceLock.Lock();
+			SpaceShard *shard = GetShardForName(name);
 
-			IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(name)));
-			IO::StrongRef<Space> space = _spaceMap->GetObjectForKey<Space>(lookup);
+			spinlock_lock(&shard->lock);
+
+			Space *space = shard->head;
+			while(space && space->_name != name)
+				space = space->_shardNext;
 
-			_spaceLock.Unlock();
+			IO::StrongRef<Space> result(space);
 
-			return space;
+			spinlock_unlock(&shard->lock);
+
+			return result;
 		}
 
 		Space *Space::GetKernelSpace()
@@ -80,6 +110,28 @@ namespace OS
 			return _kernelSpace;
 		}
 
+		void Space::EnumerateSpaces(const IO::Function<void (Space *)> &callback)
+		{
+			IO::StrongRef<IO::Array> spaces(IOTransferRef(IO::Array::Alloc()->Init()));
+
+			// Snapshot the spaces so the callback can take space locks without holding a shard lock
+			for(size_t i = 0; i < kSpaceShardCount; i ++)
+			{
+				SpaceShard *shard = _spaceShards + i;
+
+				spinlock_lock(&shard->lock);
+
+				for(Space *space = shard->head; space; space = space->_shardNext)
+					spaces->AddObject(space);
+
+				spinlock_unlock(&shard->lock);
+			}
+
+			spaces->Enumerate<Space>([&](Space *space, __unused size_t index, __unused bool &stop) {
+				callback(space);
+			});
+		}
+
 		void Space::Lock()
 		{
 			_lock.Lock();
@@ -89,6 +141,53 @@ namespace OS
 			_lock.Unlock();
 		}
 
+		void Space::LockPair(Space *first, Space *second)
+		{
+			if(first == second)
+			{
+				first->Lock();
+				return;
+			}
+
+			if(first > second)
+			{
+				Space *temp = first;
+
+				first = second;
+				second = temp;
+			}
+
+			first->Lock();
+			second->Lock();
+		}
+		void Space::UnlockPair(Space *first, Space *second)
+		{
+			if(first != second)
+				second->Unlock();
+
+			first->Unlock();
+		}
+
+		bool Space::LockTarget(Space *target)
+		{
+			if(target == this || this < target)
+			{
+				if(target != this)
+					target->Lock();
+
+				return true;
+			}
+
+			if(target->_lock.TryLock(Mutex::Mode::Simple))
+				return true;
+
+			// Taking the target lock now would invert the lock order, so back off and take both in order
+			Unlock();
+			LockPair(this, target);
+
+			return false;
+		}
+
 		KernReturn<Port *> Space::AllocateReceivePort()
 		{
 			while(1)
@@ -96,7 +195,7 @@ namespace OS
 				ipc_port_t name = _portNames ++;
 				IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(name)));
 
-				if(!_spaceMap->GetObjectForKey<Port>(lookup))
+				if(!_ports->GetObjectForKey<Port>(lookup))
 				{
 					Port *port = Port::Alloc()->InitWithReceiveRight(this, name);
 					if(!port)
@@ -121,7 +220,7 @@ namespace OS
 					ipc_port_t name = _portNames ++;
 					IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(name)));
 
-					if(!_spaceMap->GetObjectForKey<Port>(lookup))
+					if(!_ports->GetObjectForKey<Port>(lookup))
 					{
 						Port *port = Port::Alloc()->InitWithSendRight(this, name, right, target);
 						if(!port)
@@ -136,7 +235,7 @@ namespace OS
 			{
 				IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(name)));
 
-				if(_spaceMap->GetObjectForKey<Port>(lookup))
+				if(_ports->GetObjectForKey<Port>(lookup))
 					return Error(KERN_RESOURCE_EXISTS);
 
 				Port *port = Port::Alloc()->InitWithSendRight(this, name, right, target);
@@ -156,7 +255,7 @@ namespace OS
 				ipc_port_t name = _portNames ++;
 				IO::StrongRef<IO::Number> lookup(IOTransferRef(IO::Number::Alloc()->InitWithUint32(name)));
 
-				if(!_spaceMap->GetObjectForKey<Port>(lookup))
+				if(!_ports->GetObjectForKey<Port>(lookup))
 				{
 					Port *port = Port::Alloc()->InithWithCallback(this, name, callback);
 					if(!port)
@@ -182,8 +281,16 @@ namespace OS
 			return _ports->GetObjectForKey<Port>(lookup);
 		}
 
+		void Space::EnumeratePorts(const IO::Function<void (Port *)> &callback) const
+		{
+			_ports->Enumerate<Port, IO::Number>([&](Port *port, __unused IO::Number *key, __unused bool &stop) {
+				callback(port);
+			});
+		}
+
 		KernReturn<void> Space::Write(Message *message)
 		{
+		writeRetry:
 			Port *sender = GetPortWithName(message->GetPort());
 
 			if(!sender || sender->GetRight() == Port::Right::Receive)
@@ -191,17 +298,39 @@ namespace OS
 
 			Port *target = sender->GetTarget();
 			if(!target || target->IsDead())
+			{
+				sender->_statistics.deadReceiverErrors ++;
 				return Error(KERN_IPC_NO_RECEIVER);
+			}
 
 			Space *targetSpace = target->GetSpace();
 
-			if(targetSpace != this)
-				targetSpace->Lock();
+			{
+				IO::StrongRef<Port> targetRef(target);
 
-			Message *copy = Message::Alloc()->InitAsCopy(message);
+				if(!LockTarget(targetSpace))
+				{
+					// Our lock was dropped in between, make sure the sender still points to the same target
+					Port *current = GetPortWithName(message->GetPort());
+
+					if(current != sender || current->GetTarget() != target)
+					{
+						targetSpace->Unlock();
+						goto writeRetry;
+					}
+				}
+			}
 
 			if(target->IsDead())
+			{
+				if(targetSpace != this)
+					targetSpace->Unlock();
+
+				sender->_statistics.deadReceiverErrors ++;
 				return Error(KERN_IPC_NO_RECEIVER);
+			}
+
+			Message *copy = Message::Alloc()->InitAsCopy(message);
 
 			ipc_header_t *header = copy->GetHeader();
 			header->port = target->GetName();
@@ -253,6 +382,10 @@ namespace OS
 				}
 			}
 
+			sender->_statistics.messagesSent ++;
+			sender->_statistics.bytesSent += header->size;
+
+			copy->SetTimestamp(Sys::CPUReadTimestamp());
 			target->PushMessage(copy);
 			copy->Release();
 
@@ -267,6 +400,122 @@ namespace OS
 			return ErrorNone;
 		}
 
+		KernReturn<void> Space::WriteAsync(Message *message, ipc_port_t completion)
+		{
+			Message *copy = Message::Alloc()->InitAsCopy(message);
+			if(!copy)
+				return Error(KERN_NO_MEMORY);
+
+			copy->SetCompletionPort(completion);
+
+			spinlock_lock(&_asyncLock);
+
+			if(_asyncQueue->GetCount() >= kAsyncQueueLimit)
+			{
+				spinlock_unlock(&_asyncLock);
+				copy->Release();
+
+				return Error(KERN_RESOURCE_EXHAUSTED);
+			}
+
+			_asyncQueue->AddObject(copy);
+
+			bool schedule = !_asyncScheduled;
+			_asyncScheduled = true;
+
+			spinlock_unlock(&_asyncLock);
+
+			copy->Release();
+
+			if(schedule)
+			{
+				Retain();
+
+				bool pushed;
+
+				{
+					InterruptGuard guard(InterruptGuard::Mode::DisableInterrupts);
+					pushed = Sys::CPU::GetCurrentCPU()->GetWorkQueue()->PushEntry(&Space::FlushAsyncQueue, this);
+				}
+
+				if(!pushed)
+					FlushAsyncQueue(this); // Flush it ourselves then
+			}
+
+			return ErrorNone;
+		}
+
+		void Space::FlushAsyncQueue(void *context)
+		{
+			Space *space = reinterpret_cast<Space *>(context);
+
+			while(1)
+			{
+				spinlock_lock(&space->_asyncLock);
+
+				if(space->_asyncQueue->GetCount() == 0)
+				{
+					space->_asyncScheduled = false;
+					spinlock_unlock(&space->_asyncLock);
+
+					break;
+				}
+
+				Message *message = space->_asyncQueue->GetFirstObject<Message>();
+				message->Retain();
+
+				space->_asyncQueue->RemoveObjectAtIndex(0);
+				spinlock_unlock(&space->_asyncLock);
+
+				space->Lock();
+
+				KernReturn<void> result = space->Write(message);
+				if(!result.IsValid())
+					space->PostCompletion(message, result.GetError());
+
+				space->Unlock();
+
+				message->Release();
+			}
+
+			space->Release();
+		}
+
+		void Space::PostCompletion(Message *message, Error error)
+		{
+			Port *port = GetPortWithName(message->GetCompletionPort());
+
+			if(!port || port->IsDead() || port->GetType() != Port::Type::Regular || port->GetRight() != Port::Right::Receive)
+				return;
+
+			struct
+			{
+				ipc_header_t header;
+				ipc_completion_t completion;
+			} buffer;
+
+			buffer.header.port = IPC_PORT_NULL; // Becomes the reply port on the receiving end
+			buffer.header.reply = port->GetName();
+			buffer.header.id = message->GetHeader()->id;
+			buffer.header.flags = 0;
+			buffer.header.size = sizeof(ipc_completion_t);
+
+			buffer.completion.result = error.GetCode();
+			buffer.completion.port = message->GetPort();
+
+			IO::StrongRef<Message> notification(IOTransferRef(Message::Alloc()->Init(&buffer.header)));
+			Message *copy = Message::Alloc()->InitAsCopy(notification);
+
+			if(!copy)
+				return;
+
+			copy->SetTimestamp(Sys::CPUReadTimestamp());
+			port->PushMessage(copy);
+			copy->Release();
+
+			Wakeup(port);
+		}
+
 		KernReturn<void> Space::Read(Message *message)
 		{
 			IO::StrongRef<Port> receiver = GetPortWithName(message->GetPort());
@@ -308,6 +557,11 @@ namespace OS
 			queuedMessage->Retain();
 			receiver->PopMessage();
 
+			receiver->_statistics.messagesReceived ++;
+			receiver->_statistics.bytesReceived += queuedHeader->size;
+
+			_latency.Record(Sys::CPUReadTimestamp() - queuedMessage->GetTimestamp());
+
 			header->id = queuedHeader->id;
 			header->reply = queuedHeader->port;
 			header->port = queuedHeader->reply;
@@ -321,10 +575,11 @@ namespace OS
 
 	KernReturn<void> IPCInit()
 	{
-		IPC::_spaceMap = IO::Dictionary::Alloc()->Init();
-
-		if(!IPC::_spaceMap)
-			return Error(KERN_NO_MEMORY);
+		for(size_t i = 0; i < IPC::kSpaceShardCount; i ++)
+		{
+			spinlock_init(&IPC::_spaceShards[i].lock);
+			IPC::_spaceShards[i].head = nullptr;
+		}
 
 		return ErrorNone;
 	}
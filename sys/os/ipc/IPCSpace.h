@@ -22,6 +22,8 @@
 #include <prefix.h>
 #include <libio/core/IOObject.h>
 #include <libio/core/IODictionary.h>
+#include <libio/core/IOFunction.h>
+#include <kern/histogram.h>
 #include <os/locks/mutex.h>
 #include <libc/ipc/ipc_types.h>
 #include "IPCPort.h"
@@ -34,6 +36,14 @@ namespace OS
 	{
 		class Message;
 
+		/**
+		 * Lock order:
+		 * 1. Space locks. When two spaces need to be locked at the same time, the one with
+		 *    the lower address is taken first. Use LockPair() or, with one space already locked,
+		 *    LockTarget() which backs off and relocks when the order would be violated.
+		 * 2. The async queue lock of a space. Never held while taking a space lock.
+		 * 3. The registry shard locks. Leaf locks, nothing is taken while holding one.
+		 **/
 		class Space : public IO::Object
 		{
 		public:
@@ -42,6 +52,7 @@ namespace OS
 
 			static IO::StrongRef<Space> GetSpaceWithName(ipc_space_t name);
 			static Space *GetKernelSpace();
+			static void EnumerateSpaces(const IO::Function<void (Space *)> &callback);
 
 			KernReturn<Port *> AllocateReceivePort(); // Creates a new port with receive rights
 			KernReturn<Port *> AllocateSendPort(Port *target, Port::Right right, ipc_port_t name); // Right must be either Send or SendOnce
@@ -50,23 +61,48 @@ namespace OS
 			void DeallocatePort(Port *port);
 
 			Port *GetPortWithName(ipc_port_t name) const;
+			void EnumeratePorts(const IO::Function<void (Port *)> &callback) const; // Must be called with the lock being held
 
 			/** Must *both* be called with lock being held **/
 			KernReturn<void> Write(Message *message);
 			KernReturn<void> Read(Message *message);
 
+			// Copies the message and queues it for the kernel worker, doesn't need the lock
+			// Failures are posted to the completion port, which must be a receive right of this space
+			// Fails with KERN_RESOURCE_EXHAUSTED while kAsyncQueueLimit messages are pending
+			KernReturn<void> WriteAsync(Message *message, ipc_port_t completion);
+
 			ipc_space_t GetName() const { return _name; }
 			Task *GetTask() const { return _task; }
+			const Histogram &GetLatencyHistogram() const { return _latency; } // Send to receive latency in TSC cycles
 
 			void Lock();
 			void Unlock();
 
+			static void LockPair(Space *first, Space *second);
+			static void UnlockPair(Space *first, Space *second);
+
+			// Must be called with the lock held. Returns false if the lock had to be dropped temporarily,
+			// in which case anything looked up before has to be validated again
+			bool LockTarget(Space *target);
+
+			static constexpr size_t kAsyncQueueLimit = 256;
+
 		private:
+			static void FlushAsyncQueue(void *context);
+			void PostCompletion(Message *message, Error error);
+
 			ipc_space_t _name;
+			Space *_shardNext;
 			IO::Dictionary *_ports;
 			Task *_task;
 			Mutex _lock;
 			ipc_port_t _portNames;
+			Histogram _latency;
+
+			IO::Array *_asyncQueue;
+			spinlock_t _asyncLock;
+			bool _asyncScheduled;
 
 			IODeclareMeta(Space)
 		};
@@ -0,0 +1,95 @@
+//
+//  IPCStatistics.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <kern/kalloc.h>
+#include <kern/statistics_writer.h>
+#include "IPCStatistics.h"
+#include "IPCSpace.h"
+
+namespace OS
+{
+	namespace IPC
+	{
+		static constexpr size_t kStatisticsBufferSize = 8 * VM_PAGE_SIZE;
+
+		static const char *GetRightName(Port *port)
+		{
+			if(port->GetType() == Port::Type::Callback)
+				return "callback";
+
+			switch(port->GetRight())
+			{
+				case Port::Right::Receive:
+					return "receive";
+				case Port::Right::Send:
+					return "send";
+				case Port::Right::SendOnce:
+					return "send-once";
+			}
+
+			return "dead";
+		}
+
+		static void WriteSpace(StatisticsWriter &writer, Space *space)
+		{
+			space->Lock();
+
+			const Histogram &latency = space->GetLatencyHistogram();
+
+			writer.Print("space %u: %u messages, max latency %u cycles\n", (uint32_t)space->GetName(), (uint32_t)latency.GetCount(), (uint32_t)latency.GetMax());
+
+			for(size_t i = 0; i < Histogram::kBuckets; i ++)
+			{
+				if(latency.GetBucket(i))
+					writer.Print("  latency < 2^%u: %u\n", (uint32_t)(i + 1), (uint32_t)latency.GetBucket(i));
+			}
+
+			space->EnumeratePorts([&](Port *port) {
+
+				const Port::Statistics &statistics = port->GetStatistics();
+
+				writer.Print("  port %u (%s): sent %u/%u bytes, received %u/%u bytes, queue %u, high water %u, dead receiver %u\n",
+					(uint32_t)port->GetName(), GetRightName(port),
+					(uint32_t)statistics.messagesSent, (uint32_t)statistics.bytesSent,
+					(uint32_t)statistics.messagesReceived, (uint32_t)statistics.bytesReceived,
+					statistics.queueDepth, statistics.queueHighWater, statistics.deadReceiverErrors);
+
+			});
+
+			space->Unlock();
+		}
+
+		size_t StatisticsRead(__unused void *memo, VFS::Context *context, off_t offset, void *data, size_t size)
+		{
+			char *buffer = static_cast<char *>(kalloc(kStatisticsBufferSize));
+			if(!buffer)
+				return static_cast<size_t>(-1);
+
+			StatisticsWriter writer(buffer, kStatisticsBufferSize);
+
+			Space::EnumerateSpaces([&](Space *space) {
+				WriteSpace(writer, space);
+			});
+
+			size_t result = writer.CopyOut(context, offset, data, size);
+
+			kfree(buffer);
+			return result;
+		}
+	}
+}
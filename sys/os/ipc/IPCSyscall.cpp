@@ -47,7 +47,7 @@ namespace OS
 
 		KernReturn<uint32_t> Syscall_IPCMessage(Thread *thread, IPCReadWriteArgs *arguments)
 		{
-			if(arguments->size == 0 || (arguments->mode != IPC_WRITE && arguments->mode != IPC_READ))
+			if(arguments->size == 0 || (arguments->mode != IPC_WRITE && arguments->mode != IPC_READ && arguments->mode != IPC_WRITE_ASYNC))
 				return KERN_INVALID_ARGUMENT;
 
 			Space *space = thread->GetTask()->GetIPCSpace();
@@ -57,6 +57,19 @@ namespace OS
 			
 			KernReturn<void> result;
 
+			if(arguments->mode == IPC_WRITE_ASYNC)
+			{
+				// Only copies the message, the send happens later without the sender waiting on any space lock
+				Message *message = Message::Alloc()->Init(header);
+				result = space->WriteAsync(message, arguments->completion);
+				message->Release();
+
+				if(!result.IsValid())
+					return result.GetError();
+
+				return KERN_SUCCESS;
+			}
+
 			space->Lock();
 
 			switch(arguments->mode)
@@ -171,24 +184,12 @@ namespace OS
 				return Error(KERN_INVALID_ARGUMENT);
 
 			Space *source = thread->GetTask()->GetIPCSpace();
-			bool differentLocks = (source != space);
-
-			Space *space1 = (source < space.Load()) ? source : space.Load();
-			Space *space2 = (source < space.Load()) ? space.Load() : source;
-
-			space1->Lock();
-
-			if(differentLocks)
-				space2->Lock();
+			Space::LockPair(source, space);
 
 			Port *port = source->GetPortWithName(arguments->port);
 			if(!port || port->GetRight() != Port::Right::Receive)
 			{
-				space2->Unlock();
-
-				if(differentLocks)
-					space1->Unlock();
-
+				Space::UnlockPair(source, space);
 				return Error(KERN_INVALID_ARGUMENT);
 			}
 
@@ -205,16 +206,138 @@ namespace OS
 			}
 
 			KernReturn<Port *> target = space->AllocateSendPort(port, right, arguments->target);
-
-			space2->Unlock();
-
-			if(differentLocks)
-				space1->Unlock();
+			Space::UnlockPair(source, space);
 
 			if(!target.IsValid())
 				return target.GetError();
 
 			return KERN_SUCCESS;
 		}
+
+		static Ring *CopyRingForPort(Space *space, ipc_port_t name)
+		{
+			space->Lock();
+
+			Port *port = space->GetPortWithName(name);
+			if(!port)
+			{
+				space->Unlock();
+				return nullptr;
+			}
+
+			IO::StrongRef<Port> portRef(port);
+
+			Port *target = (port->GetRight() == Port::Right::Receive) ? port : port->GetTarget();
+			Space *targetSpace = target ? target->GetSpace() : nullptr;
+
+			if(targetSpace)
+				space->LockTarget(targetSpace); // The port is retained, so it's fine if the lock gets dropped in between
+
+			Ring *ring = IO::SafeRetain(port->GetRing());
+
+			if(targetSpace && targetSpace != space)
+				targetSpace->Unlock();
+
+			space->Unlock();
+
+			return ring;
+		}
+
+		KernReturn<uint32_t> Syscall_IPCRingCreate(Thread *thread, IPCRingCreateArgs *arguments)
+		{
+			size_t size = arguments->size;
+
+			if(size == 0 || size > Ring::kMaxSize || (size & (size - 1)) != 0)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			OS::SyscallScopedMapping addressMapping(thread->GetTask(), arguments->address, sizeof(void *));
+			void **address = addressMapping.GetMemory<void *>();
+
+			Task *task = thread->GetTask();
+			Space *space = task->GetIPCSpace();
+
+			space->Lock();
+
+			Port *port = space->GetPortWithName(arguments->port);
+			if(!port || port->GetType() != Port::Type::Regular || port->GetRight() != Port::Right::Receive || port->GetRing())
+			{
+				space->Unlock();
+				return Error(KERN_INVALID_ARGUMENT);
+			}
+
+			Ring *ring = Ring::Alloc()->Init(size);
+			if(!ring)
+			{
+				space->Unlock();
+				return Error(KERN_NO_MEMORY);
+			}
+
+			port->SetRing(ring);
+			space->Unlock();
+
+			KernReturn<vm_address_t> result = ring->MapIntoTask(task);
+			ring->Release();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			*address = reinterpret_cast<void *>(result.Get());
+
+			return KERN_SUCCESS;
+		}
+
+		KernReturn<uint32_t> Syscall_IPCRingMap(Thread *thread, IPCRingMapArgs *arguments)
+		{
+			OS::SyscallScopedMapping addressMapping(thread->GetTask(), arguments->address, sizeof(void *));
+			void **address = addressMapping.GetMemory<void *>();
+
+			OS::SyscallScopedMapping sizeMapping(thread->GetTask(), arguments->size, sizeof(size_t));
+			size_t *size = sizeMapping.GetMemory<size_t>();
+
+			Task *task = thread->GetTask();
+
+			Ring *ring = CopyRingForPort(task->GetIPCSpace(), arguments->port);
+			if(!ring)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			KernReturn<vm_address_t> result = ring->MapIntoTask(task);
+			size_t ringSize = ring->GetSize();
+			ring->Release();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			*address = reinterpret_cast<void *>(result.Get());
+			*size = ringSize;
+
+			return KERN_SUCCESS;
+		}
+
+		KernReturn<uint32_t> Syscall_IPCRingWait(Thread *thread, IPCRingWaitArgs *arguments)
+		{
+			Ring *ring = CopyRingForPort(thread->GetTask()->GetIPCSpace(), arguments->port);
+			if(!ring)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			KernReturn<void> result = ring->Wait(thread, arguments->offset, arguments->expected);
+			ring->Release();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			return KERN_SUCCESS;
+		}
+
+		KernReturn<uint32_t> Syscall_IPCRingNotify(Thread *thread, IPCRingNotifyArgs *arguments)
+		{
+			Ring *ring = CopyRingForPort(thread->GetTask()->GetIPCSpace(), arguments->port);
+			if(!ring)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			ring->Notify();
+			ring->Release();
+
+			return KERN_SUCCESS;
+		}
 	}
 }
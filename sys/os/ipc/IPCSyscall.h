@@ -39,6 +39,7 @@ namespace OS
 			ipc_header_t *header;
 			ipc_size_t size;
 			int mode;
+			ipc_port_t completion; // IPC_WRITE_ASYNC only
 		} __attribute__((packed));
 
 		struct IPCSpecialPortArgs
@@ -60,6 +61,32 @@ namespace OS
 			int right;
 		} __attribute__((packed));
 
+		struct IPCRingCreateArgs
+		{
+			ipc_port_t port;
+			size_t size;
+			void **address;
+		} __attribute__((packed));
+
+		struct IPCRingMapArgs
+		{
+			ipc_port_t port;
+			void **address;
+			size_t *size;
+		} __attribute__((packed));
+
+		struct IPCRingWaitArgs
+		{
+			ipc_port_t port;
+			uint32_t offset;
+			uint32_t expected;
+		} __attribute__((packed));
+
+		struct IPCRingNotifyArgs
+		{
+			ipc_port_t port;
+		} __attribute__((packed));
+
 		KernReturn<uint32_t> Syscall_IPCTaskPort(Thread *thread, IPCPortCallArgs *args);
 		KernReturn<uint32_t> Syscall_IPCThreadPort(Thread *thread, IPCPortCallArgs *args);
 		KernReturn<uint32_t> Syscall_IPCMessage(Thread *thread, IPCReadWriteArgs *args);
@@ -68,5 +95,9 @@ namespace OS
 		KernReturn<uint32_t> Syscall_IPCDeallocatePort(Thread *thread, IPCDeallcoatePortArgs *args);
 		KernReturn<uint32_t> Syscall_IPCTaskSpace(Thread *thread, IPCTaskSpaceCallArgs *args);
 		KernReturn<uint32_t> Syscall_IPCInsertPort(Thread *thread, IPCInsertPortArgs *args);
+		KernReturn<uint32_t> Syscall_IPCRingCreate(Thread *thread, IPCRingCreateArgs *args);
+		KernReturn<uint32_t> Syscall_IPCRingMap(Thread *thread, IPCRingMapArgs *args);
+		KernReturn<uint32_t> Syscall_IPCRingWait(Thread *thread, IPCRingWaitArgs *args);
+		KernReturn<uint32_t> Syscall_IPCRingNotify(Thread *thread, IPCRingNotifyArgs *args);
 	}
 }
@@ -25,6 +25,7 @@
 #include <libio/core/IODictionary.h>
 #include <os/scheduler/scheduler.h>
 #include <os/ipc/IPC.h>
+#include <libc/ipc/ipc_bootstrap.h>
 
 namespace OS
 {
@@ -113,6 +114,97 @@ namespace OS
 		message->Release();
 	}
 
+	// Resolves up to IPC_BOOTSTRAP_BATCH_MAX names at once. A message can only carry a single
+	// port right, so the send rights are inserted directly into the space of the requester
+	void BootstrapServerLookupBatch(IPC::Space *space, ipc_header_t *inHeader)
+	{
+		char replyBuffer[sizeof(ipc_header_t) + IPC_BOOTSTRAP_BATCH_MAX * sizeof(ipc_bootstrap_batch_entry_t)];
+
+		ipc_header_t *header = (ipc_header_t *)replyBuffer;
+		ipc_bootstrap_batch_entry_t *entries = (ipc_bootstrap_batch_entry_t *)IPC_GET_DATA(header);
+
+		space->Lock();
+
+		IPC::Port *replyPort = space->GetPortWithName(inHeader->port);
+		IPC::Port *receiver = replyPort ? replyPort->GetTarget() : nullptr;
+
+		if(!receiver || receiver->IsDead())
+		{
+			space->Unlock();
+			return;
+		}
+
+		IPC::Space *target = receiver->GetSpace();
+
+		if(!space->LockTarget(target))
+		{
+			if(space->GetPortWithName(inHeader->port) != replyPort || receiver->IsDead())
+			{
+				IPC::Space::UnlockPair(space, target);
+				return;
+			}
+		}
+
+		const char *names = reinterpret_cast<const char *>(IPC_GET_DATA(inHeader));
+		size_t size = inHeader->size;
+		size_t offset = 0;
+		size_t count = 0;
+
+		while(offset < size && count < IPC_BOOTSTRAP_BATCH_MAX)
+		{
+			char buffer[IPC_BOOTSTRAP_NAME_MAX + 1];
+
+			// The last name may not be terminated within the payload, never read past it
+			size_t length = strnlen_np(names + offset, size - offset);
+			size_t copy = std::min(length, sizeof(buffer) - 1);
+
+			memcpy(buffer, names + offset, copy);
+			buffer[copy] = '\0';
+
+			offset += length + 1;
+
+			ipc_bootstrap_batch_entry_t *entry = entries + (count ++);
+			entry->result = KERN_RESOURCE_NOT_FOUND;
+			entry->port = IPC_PORT_NULL;
+
+			IO::String *string = IO::String::Alloc()->InitWithCString(buffer, false);
+			IO::Number *portNumber = _bootstrapPorts->GetObjectForKey<IO::Number>(string);
+
+			string->Release();
+
+			IPC::Port *registered = portNumber ? space->GetPortWithName(portNumber->GetUint32Value()) : nullptr;
+			IPC::Port *service = registered ? registered->GetTarget() : nullptr;
+
+			if(service && !service->IsDead())
+			{
+				KernReturn<IPC::Port *> mapped = target->AllocateSendPort(service, IPC::Port::Right::Send, IPC_PORT_NULL);
+				if(mapped.IsValid())
+				{
+					entry->result = KERN_SUCCESS;
+					entry->port = mapped->GetName();
+				}
+			}
+		}
+
+		if(target != space)
+			target->Unlock();
+
+		header->port = inHeader->port;
+		header->flags = 0;
+		header->size = count * sizeof(ipc_bootstrap_batch_entry_t);
+
+		IPC::Message *message = IPC::Message::Alloc()->Init(header);
+
+		KernReturn<void> result = space->Write(message);
+		if(!result.IsValid())
+		{
+			kprintf("Result: %d\n", result.GetError().GetCode());
+		}
+		space->Unlock();
+
+		message->Release();
+	}
+
 	void BootstrapServerThread()
 	{
 		_bootstrapPorts = IO::Dictionary::Alloc()->Init();
@@ -143,15 +235,18 @@ namespace OS
 				{
 					switch(header->id)
 					{
-						case 0: // ipc_bootstrap_register
+						case IPC_BOOTSTRAP_REGISTER:
 							BootstrapServerRegister(header);
 							break;
-						case 1: // ipc_bootstrap_lookup
+						case IPC_BOOTSTRAP_LOOKUP:
 							BootstrapServerLookup(space, header);
 							break;
-						case 2: // ipc_bootstrap_unregister,
+						case IPC_BOOTSTRAP_UNREGISTER:
 							BootstrapServerUnregister(header);
 							break;
+						case IPC_BOOTSTRAP_LOOKUP_BATCH:
+							BootstrapServerLookupBatch(space, header);
+							break;
 
 						default:
 							kprintf("Invalid bootstrap request %lu\n", header->id);
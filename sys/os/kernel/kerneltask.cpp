@@ -21,8 +21,9 @@
 #include <machine/interrupts/interrupts.h>
 #include <os/scheduler/scheduler.h>
 #include <os/waitqueue.h>
+#include <os/workqueue.h>
+#include <os/interruptguard.h>
 #include <os/ipc/IPC.h>
-#include <os/locks/mutex.h>
 #include <libc/ipc/ipc_message.h>
 
 namespace Sys
@@ -32,82 +33,110 @@ namespace Sys
 
 namespace OS
 {
-	void KernelWorkThread()
+	// Pool of kernel workers draining the per CPU work queues. Every worker takes a single
+	// entry at a time, so a callback that blocks only ties up its own worker. When all workers
+	// are busy and there is still work left, the pool grows by another worker
+	static constexpr size_t kWorkersPerCPU = 2;
+	static constexpr size_t kMaxWorkersPerCPU = 8;
+
+	static std::atomic<uint32_t> _workerCount;
+	static std::atomic<uint32_t> _busyWorkers;
+	static std::atomic<uint32_t> _workerCursor; // Spreads the starting queue between workers
+
+	void KernelWorkThread();
+
+	static void SpawnKernelWorker()
 	{
-		struct WorkProxy
-		{
-			WorkQueue::Entry *entries;
-			WorkQueue *queue;
-		};
+		uint32_t limit = static_cast<uint32_t>(Sys::CPU::GetCPUCount() * kMaxWorkersPerCPU);
+		uint32_t count = _workerCount.load();
+
+		do {
+			if(count >= limit)
+				return;
+		} while(!_workerCount.compare_exchange(count, count + 1));
+
+		Task *task = Scheduler::GetScheduler()->GetKernelTask();
+		KernReturn<Thread *> thread = task->AttachThread(reinterpret_cast<Thread::Entry>(&KernelWorkThread), Thread::PriorityClassKernel, 16, nullptr);
+
+		if(!thread.IsValid())
+			_workerCount --;
+	}
 
+	static WorkQueue::Entry *PopKernelWork()
+	{
 		size_t count = Sys::CPU::GetCPUCount();
-		WorkProxy *proxies = new WorkProxy[count];
+		size_t start = _workerCursor.fetch_add(1) % count;
 
 		for(size_t i = 0; i < count; i ++)
 		{
-			Sys::CPU *cpu = Sys::CPU::GetCPUWithID(i);
-			WorkProxy *proxy = proxies + i;
+			WorkQueue *queue = Sys::CPU::GetCPUWithID((start + i) % count)->GetWorkQueue();
+			WorkQueue::Entry *entry = queue->PopEntry();
+
+			if(entry)
+				return entry;
+		}
+
+		return nullptr;
+	}
 
-			proxy->queue = cpu->GetWorkQueue();	
+	static bool HasKernelWork()
+	{
+		size_t count = Sys::CPU::GetCPUCount();
+
+		for(size_t i = 0; i < count; i ++)
+		{
+			if(Sys::CPU::GetCPUWithID(i)->GetWorkQueue()->HasWork())
+				return true;
 		}
 
-		Mutex lock;
+		return false;
+	}
+
+	void KernelWorkThread()
+	{
 		Thread *self = Scheduler::GetScheduler()->GetActiveThread();
+		size_t count = Sys::CPU::GetCPUCount();
 
 		while(1)
 		{
-			lock.Lock(Mutex::Mode::NoInterrupts);
-			Sys::CPU *current = Sys::CPU::GetCurrentCPU();
+			WorkQueue::Entry *entry;
 
-			for(size_t i = 0; i < count; i ++)
 			{
-				Sys::CPU *cpu = Sys::CPU::GetCPUWithID(i);
-				WorkProxy *proxy = proxies + i;
-
-				proxy->entries = (cpu == current) ? proxy->queue->PopAll() : proxy->queue->PopAllRemote();
+				InterruptGuard guard(InterruptGuard::Mode::DisableInterrupts);
+				entry = PopKernelWork();
 			}
 
-			lock.Unlock();
-
-			// Perform the work
-			for(size_t i = 0; i < count; i ++)
+			if(!entry)
 			{
-				WorkProxy *proxy = proxies + i;
-
-				WorkQueue::Entry *entry = proxy->entries;
-				while(entry)
+				// The queues can't allocate in the interrupt context, so grow them while we are idle
+				for(size_t i = 0; i < count; i ++)
 				{
-					entry->callback(entry->context);
-					entry = entry->next;
+					WorkQueue *queue = Sys::CPU::GetCPUWithID(i)->GetWorkQueue();
+
+					if(queue->NeedsGrowth())
+						queue->Grow();
 				}
+
+				Scheduler::GetScheduler()->YieldThread(self);
+				continue;
 			}
 
-			// Refurbish the work lists
-			lock.Lock(Mutex::Mode::NoInterrupts);
-			current = Sys::CPU::GetCurrentCPU();
+			uint32_t busy = _busyWorkers.fetch_add(1) + 1;
 
-			for(size_t i = 0; i < count; i ++)
-			{
-				Sys::CPU *cpu = Sys::CPU::GetCPUWithID(i);
-				WorkProxy *proxy = proxies + i;
+			if(busy >= _workerCount.load() && HasKernelWork())
+				SpawnKernelWorker();
 
-				if(!proxy->entries)
-					continue;
+			// Caller owned entries may be pushed again from within the callback, don't touch them afterwards
+			WorkQueue *owner = entry->owner;
+			entry->callback(entry->context);
 
-				if(cpu == current)
-				{
-					proxy->queue->RefurbishList(proxy->entries);
-					proxy->entries = nullptr;
-				}
-				else
-				{
-					proxy->queue->RefurbishListRemote(proxy->entries);
-					proxy->entries = nullptr;
-				}
+			if(owner)
+			{
+				InterruptGuard guard(InterruptGuard::Mode::DisableInterrupts);
+				owner->RefurbishEntry(entry);
 			}
 
-			lock.Unlock();
-			Scheduler::GetScheduler()->YieldThread(self);
+			_busyWorkers --;
 		}
 	}
 
@@ -149,7 +178,9 @@ namespace OS
 
 		space->Unlock();
 
-		__unused Thread *workThread = self->AttachThread(reinterpret_cast<Thread::Entry>(&KernelWorkThread), Thread::PriorityClassKernel, 16, nullptr);
+		for(size_t i = 0; i < Sys::CPU::GetCPUCount() * kWorkersPerCPU; i ++)
+			SpawnKernelWorker();
+
 		__unused Thread *bootstrapThread = self->AttachThread(reinterpret_cast<Thread::Entry>(&BootstrapServerThread), Thread::PriorityClassKernel, 16, nullptr);
 
 		// Start the test program
@@ -73,8 +73,16 @@ namespace OS
 
 			if(module->GetType() == Module::Type::Extension)
 			{
-				Sys::CPU *cpu = Sys::CPU::GetCurrentCPU();
-				cpu->GetWorkQueue()->PushEntry(&BootstrapModule, reinterpret_cast<void *>(module));
+				WorkQueue *queue = Sys::CPU::GetCurrentCPU()->GetWorkQueue();
+
+				// Not in an interrupt context, so the queue can be grown right here if it ran dry
+				if(!queue->PushEntry(&BootstrapModule, reinterpret_cast<void *>(module)))
+				{
+					queue->Grow();
+
+					if(!queue->PushEntry(&BootstrapModule, reinterpret_cast<void *>(module)))
+						kprintf("Failed to queue bootstrapping of %s\n", module->GetName());
+				}
 			}
 
 			return ErrorNone;
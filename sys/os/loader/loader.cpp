@@ -17,13 +17,18 @@
 //
 
 #include <vfs/vfs.h>
+#include <vfs/page_cache.h>
 #include <libc/string.h>
+#include <libcpp/algorithm.h>
+#include <kern/kalloc.h>
 #include <kern/kprintf.h>
 #include "elf.h"
 #include "loader.h"
 
 namespace OS
 {
+	static constexpr size_t kMaxProgramHeaders = 64;
+
 	IODefineMeta(Executable, IO::Object)
 
 	KernReturn<Executable *> Executable::Init(Sys::VM::Directory *directory, const char *path)
@@ -33,69 +38,35 @@ namespace OS
 
 		_directory = directory;
 		_entry    = 0;
-		_physical = 0;
+		_cache    = nullptr;
+		_privatePages = nullptr;
 		_virtual  = 0;
 		_pages    = 0;
 
-		KernReturn<void> status;
 		KernReturn<int> fd;
 		VFS::Context *context = VFS::Context::GetKernelContext();
 
 		if((fd = VFS::Open(context, path, O_RDONLY)).IsValid() == false)
 			return fd.GetError();
 
-		KernReturn<void> result;
-		KernReturn<off_t> size;
-		size_t left;
-
-		uint8_t *temp;
-		uint8_t *buffer = nullptr;
-
-		// Get the size of the file and allocate enough storage
-		if((size = VFS::Seek(context, fd, 0, SEEK_END)).IsValid() == false)
-		{
-			status = size.GetError();
-			goto exit;
-		}
-
-		left   = size;
-		buffer = new uint8_t[size];
-
-		if(!buffer)
-		{
-			status = Error(KERN_NO_MEMORY);
-			goto exit;
-		}
+		KernReturn<void> status;
 
-		if(!VFS::Seek(context, fd, 0, SEEK_SET).IsValid())
 		{
-			status = Error(KERN_FAILURE);
-			goto exit;
-		}
+			IO::StrongRef<VFS::Node> node = VFS::GetNode(context, fd);
+			VFS::PageCache *cache = node ? node->GetPageCache(true) : nullptr;
 
-		temp = buffer;
-
-		// Read the file
-		while(left > 0)
-		{
-			KernReturn<size_t> read = VFS::Read(context, fd, temp, left);
-			
-			if(!read.IsValid())
+			if(cache)
 			{
-				status = read.GetError();
-				goto exit;
+				_cache = cache->Retain();
+				status = Load(context, fd);
+			}
+			else
+			{
+				status = Error(KERN_NO_MEMORY);
 			}
-
-			temp += read;
-			left -= read;
 		}
 
-		result = Load(buffer);
-		status = result.IsValid() ? ErrorNone : result.GetError();
-
-	exit:
 		VFS::Close(context, fd);
-		delete[] buffer;
 
 		if(!status.IsValid())
 			return status.GetError();
@@ -105,80 +76,185 @@ namespace OS
 
 	void Executable::Dealloc()
 	{
-		if(_physical)
-			Sys::PM::Free(_physical, _pages);
+		if(_privatePages)
+		{
+			for(size_t i = 0; i < _pages; i ++)
+			{
+				if(_privatePages[i])
+					Sys::PM::Free(_privatePages[i], 1);
+			}
+
+			kfree(_privatePages);
+		}
 
+		IO::SafeRelease(_cache);
 		IO::Object::Dealloc();
 	}
 
 
+	KernReturn<void> Executable::CopyFromCache(uint8_t *target, off_t offset, size_t length)
+	{
+		while(length > 0)
+		{
+			size_t pageOffset = offset % VM_PAGE_SIZE;
+			size_t chunk = std::min(length, VM_PAGE_SIZE - pageOffset);
+
+			KernReturn<uintptr_t> page = _cache->GetPage(offset / VM_PAGE_SIZE);
+			if(!page.IsValid())
+				return page.GetError();
+
+			KernReturn<void> result = Sys::VM::CopyFromPhysical(target, page.Get() + pageOffset, chunk);
+			if(!result.IsValid())
+				return result;
 
-	KernReturn<void> Executable::Load(void *data)
+			target += chunk;
+			offset += chunk;
+			length -= chunk;
+		}
+
+		return ErrorNone;
+	}
+
+	KernReturn<void> Executable::Load(VFS::Context *context, int fd)
 	{
-		char *begin = static_cast<char *>(data);
-		elf_header_t *header = static_cast<elf_header_t *>(data);
+		elf_header_t header;
 
-		if(strncmp((const char *)header->e_ident, ELF_MAGIC, strlen(ELF_MAGIC)) != 0)
+		KernReturn<size_t> read = VFS::ReadAt(context, fd, &header, sizeof(elf_header_t), 0);
+		if(!read.IsValid() || read.Get() != sizeof(elf_header_t))
 			return Error(KERN_FAILURE);
 
-		if(header->e_phnum == 0)
+		if(strncmp((const char *)header.e_ident, ELF_MAGIC, strlen(ELF_MAGIC)) != 0)
+			return Error(KERN_FAILURE);
+
+		if(header.e_phnum == 0 || header.e_phnum > kMaxProgramHeaders)
 			return Error(KERN_INVALID_ARGUMENT);
 
 
-		_entry = header->e_entry;
+		_entry = header.e_entry;
 
-		elf_program_header_t *programHeader = reinterpret_cast<elf_program_header_t *>(begin + header->e_phoff);
+		elf_program_header_t programHeader[kMaxProgramHeaders];
+		size_t programHeaderSize = header.e_phnum * sizeof(elf_program_header_t);
+
+		read = VFS::ReadAt(context, fd, programHeader, programHeaderSize, header.e_phoff);
+		if(!read.IsValid() || read.Get() != programHeaderSize)
+			return Error(KERN_FAILURE);
 
 		vm_address_t minAddress = -1;
 		vm_address_t maxAddress = 0;
 
-		for(size_t i = 0; i < header->e_phnum; i ++)
+		for(size_t i = 0; i < header.e_phnum; i ++)
 		{
 			elf_program_header_t *program = programHeader + i;
 
 			if(program->p_type == PT_LOAD)
 			{
-				if(program->p_paddr < minAddress)
-					minAddress = program->p_paddr;
+				if(program->p_filesz > program->p_memsz)
+					return Error(KERN_INVALID_ARGUMENT);
 
-				if(program->p_paddr + program->p_memsz > maxAddress)
-					maxAddress = program->p_paddr + program->p_memsz;
+				if(program->p_vaddr < minAddress)
+					minAddress = program->p_vaddr;
+
+				if(program->p_vaddr + program->p_memsz > maxAddress)
+					maxAddress = program->p_vaddr + program->p_memsz;
 			}
 		}
 
+		if(minAddress >= maxAddress)
+			return Error(KERN_INVALID_ARGUMENT);
+
 		_virtual = VM_PAGE_ALIGN_DOWN(minAddress);
-		_pages   = VM_PAGE_COUNT(maxAddress - minAddress);
+		_pages   = VM_PAGE_COUNT(maxAddress - _virtual);
+
+		_privatePages = static_cast<uintptr_t *>(kalloc(_pages * sizeof(uintptr_t)));
+		if(!_privatePages)
+			return Error(KERN_NO_MEMORY);
 
-		KernReturn<uintptr_t> physical;
+		memset(_privatePages, 0, _pages * sizeof(uintptr_t));
 
-		if((physical = Sys::PM::Alloc(_pages)).IsValid() == false)
+		for(size_t i = 0; i < _pages; i ++)
 		{
-			_physical = 0x0;
-			return physical.GetError();
-		}
-		
-		if((_directory->MapPageRange(physical, _virtual, _pages, kVMFlagsUserlandRW)).IsValid() == false)
-			return Error(KERN_NO_MEMORY);
-		
-		_physical = physical;
+			vm_address_t page = _virtual + (i * VM_PAGE_SIZE);
 
-		// Copy the date into the physical memory
-		KernReturn<vm_address_t> kernel;
+			// A page can be shared if it's backed by exactly one read-only segment,
+			// entirely covered by its file data at a page aligned file offset
+			elf_program_header_t *sharedProgram = nullptr;
+			size_t segments = 0;
 
-		if((kernel = Sys::VM::Directory::GetKernelDirectory()->Alloc(_physical, _pages, kVMFlagsKernel)).IsValid() == false)
-			return kernel.GetError();
-		
-		uint8_t *buffer = reinterpret_cast<uint8_t *>(kernel.Get());
+			for(size_t j = 0; j < header.e_phnum; j ++)
+			{
+				elf_program_header_t *program = programHeader + j;
 
-		for(size_t i = 0; i < header->e_phnum; i ++)
-		{
-			elf_program_header_t *program = programHeader + i;
+				if(program->p_type != PT_LOAD || program->p_vaddr >= page + VM_PAGE_SIZE || program->p_vaddr + program->p_memsz <= page)
+					continue;
 
-			if(program->p_type == PT_LOAD)
-				memcpy(&buffer[program->p_vaddr - minAddress], &begin[program->p_offset], program->p_filesz);
+				segments ++;
+
+				bool readOnly = !(program->p_flags & PF_W);
+				bool covered = (program->p_vaddr <= page && program->p_vaddr + program->p_filesz >= page + VM_PAGE_SIZE);
+				bool aligned = ((program->p_vaddr - program->p_offset) % VM_PAGE_SIZE) == 0;
+
+				if(readOnly && covered && aligned)
+					sharedProgram = program;
+			}
+
+			if(segments == 0)
+				continue;
+
+			if(segments == 1 && sharedProgram)
+			{
+				off_t offset = sharedProgram->p_offset + (page - sharedProgram->p_vaddr);
+
+				KernReturn<uintptr_t> physical = _cache->GetPage(offset / VM_PAGE_SIZE);
+				if(!physical.IsValid())
+					return physical.GetError();
+
+				KernReturn<void> result = _directory->MapPage(physical, page, kVMFlagsUserlandR);
+				if(!result.IsValid())
+					return result;
+
+				continue;
+			}
+
+			// Private page, filled with the file data of every segment touching it and zeros everywhere else
+			KernReturn<uintptr_t> physical = Sys::PM::Alloc(1);
+			if(!physical.IsValid())
+				return physical.GetError();
+
+			_privatePages[i] = physical;
+
+			KernReturn<vm_address_t> kernel = Sys::VM::Directory::GetKernelDirectory()->Alloc(physical, 1, kVMFlagsKernel);
+			if(!kernel.IsValid())
+				return kernel.GetError();
+
+			uint8_t *buffer = reinterpret_cast<uint8_t *>(kernel.Get());
+			memset(buffer, 0, VM_PAGE_SIZE);
+
+			KernReturn<void> result;
+
+			for(size_t j = 0; j < header.e_phnum && result.IsValid(); j ++)
+			{
+				elf_program_header_t *program = programHeader + j;
+
+				if(program->p_type != PT_LOAD)
+					continue;
+
+				vm_address_t begin = std::max<vm_address_t>(page, program->p_vaddr);
+				vm_address_t end = std::min<vm_address_t>(page + VM_PAGE_SIZE, program->p_vaddr + program->p_filesz);
+
+				if(begin < end)
+					result = CopyFromCache(buffer + (begin - page), program->p_offset + (begin - program->p_vaddr), end - begin);
+			}
+
+			Sys::VM::Directory::GetKernelDirectory()->Free(kernel, 1);
+
+			if(!result.IsValid())
+				return result;
+
+			result = _directory->MapPage(physical, page, kVMFlagsUserlandRW);
+			if(!result.IsValid())
+				return result;
 		}
 
-		Sys::VM::Directory::GetKernelDirectory()->Free(kernel, _pages);
 		return ErrorNone;
 	}
 }
@@ -26,8 +26,16 @@
 #include <libc/stdint.h>
 #include <libio/core/IOObject.h>
 
+namespace VFS
+{
+	class Context;
+	class PageCache;
+}
+
 namespace OS
 {
+	// Maps the PT_LOAD segments of an ELF file. Read-only pages are mapped straight out of the
+	// file's page cache, writable and partial pages get a private copy and bss is zero filled
 	class Executable : public IO::Object
 	{
 	public:
@@ -40,12 +48,14 @@ namespace OS
 		void Dealloc() override;
 
 	private:
-		KernReturn<void> Load(void *data);
+		KernReturn<void> Load(VFS::Context *context, int fd);
+		KernReturn<void> CopyFromCache(uint8_t *target, off_t offset, size_t length);
 
 		Sys::VM::Directory *_directory;
 		vm_address_t _entry;
 
-		uintptr_t _physical;
+		VFS::PageCache *_cache;
+		uintptr_t *_privatePages; // Per page of the image, 0 for pages shared with the page cache
 		vm_address_t _virtual;
 		size_t _pages;
 
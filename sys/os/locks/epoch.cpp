@@ -0,0 +1,64 @@
+//
+//  epoch.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <machine/cpu.h>
+#include "epoch.h"
+
+namespace OS
+{
+	Epoch::Epoch() :
+		_epoch(0)
+	{
+		spinlock_init(&_lock);
+
+		_readers[0].store(0);
+		_readers[1].store(0);
+	}
+
+	uint32_t Epoch::Enter()
+	{
+		while(1)
+		{
+			uint32_t epoch = _epoch.load() & 1;
+			_readers[epoch].fetch_add(1);
+
+			// A writer may have flipped the epoch and found the counter still empty before we registered
+			if((_epoch.load() & 1) == epoch)
+				return epoch;
+
+			_readers[epoch].fetch_sub(1);
+		}
+	}
+
+	void Epoch::Exit(uint32_t token)
+	{
+		_readers[token].fetch_sub(1);
+	}
+
+	void Epoch::Synchronize()
+	{
+		spinlock_lock(&_lock);
+
+		uint32_t epoch = _epoch.fetch_add(1) & 1;
+
+		while(_readers[epoch].load() > 0)
+			Sys::CPUPause();
+
+		spinlock_unlock(&_lock);
+	}
+}
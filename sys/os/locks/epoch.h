@@ -0,0 +1,49 @@
+//
+//  epoch.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _OS_EPOCH_H_
+#define _OS_EPOCH_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libc/sys/spinlock.h>
+#include <libcpp/atomic.h>
+
+namespace OS
+{
+	// Quiescence tracking for lock-free readers. Readers bracket their accesses with Enter() and Exit(),
+	// a writer unpublishes an object and calls Synchronize() before freeing it. Synchronize() returns once
+	// every reader that could still observe the object has left.
+	class Epoch
+	{
+	public:
+		Epoch();
+
+		uint32_t Enter();
+		void Exit(uint32_t token);
+
+		void Synchronize();
+
+	private:
+		std::atomic<uint32_t> _epoch;
+		std::atomic<uint32_t> _readers[2];
+		spinlock_t _lock;
+	};
+}
+
+#endif /* _OS_EPOCH_H_ */
@@ -0,0 +1,220 @@
+//
+//  futex.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libio/core/IOObject.h>
+#include <libio/core/IODictionary.h>
+#include <libio/core/IONumber.h>
+#include <libc/sys/spinlock.h>
+#include <libcpp/algorithm.h>
+#include <machine/interrupts/interrupts.h>
+#include <machine/memory/memory.h>
+#include <os/scheduler/scheduler.h>
+#include <os/scheduler/task.h>
+#include <os/waitqueue.h>
+#include "futex.h"
+
+namespace OS
+{
+	// Exists while a word has waiters, its address is the wait queue channel
+	class Futex : public IO::Object
+	{
+	public:
+		Futex *Init()
+		{
+			if(!IO::Object::Init())
+				return nullptr;
+
+			_waiters = 0;
+			return this;
+		}
+
+		uint32_t _waiters;
+
+		IODeclareMeta(Futex)
+	};
+
+	IODefineMeta(Futex, IO::Object)
+
+	static IO::Dictionary *_futexes;
+	static spinlock_t _futexLock = SPINLOCK_INIT;
+
+	static KernReturn<uintptr_t> ResolveFutex(Thread *thread, vm_address_t address)
+	{
+		if(!address || (address % sizeof(uint32_t)) != 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		Sys::VM::Directory *directory = thread->GetTask()->GetDirectory();
+
+		// Only words in pages userland can read itself, the trampoline and kernel mappings are off limits
+		KernReturn<uintptr_t> physical = directory->ResolveUserAddress(VM_PAGE_ALIGN_DOWN(address), false);
+		if(!physical.IsValid())
+			return Error(KERN_INVALID_ADDRESS, EFAULT);
+
+		return physical.Get() + (address - VM_PAGE_ALIGN_DOWN(address));
+	}
+
+	KernReturn<void> FutexWait(Thread *thread, vm_address_t address, uint32_t expected)
+	{
+		KernReturn<uintptr_t> physical = ResolveFutex(thread, address);
+		if(!physical.IsValid())
+			return physical.GetError();
+
+		IO::StrongRef<IO::Number> key(IOTransferRef(IO::Number::Alloc()->InitWithUint32(physical.Get())));
+
+		// The waker takes the same lock, so a wakeup can't slip in between the check and the wait
+		bool enabled = Sys::DisableInterrupts();
+		spinlock_lock(&_futexLock);
+
+		uint32_t value;
+		if(!Sys::VM::CopyFromPhysical(&value, physical, sizeof(uint32_t)).IsValid())
+		{
+			spinlock_unlock(&_futexLock);
+
+			if(enabled)
+				Sys::EnableInterrupts();
+
+			return Error(KERN_INVALID_ADDRESS, EFAULT);
+		}
+
+		if(value != expected)
+		{
+			spinlock_unlock(&_futexLock);
+
+			if(enabled)
+				Sys::EnableInterrupts();
+
+			return Error(KERN_RESOURCE_IN_USE, EAGAIN);
+		}
+
+		Futex *futex = _futexes->GetObjectForKey<Futex>(key);
+		if(!futex)
+		{
+			futex = Futex::Alloc()->Init();
+			_futexes->SetObjectForKey(futex, key);
+			futex->Release();
+		}
+
+		futex->_waiters ++;
+		KernReturn<void> result = WaitThread(thread, futex);
+
+		if(!result.IsValid())
+			futex->_waiters --;
+
+		spinlock_unlock(&_futexLock);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+
+		return result;
+	}
+
+	KernReturn<uint32_t> FutexWake(Thread *thread, vm_address_t address, uint32_t count)
+	{
+		KernReturn<uintptr_t> physical = ResolveFutex(thread, address);
+		if(!physical.IsValid())
+			return physical.GetError();
+
+		IO::StrongRef<IO::Number> key(IOTransferRef(IO::Number::Alloc()->InitWithUint32(physical.Get())));
+
+		bool enabled = Sys::DisableInterrupts();
+		spinlock_lock(&_futexLock);
+
+		Futex *futex = _futexes->GetObjectForKey<Futex>(key);
+		uint32_t woken = 0;
+
+		if(futex)
+		{
+			woken = std::min(count, futex->_waiters);
+
+			for(uint32_t i = 0; i < woken; i ++)
+				WakeupOne(futex);
+
+			futex->_waiters -= woken;
+
+			if(futex->_waiters == 0)
+				_futexes->RemoveObjectForKey(key);
+		}
+
+		spinlock_unlock(&_futexLock);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+
+		return woken;
+	}
+
+	KernReturn<uint32_t> Syscall_Futex(Thread *thread, FutexArgs *arguments)
+	{
+		vm_address_t address = reinterpret_cast<vm_address_t>(arguments->address);
+
+		switch(arguments->operation)
+		{
+			case FUTEX_WAIT:
+			{
+				KernReturn<void> result = FutexWait(thread, address, arguments->value);
+				if(!result.IsValid())
+					return result.GetError();
+
+				return 0;
+			}
+
+			case FUTEX_WAKE:
+				return FutexWake(thread, address, arguments->value);
+
+			default:
+				return Error(KERN_INVALID_ARGUMENT, EINVAL);
+		}
+	}
+
+	void FutexThreadExit(Thread *thread)
+	{
+		bool enabled = Sys::DisableInterrupts();
+		spinlock_lock(&_futexLock);
+
+		void *channel = CancelWait(thread);
+		if(channel)
+		{
+			IO::Number *key = nullptr;
+			Futex *futex = nullptr;
+
+			// The channel may as well belong to something other than a futex
+			_futexes->Enumerate<Futex, IO::Number>([&](Futex *object, IO::Number *objectKey, bool &stop) {
+				if(object == channel)
+				{
+					futex = object;
+					key = objectKey;
+					stop = true;
+				}
+			});
+
+			if(futex && (-- futex->_waiters) == 0)
+				_futexes->RemoveObjectForKey(key);
+		}
+
+		spinlock_unlock(&_futexLock);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+	}
+
+	KernReturn<void> FutexInit()
+	{
+		_futexes = IO::Dictionary::Alloc()->Init();
+		return ErrorNone;
+	}
+}
@@ -0,0 +1,51 @@
+//
+//  futex.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _OS_FUTEX_H_
+#define _OS_FUTEX_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libc/sys/futex.h>
+#include <kern/kern_return.h>
+
+namespace OS
+{
+	class Thread;
+
+	struct FutexArgs
+	{
+		uint32_t *address;
+		int operation;
+		uint32_t value;
+	} __attribute__((packed));
+
+	// Futexes are keyed by the physical address of the word, so tasks sharing
+	// memory can synchronize through the same word at different virtual addresses
+	KernReturn<void> FutexWait(Thread *thread, vm_address_t address, uint32_t expected);
+	KernReturn<uint32_t> FutexWake(Thread *thread, vm_address_t address, uint32_t count);
+
+	KernReturn<uint32_t> Syscall_Futex(Thread *thread, FutexArgs *arguments);
+
+	// Takes an exiting thread off the wait queue it is blocked on, and out of the futex waiter count
+	void FutexThreadExit(Thread *thread);
+
+	KernReturn<void> FutexInit();
+}
+
+#endif /* _OS_FUTEX_H_ */
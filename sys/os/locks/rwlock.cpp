@@ -0,0 +1,98 @@
+//
+//  rwlock.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <machine/cpu.h>
+#include "rwlock.h"
+
+namespace OS
+{
+	RWLock::RWLock() :
+		_state(0)
+	{}
+
+	void RWLock::LockShared()
+	{
+		while(1)
+		{
+			uint32_t state = _state.load(std::memory_order_relaxed);
+
+			if(!(state & (kWriter | kWriterWaiting)) && _state.compare_exchange(state, state + 1, std::memory_order_acquire))
+				return;
+
+			Sys::CPUPause();
+		}
+	}
+	void RWLock::UnlockShared()
+	{
+		_state.fetch_sub(1, std::memory_order_release);
+	}
+
+	void RWLock::Lock()
+	{
+		while(1)
+		{
+			uint32_t state = _state.load(std::memory_order_relaxed);
+
+			if(!(state & (kWriter | kReaderMask)))
+			{
+				// Taking the lock also clears the waiting bit, other waiting writers set it again
+				if(_state.compare_exchange(state, kWriter, std::memory_order_acquire))
+					return;
+
+				continue;
+			}
+
+			if(!(state & kWriterWaiting))
+				_state.compare_exchange(state, state | kWriterWaiting, std::memory_order_relaxed);
+
+			Sys::CPUPause();
+		}
+	}
+	void RWLock::Unlock()
+	{
+		_state.fetch_and(~kWriter, std::memory_order_release);
+	}
+
+
+	uint32_t SeqCount::BeginRead() const
+	{
+		while(1)
+		{
+			uint32_t sequence = _sequence.load(std::memory_order_acquire);
+			if(!(sequence & 1))
+				return sequence;
+
+			Sys::CPUPause();
+		}
+	}
+	bool SeqCount::RetryRead(uint32_t sequence) const
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return (_sequence.load(std::memory_order_relaxed) != sequence);
+	}
+
+	void SeqCount::BeginWrite()
+	{
+		_sequence.fetch_add(1, std::memory_order_relaxed);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+	void SeqCount::EndWrite()
+	{
+		_sequence.fetch_add(1, std::memory_order_release);
+	}
+}
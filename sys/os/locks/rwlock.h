@@ -0,0 +1,69 @@
+//
+//  rwlock.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _OS_RWLOCK_H_
+#define _OS_RWLOCK_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libcpp/atomic.h>
+
+namespace OS
+{
+	// Spinning reader-writer lock. Any number of readers may hold it at once, a writer excludes everyone.
+	// A waiting writer stops new readers from entering so that a steady stream of readers can't starve it.
+	class RWLock
+	{
+	public:
+		RWLock();
+
+		void LockShared();
+		void UnlockShared();
+
+		void Lock();
+		void Unlock();
+
+	private:
+		static constexpr uint32_t kWriter = (1U << 31);
+		static constexpr uint32_t kWriterWaiting = (1U << 30);
+		static constexpr uint32_t kReaderMask = kWriterWaiting - 1;
+
+		std::atomic<uint32_t> _state;
+	};
+
+	// Sequence counter for small values read without a lock. Writers must be serialized by
+	// another lock, readers retry until they observed a stable, even sequence.
+	class SeqCount
+	{
+	public:
+		SeqCount() :
+			_sequence(0)
+		{}
+
+		uint32_t BeginRead() const;
+		bool RetryRead(uint32_t sequence) const;
+
+		void BeginWrite();
+		void EndWrite();
+
+	private:
+		std::atomic<uint32_t> _sequence;
+	};
+}
+
+#endif /* _OS_RWLOCK_H_ */
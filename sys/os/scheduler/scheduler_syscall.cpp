@@ -61,10 +61,16 @@ namespace OS
 
 		if(task->GetMainThread() == thread)
 		{
-			Sys::CPU::GetCurrentCPU()->GetWorkQueue()->PushEntry(&MarkThreadExit, task);
-
-			task->Retain(); // Defer the Dealloc() until we are out of the syscall handler to avoid crashing
+			// Defer the Dealloc() until we are out of the syscall handler to avoid crashing
+			// Retained before queueing it, another worker might pick up the release right away
+			task->Retain();
 			task->PronounceDead(arguments->exitCode);
+
+			WorkQueue::Entry *entry = task->GetExitWorkEntry();
+			entry->callback = &MarkThreadExit;
+			entry->context = task;
+
+			Sys::CPU::GetCurrentCPU()->GetWorkQueue()->PushEntry(entry);
 		}
 
 		Scheduler *scheduler = Scheduler::GetScheduler();
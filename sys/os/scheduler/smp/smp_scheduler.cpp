@@ -24,6 +24,7 @@
 #include <kern/kprintf.h>
 #include <machine/clock/clock.h>
 #include <machine/interrupts/interrupts.h>
+#include <machine/interrupts/trampoline.h>
 #include <machine/cpu.h>
 #include "smp_scheduler.h"
 
@@ -107,10 +108,20 @@ namespace OS
 			Task *task = thread->GetTask();
 			Sys::Trampoline *trampoline = _cpu->GetTrampoline();
 
-			trampoline->pageDirectory = task->GetDirectory()->GetPhysicalDirectory();
-			trampoline->tss.esp0 = thread->GetESP() + sizeof(Sys::CPUState);
+			if(thread->IsInKernelContext())
+			{
+				// The thread is executing a syscall on its kernel stack
+				trampoline->pageDirectory = Sys::VM::Directory::GetKernelDirectory()->GetPhysicalDirectory();
+				Sys::TrampolineSetKernelStack(trampoline, reinterpret_cast<uint32_t>(thread->GetSyscallState()) + sizeof(Sys::CPUState));
+			}
+			else
+			{
+				trampoline->pageDirectory = task->GetDirectory()->GetPhysicalDirectory();
+				Sys::TrampolineSetKernelStack(trampoline, thread->GetESP() + sizeof(Sys::CPUState));
+			}
 
 			CPU_DATA_SET(pid, thread->GetTask()->GetPid());
+			CPU_DATA_SET(ppid, thread->GetTask()->GetParentPid());
 			CPU_DATA_SET(tid, thread->GetTid());
 			CPU_DATA_SET(tls, thread->GetTLSVirtual());
 			
@@ -577,4 +588,9 @@ namespace OS
 
 		scheduler->PushCommand(SchedulerCommand(SchedulerCommand::Command::YieldThread, thread));
 	}
+	bool SMPScheduler::IsThreadBlocked(Thread *thread) const
+	{
+		SchedulingData *data = thread->GetSchedulingData<SchedulingData>();
+		return (!data || data->blocks > 0);
+	}
 }
@@ -43,6 +43,7 @@ namespace OS
 		void BlockThread(Thread *thread) final;
 		void UnblockThread(Thread *thread) final;
 		void YieldThread(Thread *thread) final;
+		bool IsThreadBlocked(Thread *thread) const final;
 
 		void AddThread(Thread *thread) final;
 		void RemoveThread(Thread *thread) final;
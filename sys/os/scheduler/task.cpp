@@ -19,12 +19,16 @@
 #include <kern/kprintf.h>
 #include <kern/panic.h>
 #include <libc/string.h>
+#include <kern/kalloc.h>
+#include <libcpp/algorithm.h>
 #include <vfs/file.h>
 #include <vfs/vfs.h>
 #include <machine/interrupts/trampoline.h>
 #include <machine/debug.h>
 #include <os/waitqueue.h>
+#include <os/locks/futex.h>
 #include <os/linker/LDService.h>
+#include <os/syscall/syscall_uring.h>
 #include <libc/ipc/ipc_message.h>
 #include "scheduler.h"
 #include "task.h"
@@ -32,6 +36,11 @@
 namespace OS
 {
 	static std::atomic<pid_t> _taskPidCounter;
+	static constexpr size_t kFileTableMinCapacity = 16;
+
+	// Marks a descriptor handed out by AllocateFileDescriptor() that has no file yet
+	static VFS::File *const kFileReserved = reinterpret_cast<VFS::File *>(1);
+
 	IODefineMeta(Task, IO::Object)
 
 	extern IPC::Port *hostPort;
@@ -89,17 +98,19 @@ namespace OS
 		_parent = parent;
 		_state = State::Running;
 		_pid = _taskPidCounter.fetch_add(1) + 1;
+		_ppid = parent ? parent->GetPid() : 0;
 		_ring3 = false;
 		_tidCounter = 1;
 		_mainThread = nullptr;
 		_directory = Sys::VM::Directory::GetKernelDirectory();
 		_context = nullptr;
-		_fileCounter = 0;
-		_files = IO::Dictionary::Alloc()->Init();
+		_files = nullptr;
+		spinlock_init(&_fileLock);
 		_executable = nullptr;
 		_threads = IO::Array::Alloc()->Init();
 		_name = nullptr;
 		_exitedThreads = 0;
+		_uring = nullptr;
 
 		_space = IPC::Space::Alloc()->Init();
 		_taskPort = _space->AllocateCallbackPort(&__TaskIPCCallback);
@@ -164,10 +175,23 @@ namespace OS
 		if(_directory != Sys::VM::Directory::GetKernelDirectory())
 			delete _directory;
 
-		_files->Release();
+		FileTable *table = _files.load();
+		if(table)
+		{
+			for(size_t i = 0; i < table->capacity; i ++)
+			{
+				VFS::File *file = table->files[i].load();
+				if(file && file != kFileReserved)
+					file->Release();
+			}
+
+			kfree(table);
+		}
+
 		_threads->Release();
 
 		_space->Release();
+		IO::SafeRelease(_uring);
 
 		delete _context;
 
@@ -177,6 +201,31 @@ namespace OS
 	}
 
 
+	KernReturn<void> Task::SetUring(Uring *uring)
+	{
+		Lock();
+
+		if(_uring)
+		{
+			Unlock();
+			return Error(KERN_RESOURCE_EXISTS, EBUSY);
+		}
+
+		_uring = IO::SafeRetain(uring);
+		Unlock();
+
+		return ErrorNone;
+	}
+
+	Uring *Task::CopyUring()
+	{
+		Lock();
+		Uring *uring = IO::SafeRetain(_uring);
+		Unlock();
+
+		return uring;
+	}
+
 	void Task::SetName(IO::String *name)
 	{
 		IO::SafeRelease(_name);
@@ -226,6 +275,9 @@ namespace OS
 
 	void Task::MarkThreadExit(Thread *thread)
 	{
+		// A blocked thread can die while it waits, it must not be found by a wakeup afterwards
+		FutexThreadExit(thread);
+
 		_exitedThreads ++;
 		Wakeup(thread->GetJoinToken());
 
@@ -273,41 +325,137 @@ namespace OS
 		return result;
 	}
 
-	VFS::File *Task::GetFileForDescriptor(int fd)
+	Task::FileTable *Task::AllocateFileTable(size_t capacity)
 	{
-		IO::Number *lookup = IO::Number::Alloc()->InitWithInt32(fd);
-		VFS::File *file = _files->GetObjectForKey<VFS::File>(lookup);
+		FileTable *table = static_cast<FileTable *>(kalloc(sizeof(FileTable) + capacity * sizeof(std::atomic<VFS::File *>)));
+		if(!table)
+			return nullptr;
 
-		lookup->Release();
-		return file;
+		table->capacity = capacity;
+		table->files = reinterpret_cast<std::atomic<VFS::File *> *>(table + 1);
+
+		for(size_t i = 0; i < capacity; i ++)
+			table->files[i].store(nullptr, std::memory_order_relaxed);
+
+		return table;
+	}
+
+	IO::StrongRef<VFS::File> Task::GetFileForDescriptor(int fd)
+	{
+		IO::StrongRef<VFS::File> result;
+		uint32_t epoch = _fileEpoch.Enter();
+
+		FileTable *table = _files.load(std::memory_order_acquire);
+
+		if(table && fd >= 0 && static_cast<size_t>(fd) < table->capacity)
+		{
+			VFS::File *file = table->files[fd].load(std::memory_order_acquire);
+			if(file != kFileReserved)
+				result = file; // Retains while the epoch still holds off writers
+		}
+
+		_fileEpoch.Exit(epoch);
+		return result;
 	}
 	void Task::SetFileForDescriptor(VFS::File *file, int fd)
 	{
-		IO::Number *lookup = IO::Number::Alloc()->InitWithInt32(fd);
+		spinlock_lock(&_fileLock);
+
+		FileTable *table = _files.load(std::memory_order_relaxed);
+		VFS::File *previous = table->files[fd].load(std::memory_order_relaxed);
+
+		table->files[fd].store(file ? file->Retain() : kFileReserved, std::memory_order_release);
+		spinlock_unlock(&_fileLock);
+
+		if(previous && previous != kFileReserved)
+		{
+			_fileEpoch.Synchronize();
+			previous->Release();
+		}
+	}
+	VFS::File *Task::RemoveFileForDescriptor(int fd)
+	{
+		spinlock_lock(&_fileLock);
+
+		FileTable *table = _files.load(std::memory_order_relaxed);
+		VFS::File *file = nullptr;
 
-		if(file)
-			_files->SetObjectForKey(file, lookup);
-		else
-			_files->SetObjectForKey(IO::Null::GetNull(), lookup);
+		if(table && fd >= 0 && static_cast<size_t>(fd) < table->capacity)
+		{
+			file = table->files[fd].load(std::memory_order_relaxed);
+
+			if(file == kFileReserved)
+				file = nullptr; // Still being opened, only FreeFileDescriptor() hands the slot back
+			else
+				table->files[fd].store(nullptr, std::memory_order_release);
+		}
+
+		spinlock_unlock(&_fileLock);
+
+		if(!file)
+			return nullptr;
 
-		lookup->Release();
+		_fileEpoch.Synchronize();
+		return file;
 	}
 
 
 	int Task::AllocateFileDescriptor()
 	{
-		int fd = (_fileCounter ++);
+		spinlock_lock(&_fileLock);
+
+		FileTable *table = _files.load(std::memory_order_relaxed);
+		size_t capacity = table ? table->capacity : 0;
 
-		IO::Number *lookup = IO::Number::Alloc()->InitWithInt32(fd);
-		_files->SetObjectForKey(IO::Null::GetNull(), lookup);
-		lookup->Release();
+		for(size_t i = 0; i < capacity; i ++)
+		{
+			if(table->files[i].load(std::memory_order_relaxed) == nullptr)
+			{
+				table->files[i].store(kFileReserved, std::memory_order_relaxed);
+				spinlock_unlock(&_fileLock);
 
-		return fd;
+				return static_cast<int>(i);
+			}
+		}
+
+		// Out of descriptors, publish a bigger copy of the table
+		FileTable *grown = AllocateFileTable(std::max(capacity * 2, kFileTableMinCapacity));
+		if(!grown)
+		{
+			spinlock_unlock(&_fileLock);
+			return -1;
+		}
+
+		for(size_t i = 0; i < capacity; i ++)
+			grown->files[i].store(table->files[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+		grown->files[capacity].store(kFileReserved, std::memory_order_relaxed);
+		_files.store(grown, std::memory_order_release);
+
+		spinlock_unlock(&_fileLock);
+
+		if(table)
+		{
+			_fileEpoch.Synchronize();
+			kfree(table);
+		}
+
+		return static_cast<int>(capacity);
 	}
 	void Task::FreeFileDescriptor(int fd)
 	{
-		IO::Number *lookup = IO::Number::Alloc()->InitWithInt32(fd);
-		_files->RemoveObjectForKey(lookup);
-		lookup->Release();
+		spinlock_lock(&_fileLock);
+
+		FileTable *table = _files.load(std::memory_order_relaxed);
+		VFS::File *file = table->files[fd].load(std::memory_order_relaxed);
+
+		table->files[fd].store(nullptr, std::memory_order_release);
+		spinlock_unlock(&_fileLock);
+
+		if(file && file != kFileReserved)
+		{
+			_fileEpoch.Synchronize();
+			file->Release();
+		}
 	}
 }
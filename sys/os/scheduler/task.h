@@ -37,6 +37,7 @@
 #include <os/ipc/IPC.h>
 #include <os/syscall/syscall_mmap.h>
 #include <os/loader/loader.h>
+#include <os/locks/epoch.h>
 
 #include "thread.h"
 
@@ -48,6 +49,8 @@ namespace VFS
 
 namespace OS
 {
+	class Uring;
+
 	class Task : public IO::Object
 	{
 	public:
@@ -76,23 +79,25 @@ namespace OS
 		Task *GetParent() const { return _parent; }
 
 		pid_t GetPid() const { return _pid; }
+		pid_t GetParentPid() const { return _ppid; } // Unlike the parent itself, stays valid after the parent died
 		Sys::VM::Directory *GetDirectory() const { return _directory; }
 		int GetNice() const { return _nice.load(); }
 		Thread *GetMainThread() const { return _mainThread; }
 		Thread *GetThreadWithID(tid_t id);
 		State GetState() const { return _state.load(); }
+		WorkQueue::Entry *GetExitWorkEntry() { return &_exitWorkEntry; }
 
 		IO::String *GetName() const { return _name; }
 
 		// VFS
 		VFS::Context *GetVFSContext() const { return _context; }
 
-		// Must be called with the task lock being held!
-		VFS::File *GetFileForDescriptor(int fd);
+		// Lookups are lock-free, the descriptor table is only locked while it's modified
+		IO::StrongRef<VFS::File> GetFileForDescriptor(int fd);
 		void SetFileForDescriptor(VFS::File *file, int fd);
+		VFS::File *RemoveFileForDescriptor(int fd); // Returns the table's reference or nullptr
 
-		// Must also be called with the task lock being held
-		int AllocateFileDescriptor();
+		int AllocateFileDescriptor(); // Reserves the lowest free descriptor, -1 on failure
 		void FreeFileDescriptor(int fd);
 
 		// IPC
@@ -106,12 +111,23 @@ namespace OS
 		// Mmap
 		std::intrusive_list<MmapTaskEntry> mmapList;
 
+		// Async I/O rings, a task has at most one
+		KernReturn<void> SetUring(Uring *uring);
+		Uring *CopyUring(); // Returns retained ring or nullptr
+
 	protected:
 		Task();
 		void Dealloc() override;
 
 	private:
+		struct FileTable
+		{
+			size_t capacity;
+			std::atomic<VFS::File *> *files; // Trails the table in the same allocation
+		};
+
 		void CheckLifecycle();
+		FileTable *AllocateFileTable(size_t capacity);
 
 		Task *_parent;
 		Sys::VM::Directory *_directory;
@@ -127,20 +143,25 @@ namespace OS
 
 		spinlock_t _lock;
 		pid_t _pid;
+		pid_t _ppid;
 		std::atomic<State> _state;
 		std::atomic<int> _nice;
 
 		bool _ring3;
 
 		VFS::Context *_context;
-		IO::Dictionary *_files;
-		std::atomic<int32_t> _fileCounter;
+		std::atomic<FileTable *> _files;
+		spinlock_t _fileLock;
+		Epoch _fileEpoch; // Old tables and removed files are only released once lookups drained
 
 		IPC::Space *_space;
 		IPC::Port *_taskPort;
 		IPC::Port *_taskSendPort;
 		IPC::Port *_specialPorts[__IPC_SPECIAL_PORT_MAX];
 
+		Uring *_uring;
+		WorkQueue::Entry _exitWorkEntry;
+
 		IODeclareMeta(Task)
 	};
 }
@@ -36,6 +36,11 @@ namespace OS
 	{
 	}
 
+	Thread::Thread() :
+		waitEntry(this),
+		waitChannel(nullptr)
+	{}
+
 	KernReturn<Thread *> Thread::Init(Task *task, Entry entry, PriorityClass priority, size_t stackPages, IO::Array *parameters)
 	{
 		if(!IO::Object::Init())
@@ -44,6 +49,9 @@ namespace OS
 		_task  = task;
 		_entry = entry;
 		_esp   = 0;
+		_syscallState = nullptr;
+		_kernelContext = false;
+		_waitEnabled = true;
 		_priority = priority;
 		_kernelStack = nullptr;
 		_kernelStackVirtual = nullptr;
@@ -63,7 +71,7 @@ namespace OS
 		if(_task->_ring3)
 		{
 			_userStackPages   = std::min<size_t>(64, std::max<size_t>(24, stackPages));
-			_kernelStackPages = 1;
+			_kernelStackPages = 4; // Syscalls run on the kernel stack
 
 			KernReturn<void> result = InitializeForRing3(parameters);
 			if(!result.IsValid())
@@ -343,6 +351,46 @@ namespace OS
 		return (stack - size);
 	}
 
+	void Thread::PushKernelContext(Entry entry)
+	{
+		_syscallState = reinterpret_cast<Sys::CPUState *>(_esp);
+		_kernelContext = true;
+
+		// Build a ring 0 interrupt frame right below the userland state
+		uint32_t *stack = reinterpret_cast<uint32_t *>(_esp);
+
+		*(-- stack) = 0x0;   // esp
+		*(-- stack) = 0x200; // eflags
+		*(-- stack) = 0x8; // cs
+		*(-- stack) = entry; // eip
+
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+		*(-- stack) = 0x0;
+
+		*(-- stack) = 0x10;
+		*(-- stack) = 0x10;
+		*(-- stack) = 0x28;
+		*(-- stack) = 0x0;
+
+		_esp = reinterpret_cast<uint32_t>(stack);
+	}
+
+	void Thread::PopKernelContext()
+	{
+		_esp = reinterpret_cast<uint32_t>(_syscallState);
+		_syscallState = nullptr;
+		_kernelContext = false;
+	}
+
 	void Thread::SetESP(uint32_t esp)
 	{
 		_esp = esp;
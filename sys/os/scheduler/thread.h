@@ -31,6 +31,7 @@
 #include <libio/core/IOObject.h>
 #include <libio/core/IOArray.h>
 #include <os/ipc/IPCPort.h>
+#include <os/workqueue.h>
 
 namespace OS
 {
@@ -51,12 +52,28 @@ namespace OS
 		friend class Task;
 		typedef uint32_t Entry;
 
+		static constexpr size_t kSyscallArgumentsSize = 64;
+
 		void SetESP(uint32_t esp);
 		void SetSchedulingData(void *data);
+		void SetSyscallState(Sys::CPUState *state) { _syscallState = state; }
+
+		// Code running on behalf of another thread must not block this one, returns the previous value
+		bool SetWaitEnabled(bool enabled) { bool previous = _waitEnabled; _waitEnabled = enabled; return previous; }
+
+		// Moves the thread into a ring 0 context on its own kernel stack that starts at entry,
+		// the current userland state is preserved and restored with PopKernelContext()
+		void PushKernelContext(Entry entry);
+		void PopKernelContext();
 
 		Task *GetTask() const { return _task; }
 		tid_t GetTid() const { return _tid; }
 		uint32_t GetESP() const { return _esp; }
+		Sys::CPUState *GetSyscallState() const { return _syscallState; }
+		uint8_t *GetSyscallArguments() { return reinterpret_cast<uint8_t *>(_syscallArguments); }
+		bool IsInKernelContext() const { return _kernelContext; }
+		bool IsWaitEnabled() const { return _waitEnabled; }
+		WorkQueue::Entry *GetSyscallWorkEntry() { return &_syscallWorkEntry; }
 
 		template<class T>
 		T *GetSchedulingData() const { return static_cast<T *>(_schedulingData); }
@@ -76,6 +93,13 @@ namespace OS
 		vm_address_t GetTLSVirtual() const { return _tlsVirtual; }
 		void *GetJoinToken() const { return const_cast<void *>(reinterpret_cast<const void *>(&_joinToken)); }
 
+		// Wait queue, owned by the bucket lock of waitChannel while the thread is waiting
+		std::intrusive_list<Thread>::member waitEntry;
+		void *waitChannel;
+
+	protected:
+		Thread();
+
 	private:
 		KernReturn<Thread *> Init(Task *task, Entry entry, PriorityClass priority, size_t stackPages, IO::Array *parameters);
 		void Dealloc() override;
@@ -102,6 +126,12 @@ namespace OS
 		uint32_t _esp;
 		uint32_t _entry;
 
+		Sys::CPUState *_syscallState;
+		bool _kernelContext;
+		bool _waitEnabled;
+		uint32_t _syscallArguments[kSyscallArgumentsSize / sizeof(uint32_t)];
+		WorkQueue::Entry _syscallWorkEntry; // Deferred syscalls must not fail for a lack of work queue entries
+
 		uintptr_t _tlsPhysical;
 		vm_address_t _tlsVirtual;
 
@@ -25,7 +25,7 @@
 namespace OS
 {
 	#define KERN_TRAP(name, handler, argCount, argSize) \
-		{ name, false, (KernReturn<uint32_t> (*)(Thread *, void *))handler, (uint32_t)argCount, argSize }
+		{ name, false, false, (KernReturn<uint32_t> (*)(Thread *, void *))handler, (uint32_t)argCount, argSize }
 
 	#define KERN_TRAP_ARGENTRY(str, entry) \
 		{ offsetof(str, entry), sizeof(str::entry) }
@@ -65,7 +65,7 @@ namespace OS
 
 	KernReturn<uint32_t> KerntrapInvalid(Thread *thread, __unused void *args)
 	{
-		Sys::CPUState *state = reinterpret_cast<Sys::CPUState *>(thread->GetESP());
+		Sys::CPUState *state = thread->GetSyscallState();
 		kprintf("Invalid kernel trap %i\n", (int)state->eax);
 
 		return 0;
@@ -74,16 +74,16 @@ namespace OS
 	SyscallTrap _kernTrapTable[128] = {
 		/* 0 */ KERN_TRAP1("ipc_task_port", &OS::IPC::Syscall_IPCTaskPort, IPC::IPCPortCallArgs, port),
 		/* 1 */ KERN_TRAP1("ipc_thread_port", &OS::IPC::Syscall_IPCThreadPort, IPC::IPCPortCallArgs, port),
-		/* 2 */ KERN_TRAP3("ipc_message", &OS::IPC::Syscall_IPCMessage, IPC::IPCReadWriteArgs, header, size, mode),
+		/* 2 */ KERN_TRAP4("ipc_message", &OS::IPC::Syscall_IPCMessage, IPC::IPCReadWriteArgs, header, size, mode, completion),
 		/* 3 */ KERN_TRAP1("ipc_allocate_port", &OS::IPC::Syscall_IPCAllocatePort, IPC::IPCPortCallArgs, port),
 		/* 4 */ KERN_TRAP2("ipc_get_special_port", &OS::IPC::Syscall_IPCGetSpecialPort, IPC::IPCSpecialPortArgs, result, port),
 		/* 5 */ KERN_TRAP1("ipc_deallocate_port", &OS::IPC::Syscall_IPCDeallocatePort, IPC::IPCDeallcoatePortArgs, port),
 		/* 6 */ KERN_TRAP2("ipc_task_space", &OS::IPC::Syscall_IPCTaskSpace, IPC::IPCTaskSpaceCallArgs, space, pid),
 		/* 7 */ KERN_TRAP4("ipc_insert_port", &OS::IPC::Syscall_IPCInsertPort, IPC::IPCInsertPortArgs, space, target, port, right),
-		/* 8 */ KERN_TRAP_INVALID(),
-		/* 9 */ KERN_TRAP_INVALID(),
-		/* 10 */ KERN_TRAP_INVALID(),
-		/* 11 */ KERN_TRAP_INVALID(),
+		/* 8 */ KERN_TRAP3("ipc_ring_create", &OS::IPC::Syscall_IPCRingCreate, IPC::IPCRingCreateArgs, port, size, address),
+		/* 9 */ KERN_TRAP3("ipc_ring_map", &OS::IPC::Syscall_IPCRingMap, IPC::IPCRingMapArgs, port, address, size),
+		/* 10 */ KERN_TRAP3("ipc_ring_wait", &OS::IPC::Syscall_IPCRingWait, IPC::IPCRingWaitArgs, port, offset, expected),
+		/* 11 */ KERN_TRAP1("ipc_ring_notify", &OS::IPC::Syscall_IPCRingNotify, IPC::IPCRingNotifyArgs, port),
 		/* 12 */ KERN_TRAP_INVALID(),
 		/* 13 */ KERN_TRAP_INVALID(),
 		/* 14 */ KERN_TRAP_INVALID(),
@@ -19,11 +19,14 @@
 #include <libc/sys/spinlock.h>
 #include <libc/string.h>
 #include <machine/interrupts/interrupts.h>
+#include <machine/interrupts/trampoline.h>
 #include <os/scheduler/scheduler.h>
 #include <os/workqueue.h>
 #include <kern/kprintf.h>
 #include <kern/kalloc.h>
+#include <libcpp/algorithm.h>
 #include "syscall.h"
+#include "syscall_statistics.h"
 
 namespace OS
 {
@@ -60,25 +63,71 @@ namespace OS
 			Sys::VM::Directory::GetKernelDirectory()->Free(_address, _pages);
 	}
 
-	void CompleteSyscall(void *context)
+	static const SyscallTrap *GetSyscallTrap(Sys::CPUState *state)
 	{
-		Thread *thread = reinterpret_cast<Thread *>(context);
-		Sys::CPUState *state = reinterpret_cast<Sys::CPUState *>(thread->GetESP());
-		Sys::CPU *cpu = Sys::CPU::GetCurrentCPU();
+		bool kernelTrap = (state->interrupt == 0x81);
+		return kernelTrap ? (_kernTrapTable + state->eax) : (_syscallTrapTable + state->eax);
+	}
 
-		Scheduler *scheduler = Scheduler::GetScheduler();
+	static KernReturn<void> CopyStackArguments(Thread *thread, void *target, vm_address_t source, size_t length)
+	{
+		vm_address_t stackBegin = reinterpret_cast<vm_address_t>(thread->GetUserStackVirtual());
+		vm_address_t stackEnd = stackBegin + (thread->GetUserStackPages() * VM_PAGE_SIZE);
 
-		bool kernelTrap = (state->interrupt == 0x81);
-		const SyscallTrap *entry = kernelTrap ? (_kernTrapTable + state->eax) : (_syscallTrapTable + state->eax);
+		// The user stack is physically contiguous, so the common case doesn't have to walk the page tables
+		if(source >= stackBegin && source < stackEnd && length <= stackEnd - source)
+		{
+			uintptr_t physical = reinterpret_cast<uintptr_t>(thread->GetUserStack()) + (source - stackBegin);
+			return Sys::VM::CopyFromPhysical(target, physical, length);
+		}
 
+		return thread->GetTask()->GetDirectory()->CopyUserDataOut(source, target, length);
+	}
+
+	// sysenter can't pass the first and fourth argument in ecx and edx, they are left on the user stack
+	static KernReturn<void> CopySysenterArguments(Thread *thread, Sys::CPUState *state, size_t size)
+	{
+		KernReturn<void> result = CopyStackArguments(thread, &state->ecx, state->esp + 24, sizeof(uint32_t));
+		if(!result.IsValid())
+			return result;
+
+		if(size > 3 * sizeof(uint32_t))
+			return CopyStackArguments(thread, &state->edx, state->esp + 36, sizeof(uint32_t));
+
+		return ErrorNone;
+	}
+
+	static size_t GetArgumentSize(const SyscallTrap *entry)
+	{
+		if(!entry->argCount)
+			return 0;
+
+		return entry->args[entry->argCount - 1].offset + entry->args[entry->argCount - 1].size;
+	}
+
+	// The handler might have put the thread to sleep via WaitThread(),
+	// don't continue before it has been woken up again
+	static void WaitUntilRunnable(Scheduler *scheduler, Thread *thread)
+	{
+		while(scheduler->IsThreadBlocked(thread))
+			scheduler->RescheduleCPU(Sys::CPU::GetCurrentCPU());
+	}
+
+	static KernReturn<uint32_t> ExecuteSyscall(Thread *thread, Sys::CPUState *state, const SyscallTrap *entry)
+	{
 		uint8_t *arguments = nullptr;
 		if(entry->argCount)
 		{
-			size_t size = entry->args[entry->argCount - 1].offset + entry->args[entry->argCount - 1].size;
+			size_t size = GetArgumentSize(entry);
 
-			arguments = new uint8_t[size];
-			if(!arguments)
-				goto badMemory;
+			arguments = thread->GetSyscallArguments();
+
+			if(state->error == 1)
+			{
+				KernReturn<void> result = CopySysenterArguments(thread, state, size);
+				if(!result.IsValid())
+					return Error(KERN_INVALID_ADDRESS, EFAULT);
+			}
 
 			uint32_t *buffer = reinterpret_cast<uint32_t *>(arguments);
 
@@ -108,83 +157,111 @@ namespace OS
 					}
 				}
 
-				uint32_t offset = ((uint8_t *)state->esp) - thread->GetUserStackVirtual() + 24;
-				uintptr_t stack = ((uintptr_t)thread->GetUserStack()) + offset + argOffset; // Jump to the arguments on the stack
-
-				uintptr_t aligned = VM_PAGE_ALIGN_DOWN(stack);
-				size_t pages = VM_PAGE_COUNT((stack - aligned) + left);
-
-				Sys::VM::Directory *directory = Sys::VM::Directory::GetKernelDirectory();
-				KernReturn<vm_address_t> address = directory->Alloc(aligned, pages, kVMFlagsKernel);
+				vm_address_t stack = state->esp + 24 + argOffset; // Jump to the arguments on the stack
 
-				if(address.IsValid() == false)
-				{
-					delete[] arguments;
-					goto badMemory;
-				}
-
-				memcpy(arguments + argOffset, (uint8_t *)(address + (stack - aligned)), left);
-				directory->Free(address, pages);
+				KernReturn<void> result = CopyStackArguments(thread, arguments + argOffset, stack, left);
+				if(!result.IsValid())
+					return Error(KERN_INVALID_ADDRESS);
 			}
 		}
 
-		goto handler;
+		return entry->handler(thread, arguments);
+	}
 
-	badMemory:
-		if(kernelTrap)
+	static void StoreSyscallResult(Sys::CPUState *state, const KernReturn<uint32_t> &result)
+	{
+		if(state->interrupt == 0x81)
 		{
-			state->ecx = ENOMEM;
+			state->eax = (result.IsValid()) ? KERN_SUCCESS : result.GetError().GetCode();
+			return;
+		}
+
+		if(!result.IsValid())
+		{
+			Error error = result.GetError();
 			state->eax = static_cast<uint32_t>(-1);
+			state->ecx = error.GetErrno();
 		}
 		else
 		{
-			state->eax = KERN_NO_MEMORY;
+			state->eax = result;
+			state->ecx = 0;
 		}
+	}
+
+	void CompleteSyscall(void *context);
+	static void SyscallThreadEntry();
+
+	// Uses the entry embedded in the thread, so deferring a syscall can't run out of work queue entries
+	static void DeferSyscall(Thread *thread, Sys::CPU *cpu)
+	{
+		WorkQueue::Entry *entry = thread->GetSyscallWorkEntry();
+		entry->callback = &CompleteSyscall;
+		entry->context = thread;
+
+		cpu->GetWorkQueue()->PushEntry(entry);
+	}
+
+	// Used for traps that can't run on the calling thread and are deferred to the kernel work queue
+	void CompleteSyscall(void *context)
+	{
+		Thread *thread = reinterpret_cast<Thread *>(context);
+		Sys::CPUState *state = thread->GetSyscallState();
+
+		// The worker must not block on behalf of the calling thread. The flag lives in the worker
+		// thread, so it stays correct if the worker is preempted or migrated in the meantime
+		Thread *worker = Scheduler::GetScheduler()->GetActiveThread();
+		bool hadWait = worker->SetWaitEnabled(false);
+
+		uint64_t start = Sys::CPUReadTimestamp();
+		KernReturn<uint32_t> result = ExecuteSyscall(thread, state, GetSyscallTrap(state));
 
-		scheduler->UnblockThread(thread);
-		return;
+		worker->SetWaitEnabled(hadWait);
 
-	handler:
+		if(!result.IsValid() && result.GetError().GetCode() == KERN_TASK_RESTART)
 		{
-			bool hadFlag = cpu->GetFlagsSet(Sys::CPU::Flags::WaitQueueEnabled);
-			cpu->RemoveFlags(Sys::CPU::Flags::WaitQueueEnabled);
+			// The call wants to block, run it again on the caller's own kernel stack where it
+			// can sleep on the wait queue instead of being pushed through the work queue again
+			thread->PushKernelContext(reinterpret_cast<Thread::Entry>(&SyscallThreadEntry));
+			Scheduler::GetScheduler()->UnblockThread(thread);
+			return;
+		}
 
-			KernReturn<uint32_t> result = entry->handler(thread, arguments);
+		SyscallRecord(thread, state, start, result);
+		StoreSyscallResult(state, result);
 
-			if(hadFlag)
-				cpu->AddFlags(Sys::CPU::Flags::WaitQueueEnabled);
+		thread->SetSyscallState(nullptr);
+		Scheduler::GetScheduler()->UnblockThread(thread);
+	}
 
-			if(!result.IsValid() && result.GetError().GetCode() == KERN_TASK_RESTART)
-			{
-				delete[] arguments;
-				if(!cpu->GetWorkQueue()->PushEntry(&CompleteSyscall, reinterpret_cast<void *>(thread)))
-					panic("Out of workqueue items\n");
+	// Entry point of the ring 0 context that is pushed onto the calling thread.
+	// The handler runs preemptible on the threads own kernel stack, with the wait queue
+	// available, so blocking calls sleep in place instead of being polled from the work queue.
+	static void SyscallThreadEntry()
+	{
+		Scheduler *scheduler = Scheduler::GetScheduler();
 
-				return;
-			}
+		Thread *thread = scheduler->GetActiveThread();
+		Sys::CPUState *state = thread->GetSyscallState();
 
-			if(kernelTrap)
-			{
-				state->eax = (result.IsValid()) ? KERN_SUCCESS : result.GetError().GetCode();
-			}
-			else
-			{
-				if(!result.IsValid())
-				{
-					Error error = result.GetError();
-					state->eax = static_cast<uint32_t>(-1);
-					state->ecx = error.GetErrno();
-				}
-				else
-				{
-					state->eax = result;
-					state->ecx = 0;
-				}
-			}
+		{
+			uint64_t start = Sys::CPUReadTimestamp();
+
+			// Waiting is always possible here, blocking calls sleep instead of asking for a restart
+			const SyscallTrap *entry = GetSyscallTrap(state);
+			KernReturn<uint32_t> result = ExecuteSyscall(thread, state, entry);
+
+			SyscallRecord(thread, state, start, result);
+			StoreSyscallResult(state, result);
 		}
 
-		delete[] arguments;
-		scheduler->UnblockThread(thread);
+		WaitUntilRunnable(scheduler, thread);
+		Sys::DisableInterrupts();
+
+		Sys::VM::Directory *directory = thread->GetTask()->GetDirectory();
+		thread->PopKernelContext();
+
+		Sys::TrampolineReturnToUserland(directory, state);
 	}
 
 	uint32_t HandleSyscall(uint32_t esp, Sys::CPU *cpu)
@@ -199,25 +276,161 @@ namespace OS
 		Thread *thread = scheduler->GetActiveThread();
 		thread->SetESP(esp);
 
-		scheduler->BlockThread(thread);
+		const SyscallTrap *entry = GetSyscallTrap(state);
+
+		if(entry->interruptSafe)
+		{
+			thread->SetSyscallState(state);
 
+			bool hadWait = thread->SetWaitEnabled(false);
 
-		bool kernelTrap = (state->interrupt == 0x81);
-		const SyscallTrap *entry = kernelTrap ? (_kernTrapTable + state->eax) : (_syscallTrapTable + state->eax);
+			uint64_t start = Sys::CPUReadTimestamp();
+			KernReturn<uint32_t> result = ExecuteSyscall(thread, state, entry);
 
-		if(!entry->interruptSafe)
+			thread->SetWaitEnabled(hadWait);
+
+			SyscallRecord(thread, state, start, result);
+			StoreSyscallResult(state, result);
+			thread->SetSyscallState(nullptr);
+
+			return scheduler->PokeCPU(esp, cpu);
+		}
+
+		if(entry->deferred)
 		{
-			if(!cpu->GetWorkQueue()->PushEntry(&CompleteSyscall, reinterpret_cast<void *>(thread)))
-				panic("Out of workqueue items!\n");
+			thread->SetSyscallState(state);
+			scheduler->BlockThread(thread);
+
+			DeferSyscall(thread, cpu);
+
+			return scheduler->PokeCPU(esp, cpu);
 		}
-		else
-			CompleteSyscall(thread);
 
-		return Scheduler::GetScheduler()->PokeCPU(esp, cpu);
+		// Resume the thread in its kernel context right away, the trampoline has to
+		// switch to the kernel directory since the scheduler might not run in between
+		thread->PushKernelContext(reinterpret_cast<Thread::Entry>(&SyscallThreadEntry));
+		cpu->GetTrampoline()->pageDirectory = Sys::VM::Directory::GetKernelDirectory()->GetPhysicalDirectory();
+
+		return scheduler->PokeCPU(thread->GetESP(), cpu);
+	}
+
+	static bool IsBatchable(uint32_t type)
+	{
+		if(type >= 128)
+			return false;
+
+		switch(type)
+		{
+			// These replace or tear down the calling context, or rely on the trap state of the caller
+			case SYS_Exit:
+			case SYS_Fork:
+			case SYS_Exec:
+			case SYS_Spawn:
+			case SYS_Batch:
+				return false;
+
+			default:
+				break;
+		}
+
+		const SyscallTrap *entry = _syscallTrapTable + type;
+		return (!entry->deferred && GetArgumentSize(entry) <= sizeof(syscall_batch_entry_t::args));
+	}
+
+	// Runs a list of syscalls with a single trap. The entries are copied in and out in chunks,
+	// each call runs on the calling thread exactly like it would when trapped individually.
+	KernReturn<uint32_t> Syscall_Batch(Thread *thread, SyscallBatchArgs *arguments)
+	{
+		if(arguments->count == 0 || arguments->count > SYSCALL_BATCH_MAX)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		Scheduler *scheduler = Scheduler::GetScheduler();
+		Sys::VM::Directory *directory = thread->GetTask()->GetDirectory();
+
+		vm_address_t address = reinterpret_cast<vm_address_t>(arguments->entries);
+		size_t count = arguments->count;
+		int flags = arguments->flags;
+
+		syscall_batch_entry_t entries[8];
+		size_t executed = 0;
+		bool stop = false;
+
+		while(executed < count && !stop)
+		{
+			size_t chunk = std::min<size_t>(count - executed, 8);
+			vm_address_t chunkAddress = address + executed * sizeof(syscall_batch_entry_t);
+
+			if(!directory->CopyUserDataOut(chunkAddress, entries, chunk * sizeof(syscall_batch_entry_t)).IsValid())
+			{
+				if(executed > 0)
+					break;
+
+				return Error(KERN_INVALID_ADDRESS, EFAULT);
+			}
+
+			size_t done = 0;
+
+			for(; done < chunk; done ++)
+			{
+				syscall_batch_entry_t *entry = entries + done;
+				KernReturn<uint32_t> result;
+
+				if(IsBatchable(entry->type))
+				{
+					const SyscallTrap *trap = _syscallTrapTable + entry->type;
+					result = trap->handler(thread, entry->args);
+
+					WaitUntilRunnable(scheduler, thread);
+				}
+				else
+				{
+					result = Error(KERN_INVALID_ARGUMENT, ENOSYS);
+				}
+
+				if(result.IsValid())
+				{
+					entry->result = result.Get();
+					entry->error = 0;
+				}
+				else
+				{
+					entry->result = static_cast<uint32_t>(-1);
+					entry->error = result.GetError().GetErrno();
+
+					if(flags & SYSCALL_BATCH_STOP_ON_ERROR)
+					{
+						stop = true;
+						done ++;
+
+						break;
+					}
+				}
+			}
+
+			if(!directory->CopyUserDataIn(entries, chunkAddress, done * sizeof(syscall_batch_entry_t)).IsValid())
+				return Error(KERN_INVALID_ADDRESS, EFAULT);
+
+			executed += done;
+		}
+
+		return static_cast<uint32_t>(executed);
+	}
+
+	static void ValidateSyscallTable(const SyscallTrap *table, size_t count)
+	{
+		for(size_t i = 0; i < count; i ++)
+		{
+			const SyscallTrap *entry = table + i;
+			if(GetArgumentSize(entry) > Thread::kSyscallArgumentsSize)
+				panic("Arguments of syscall %s don't fit into the thread's argument area", entry->name);
+		}
 	}
 
 	KernReturn<void> SyscallInit()
 	{
+		ValidateSyscallTable(_syscallTrapTable, 128);
+		ValidateSyscallTable(_kernTrapTable, 128);
+
 		Sys::SetInterruptHandler(0x80, HandleSyscall);
 		Sys::SetInterruptHandler(0x81, HandleSyscall);
 
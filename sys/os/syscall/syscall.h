@@ -39,11 +39,19 @@ namespace OS
 	{
 		const char *name;
 		bool interruptSafe;
+		bool deferred; // Can't run on the calling thread and is executed by the kernel work queue instead
 		KernReturn<uint32_t> (*handler)(Thread *thread, void *);
 		uint32_t argCount;
 		SyscallArg args[8];
 	};
 
+	struct SyscallBatchArgs
+	{
+		syscall_batch_entry_t *entries;
+		size_t count;
+		int flags;
+	} __attribute__((packed));
+
 	class SyscallScopedMapping
 	{
 	public:
@@ -74,6 +82,7 @@ namespace OS
 		size_t _pages;
 	};
 
+	KernReturn<uint32_t> Syscall_Batch(Thread *thread, SyscallBatchArgs *arguments);
 	KernReturn<void> SyscallInit();
 }
 
@@ -22,11 +22,16 @@
 #include <vfs/vfs_syscall.h>
 #include <os/scheduler/scheduler_syscall.h>
 #include "syscall_mmap.h"
+#include "syscall_uring.h"
+#include <os/locks/futex.h>
 
 namespace OS
 {
 	#define SYSCALL_TRAP(name, handler, argCount, argSize) \
-		{ name, false, (KernReturn<uint32_t> (*)(Thread *, void *))handler, (uint32_t)argCount, argSize }
+		{ name, false, false, (KernReturn<uint32_t> (*)(Thread *, void *))handler, (uint32_t)argCount, argSize }
+
+	#define SYSCALL_TRAP_DEFERRED(name, handler, argCount, argSize) \
+		{ name, false, true, (KernReturn<uint32_t> (*)(Thread *, void *))handler, (uint32_t)argCount, argSize }
 
 	#define SYSCALL_ARGENTRY(struct, entry) \
 		{ offsetof(struct, entry), sizeof(struct::entry) }
@@ -65,14 +70,14 @@ namespace OS
 
 	KernReturn<uint32_t> SyscallInvalid(Thread *thread, __unused void *args)
 	{
-		Sys::CPUState *state = reinterpret_cast<Sys::CPUState *>(thread->GetESP());
+		Sys::CPUState *state = thread->GetSyscallState();
 		kprintf("Invalid syscall trap %i\n", (int)state->eax);
 
 		return 0;
 	}
 
 	SyscallTrap _syscallTrapTable[128] = {
-		/* 0 */ SYSCALL_TRAP1("exit", &OS::Syscall_SchedThreadExit, SchedThreadExitArgs, exitCode),
+		/* 0 */ SYSCALL_TRAP_DEFERRED("exit", &OS::Syscall_SchedThreadExit, 1, SYSCALL_ARGENTRIES(SYSCALL_ARGENTRY(SchedThreadExitArgs, exitCode))), // Removes the calling thread
 		/* 1 */ SYSCALL_TRAP2("open", &VFS::Syscall_VFSOpen, VFS::VFSOpenArgs, path, flags),
 		/* 2 */ SYSCALL_TRAP1("close", &VFS::Syscall_VFSClose, VFS::VFSCloseArgs, fd),
 		/* 3 */ SYSCALL_TRAP3("read", &VFS::Syscall_VFSRead, VFS::VFSReadArgs, fd, data, size),
@@ -88,19 +93,19 @@ namespace OS
 		/* 13 */ SYSCALL_TRAP0("fork", &OS::Syscall_Fork),
 		/* 14 */ SYSCALL_TRAP3("exec", &OS::Syscall_Exec, OS::SchedExecArgs, path, args, envp),
 		/* 15 */ SYSCALL_TRAP3("spawn", &OS::Syscall_Spawn, OS::SchedExecArgs, path, args, envp),
-		/* 16 */ SYSCALL_TRAP_INVALID(),
-		/* 17 */ SYSCALL_TRAP_INVALID(),
-		/* 18 */ SYSCALL_TRAP_INVALID(),
-		/* 19 */ SYSCALL_TRAP_INVALID(),
+		/* 16 */ SYSCALL_TRAP4("pread", &VFS::Syscall_VFSPread, VFS::VFSPreadArgs, fd, data, size, offset),
+		/* 17 */ SYSCALL_TRAP4("pwrite", &VFS::Syscall_VFSPwrite, VFS::VFSPwriteArgs, fd, data, size, offset),
+		/* 18 */ SYSCALL_TRAP3("readv", &VFS::Syscall_VFSReadv, VFS::VFSVectorArgs, fd, vector, count),
+		/* 19 */ SYSCALL_TRAP3("writev", &VFS::Syscall_VFSWritev, VFS::VFSVectorArgs, fd, vector, count),
 		/* 20 */ SYSCALL_TRAP6("mmap", &OS::Syscall_mmap, OS::MmapArgs, address, length, protection, flags, fd, offset),
 		/* 21 */ SYSCALL_TRAP_INVALID(),
 		/* 22 */ SYSCALL_TRAP_INVALID(),
 		/* 23 */ SYSCALL_TRAP3("msync", &OS::Syscall_msync, OS::MsyncArgs, address, length, flags),
-		/* 24 */ SYSCALL_TRAP_INVALID(),
-		/* 25 */ SYSCALL_TRAP_INVALID(),
-		/* 26 */ SYSCALL_TRAP_INVALID(),
-		/* 27 */ SYSCALL_TRAP_INVALID(),
-		/* 28 */ SYSCALL_TRAP_INVALID(),
+		/* 24 */ SYSCALL_TRAP3("batch", &OS::Syscall_Batch, OS::SyscallBatchArgs, entries, count, flags),
+		/* 25 */ SYSCALL_TRAP2("uring_setup", &OS::Syscall_UringSetup, OS::UringSetupArgs, entries, params),
+		/* 26 */ SYSCALL_TRAP3("uring_enter", &OS::Syscall_UringEnter, OS::UringEnterArgs, toSubmit, minComplete, flags),
+		/* 27 */ SYSCALL_TRAP3("futex", &OS::Syscall_Futex, OS::FutexArgs, address, operation, value),
+		/* 28 */ SYSCALL_TRAP3("getdents", &VFS::Syscall_VFSGetdents, VFS::VFSReadArgs, fd, data, size),
 		/* 29 */ SYSCALL_TRAP_INVALID(),
 		/* 30 */ SYSCALL_TRAP_INVALID(),
 		/* 31 */ SYSCALL_TRAP_INVALID(),
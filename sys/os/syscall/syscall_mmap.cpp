@@ -21,6 +21,7 @@
 #include <vfs/vfs.h>
 #include <vfs/file.h>
 #include "syscall_mmap.h"
+#include "syscall_uring.h"
 
 namespace OS
 {
@@ -95,28 +96,17 @@ namespace OS
 
 	KernReturn<MmapTaskEntry *> mmapFile(OS::Task *task, MmapArgs *arguments)
 	{
-		task->Lock();
-
 		int fd = arguments->fd;
-		VFS::File *file = task->GetFileForDescriptor(fd);
+		IO::StrongRef<VFS::File> file = task->GetFileForDescriptor(fd);
 
 		if(!file)
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT);
-		}
 
 		VFS::Node *node = file->GetNode();
 		if(node->IsDirectory())
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT);
-		}
-
-		KernReturn<MmapTaskEntry *> result = node->GetInstance()->Mmap(task->GetVFSContext(), node, arguments);
-		task->Unlock();
 
-		return result;
+		return node->GetInstance()->Mmap(task->GetVFSContext(), node, arguments);
 	}
 
 	KernReturn<uint32_t> Syscall_mmap(OS::Thread *thread, MmapArgs *arguments)
@@ -135,6 +125,27 @@ namespace OS
 
 		OS::Task *task = thread->GetTask();
 
+		if(flags & MAP_URING)
+		{
+			Uring *uring = task->CopyUring();
+			if(!uring)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			if(address || !(flags & MAP_SHARED) || length != uring->GetPages() * VM_PAGE_SIZE)
+			{
+				uring->Release();
+				return Error(KERN_INVALID_ARGUMENT);
+			}
+
+			KernReturn<vm_address_t> result = uring->MapIntoTask(task);
+			uring->Release();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			return result.Get();
+		}
+
 		if(flags & MAP_ANONYMOUS)
 		{
 			if((address && (address % VM_PAGE_SIZE) != 0) || (length % VM_PAGE_SIZE) != 0 || length == 0)
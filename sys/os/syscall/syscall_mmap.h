@@ -50,6 +50,7 @@ namespace OS
 	{
 		MmapTaskEntry(VFS::Node *tnode) :
 			node(tnode),
+			object(nullptr),
 			taskEntry(this)
 		{
 			IO::SafeRetain(node);
@@ -58,6 +59,7 @@ namespace OS
 		~MmapTaskEntry()
 		{
 			IO::SafeRelease(node);
+			IO::SafeRelease(object);
 		}
 
 		uintptr_t phaddress;
@@ -70,6 +72,7 @@ namespace OS
 		off_t offset;
 
 		VFS::Node *node;
+		IO::Object *object; // Owner of the backing pages, retained. The page cache for shared file mappings, the ring for IPC and uring mappings, nullptr for anonymous and private copies
 		std::intrusive_list<MmapTaskEntry>::member taskEntry;
 	};
 
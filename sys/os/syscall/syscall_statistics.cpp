@@ -0,0 +1,340 @@
+//
+//  syscall_statistics.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/sys/spinlock.h>
+#include <libc/stdlib.h>
+#include <libcpp/atomic.h>
+#include <kern/kalloc.h>
+#include <kern/histogram.h>
+#include <kern/statistics_writer.h>
+#include <machine/interrupts/interrupts.h>
+#include <os/scheduler/task.h>
+#include <vfs/context.h>
+#include "syscall.h"
+#include "syscall_statistics.h"
+
+namespace OS
+{
+	extern SyscallTrap _syscallTrapTable[];
+	extern SyscallTrap _kernTrapTable[];
+
+	static constexpr size_t kTrapCount = 128;
+	static constexpr size_t kMaxTracedTasks = 8;
+	static constexpr size_t kTraceEntries = 256;
+	static constexpr size_t kStatisticsBufferSize = 16 * VM_PAGE_SIZE;
+
+	struct SyscallStatistics
+	{
+		spinlock_t lock;
+		uint64_t calls;
+		uint64_t errors;
+		Histogram latency; // TSC cycles
+	};
+
+	struct SyscallTraceEntry
+	{
+		uint64_t timestamp;
+		uint64_t latency;
+		tid_t tid;
+		uint32_t trap;
+		bool kernelTrap;
+		uint32_t arguments[3];
+		uint32_t result;
+		uint32_t error;
+	};
+
+	struct SyscallTrace
+	{
+		pid_t pid; // 0 if the slot is free
+		size_t head; // Total number of recorded entries, the ring holds the last kTraceEntries
+		SyscallTraceEntry entries[kTraceEntries];
+	};
+
+	// Indexed by [kernelTrap][trap]. The lock is per trap, so only the same trap running on
+	// several CPUs at once contends, which is cheaper than per CPU tables of this size
+	static SyscallStatistics _statistics[2][kTrapCount];
+
+	static spinlock_t _traceLock = SPINLOCK_INIT;
+	static std::atomic<uint32_t> _tracedTasks;
+	static SyscallTrace *_traces[kMaxTracedTasks];
+
+	// Traps on the interrupt safe path are recorded with interrupts disabled, so none
+	// of the locks may ever be held by a thread that can be preempted on the same CPU
+	static bool AcquireLock(spinlock_t *lock)
+	{
+		bool enabled = Sys::DisableInterrupts();
+		spinlock_lock(lock);
+
+		return enabled;
+	}
+
+	static void ReleaseLock(spinlock_t *lock, bool enabled)
+	{
+		spinlock_unlock(lock);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+	}
+
+	static void RecordTrace(Thread *thread, const Sys::CPUState *state, bool kernelTrap, uint64_t start, uint64_t latency, const KernReturn<uint32_t> &result)
+	{
+		pid_t pid = thread->GetTask()->GetPid();
+		bool enabled = AcquireLock(&_traceLock);
+
+		for(size_t i = 0; i < kMaxTracedTasks; i ++)
+		{
+			SyscallTrace *trace = _traces[i];
+			if(!trace || trace->pid != pid)
+				continue;
+
+			SyscallTraceEntry *entry = trace->entries + (trace->head % kTraceEntries);
+			trace->head ++;
+
+			entry->timestamp = start;
+			entry->latency = latency;
+			entry->tid = thread->GetTid();
+			entry->trap = state->eax;
+			entry->kernelTrap = kernelTrap;
+			entry->arguments[0] = state->ecx;
+			entry->arguments[1] = state->edi;
+			entry->arguments[2] = state->esi;
+
+			if(result.IsValid())
+			{
+				entry->result = result.Get();
+				entry->error = 0;
+			}
+			else
+			{
+				entry->result = static_cast<uint32_t>(-1);
+				entry->error = result.GetError().GetErrno();
+			}
+
+			break;
+		}
+
+		ReleaseLock(&_traceLock, enabled);
+	}
+
+	void SyscallRecord(Thread *thread, const Sys::CPUState *state, uint64_t start, const KernReturn<uint32_t> &result)
+	{
+		uint64_t latency = Sys::CPUReadTimestamp() - start;
+		bool kernelTrap = (state->interrupt == 0x81);
+
+		if(state->eax >= kTrapCount)
+			return;
+
+		SyscallStatistics *statistics = &_statistics[kernelTrap][state->eax];
+
+		bool enabled = AcquireLock(&statistics->lock);
+
+		statistics->calls ++;
+		statistics->latency.Record(latency);
+
+		if(!result.IsValid())
+			statistics->errors ++;
+
+		ReleaseLock(&statistics->lock, enabled);
+
+		if(__expect_false(_tracedTasks.load() > 0))
+			RecordTrace(thread, state, kernelTrap, start, latency, result);
+	}
+
+	static const char *GetTrapName(bool kernelTrap, uint32_t trap)
+	{
+		return kernelTrap ? _kernTrapTable[trap].name : _syscallTrapTable[trap].name;
+	}
+
+	static void WriteTable(StatisticsWriter &writer, bool kernelTrap)
+	{
+		for(size_t i = 0; i < kTrapCount; i ++)
+		{
+			SyscallStatistics *statistics = &_statistics[kernelTrap][i];
+			bool enabled = AcquireLock(&statistics->lock);
+
+			if(statistics->calls == 0)
+			{
+				ReleaseLock(&statistics->lock, enabled);
+				continue;
+			}
+
+			const Histogram &latency = statistics->latency;
+
+			writer.Print("%s %u (%s): %u calls, %u errors, avg %u cycles, max %u cycles\n",
+				kernelTrap ? "kerntrap" : "syscall", (uint32_t)i, GetTrapName(kernelTrap, i),
+				(uint32_t)statistics->calls, (uint32_t)statistics->errors,
+				(uint32_t)(latency.GetSum() / latency.GetCount()), (uint32_t)latency.GetMax());
+
+			for(size_t j = 0; j < Histogram::kBuckets; j ++)
+			{
+				if(latency.GetBucket(j))
+					writer.Print("  latency < 2^%u: %u\n", (uint32_t)(j + 1), (uint32_t)latency.GetBucket(j));
+			}
+
+			ReleaseLock(&statistics->lock, enabled);
+		}
+	}
+
+	size_t SyscallStatisticsRead(__unused void *memo, VFS::Context *context, off_t offset, void *data, size_t size)
+	{
+		char *buffer = static_cast<char *>(kalloc(kStatisticsBufferSize));
+		if(!buffer)
+			return static_cast<size_t>(-1);
+
+		StatisticsWriter writer(buffer, kStatisticsBufferSize);
+
+		WriteTable(writer, false);
+		WriteTable(writer, true);
+
+		size_t result = writer.CopyOut(context, offset, data, size);
+
+		kfree(buffer);
+		return result;
+	}
+
+	size_t SyscallTraceRead(__unused void *memo, VFS::Context *context, off_t offset, void *data, size_t size)
+	{
+		char *buffer = static_cast<char *>(kalloc(kStatisticsBufferSize));
+		if(!buffer)
+			return static_cast<size_t>(-1);
+
+		StatisticsWriter writer(buffer, kStatisticsBufferSize);
+		bool enabled = AcquireLock(&_traceLock);
+
+		for(size_t i = 0; i < kMaxTracedTasks; i ++)
+		{
+			SyscallTrace *trace = _traces[i];
+			if(!trace || trace->pid == 0)
+				continue;
+
+			size_t count = std::min(trace->head, kTraceEntries);
+			size_t first = trace->head - count;
+
+			for(size_t j = first; j < trace->head; j ++)
+			{
+				const SyscallTraceEntry *entry = trace->entries + (j % kTraceEntries);
+
+				writer.Print("%u:%u %s(0x%x, 0x%x, 0x%x) = %d", (uint32_t)trace->pid, (uint32_t)entry->tid, GetTrapName(entry->kernelTrap, entry->trap),
+					entry->arguments[0], entry->arguments[1], entry->arguments[2], (int32_t)entry->result);
+
+				if(entry->error)
+					writer.Print(" (errno %u)", entry->error);
+
+				writer.Print(" <%u cycles>\n", (uint32_t)entry->latency);
+			}
+		}
+
+		ReleaseLock(&_traceLock, enabled);
+
+		size_t result = writer.CopyOut(context, offset, data, size);
+
+		kfree(buffer);
+		return result;
+	}
+
+	static void StopTracing(pid_t pid)
+	{
+		bool enabled = AcquireLock(&_traceLock);
+
+		for(size_t i = 0; i < kMaxTracedTasks; i ++)
+		{
+			if(_traces[i] && _traces[i]->pid == pid)
+			{
+				// The slot is reused by the next task that gets traced, the memory stays around
+				_traces[i]->pid = 0;
+				_tracedTasks --;
+			}
+		}
+
+		ReleaseLock(&_traceLock, enabled);
+	}
+
+	static bool StartTracing(pid_t pid)
+	{
+		// Can't allocate with the lock held, so grab the memory up front and give it back if it wasn't needed
+		SyscallTrace *allocated = static_cast<SyscallTrace *>(kalloc(sizeof(SyscallTrace)));
+		SyscallTrace **slot = nullptr;
+		bool traced = false;
+
+		bool enabled = AcquireLock(&_traceLock);
+
+		for(size_t i = 0; i < kMaxTracedTasks; i ++)
+		{
+			SyscallTrace *trace = _traces[i];
+
+			if(trace && trace->pid == pid)
+			{
+				traced = true;
+				break;
+			}
+
+			// Prefer reusing an idle ring over installing the new one
+			if(trace && trace->pid == 0 && (!slot || !*slot))
+				slot = _traces + i;
+			else if(!trace && !slot && allocated)
+				slot = _traces + i;
+		}
+
+		if(!traced && slot)
+		{
+			if(!*slot)
+			{
+				*slot = allocated;
+				allocated = nullptr;
+			}
+
+			(*slot)->pid = pid;
+			(*slot)->head = 0;
+
+			_tracedTasks ++;
+			traced = true;
+		}
+
+		ReleaseLock(&_traceLock, enabled);
+
+		if(allocated)
+			kfree(allocated);
+
+		return traced;
+	}
+
+	size_t SyscallTraceWrite(__unused void *memo, VFS::Context *context, __unused off_t offset, const void *data, size_t size)
+	{
+		char buffer[16];
+
+		if(size == 0 || size >= sizeof(buffer))
+			return static_cast<size_t>(-1);
+
+		if(!context->CopyDataOut(data, buffer, size).IsValid())
+			return static_cast<size_t>(-1);
+
+		buffer[size] = '\0';
+
+		int pid = atoi(buffer);
+		if(pid == 0)
+			return static_cast<size_t>(-1);
+
+		if(pid < 0)
+		{
+			StopTracing(-pid);
+			return size;
+		}
+
+		return StartTracing(pid) ? size : static_cast<size_t>(-1);
+	}
+}
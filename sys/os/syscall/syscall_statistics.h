@@ -0,0 +1,51 @@
+//
+//  syscall_statistics.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYSCALL_STATISTICS_H_
+#define _SYSCALL_STATISTICS_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libc/sys/types.h>
+#include <kern/kern_return.h>
+#include <machine/cpu.h>
+
+namespace VFS
+{
+	class Context;
+}
+
+namespace OS
+{
+	class Thread;
+	struct SyscallTrap;
+
+	// Accounts a finished trap. start is the timestamp taken before the handler ran,
+	// the latency therefore includes restarts and the time the handler spent blocked
+	void SyscallRecord(Thread *thread, const Sys::CPUState *state, uint64_t start, const KernReturn<uint32_t> &result);
+
+	// Read callback for /dev/syscallstat, per trap call and error counts plus latency histograms
+	size_t SyscallStatisticsRead(void *memo, VFS::Context *context, off_t offset, void *data, size_t size);
+
+	// /dev/strace. Writing a pid starts tracing every trap of that task into a ring, writing
+	// the negated pid stops it again. Reading dumps the rings of all traced tasks
+	size_t SyscallTraceRead(void *memo, VFS::Context *context, off_t offset, void *data, size_t size);
+	size_t SyscallTraceWrite(void *memo, VFS::Context *context, off_t offset, const void *data, size_t size);
+}
+
+#endif /* _SYSCALL_STATISTICS_H_ */
@@ -0,0 +1,374 @@
+//
+//  syscall_uring.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libc/sys/mman.h>
+#include <os/scheduler/task.h>
+#include <os/ipc/IPCSpace.h>
+#include <os/ipc/IPCMessage.h>
+#include <os/interruptguard.h>
+#include <os/waitqueue.h>
+#include <os/workqueue.h>
+#include <machine/cpu.h>
+#include <vfs/vfs.h>
+#include "syscall.h"
+#include "syscall_uring.h"
+
+namespace OS
+{
+	IODefineMeta(Uring, IO::Object)
+
+	Uring *Uring::Init(Task *task, size_t entries)
+	{
+		if(!IO::Object::Init())
+			return nullptr;
+
+		_header = nullptr;
+		_pages = 0;
+		_sqHead = 0;
+		_cqTail = 0;
+		_task = task;
+		_scheduled = false;
+		_pending = false;
+		spinlock_init(&_lock);
+
+		// Callers only get nullptr back, so the half built ring has to go here
+		if(entries == 0 || entries > URING_MAX_ENTRIES || (entries & (entries - 1)) != 0)
+		{
+			Release();
+			return nullptr;
+		}
+
+		size_t sqOffset = 64;
+		size_t cqOffset = sqOffset + entries * sizeof(uring_sqe_t);
+		size_t size = cqOffset + (entries * 2) * sizeof(uring_cqe_t);
+
+		_pages = VM_PAGE_COUNT(size);
+		_header = Sys::Alloc<uring_header_t>(Sys::VM::Directory::GetKernelDirectory(), _pages, kVMFlagsKernel);
+
+		if(!_header)
+		{
+			Release();
+			return nullptr;
+		}
+
+		_pmemory = Sys::VM::Directory::GetKernelDirectory()->ResolveAddress(reinterpret_cast<vm_address_t>(_header));
+
+		memset(_header, 0, _pages * VM_PAGE_SIZE);
+
+		_sqEntries = static_cast<uint32_t>(entries);
+		_cqEntries = static_cast<uint32_t>(entries * 2);
+		_sqes = reinterpret_cast<uring_sqe_t *>(reinterpret_cast<uint8_t *>(_header) + sqOffset);
+		_cqes = reinterpret_cast<uring_cqe_t *>(reinterpret_cast<uint8_t *>(_header) + cqOffset);
+
+		_header->sqEntries = _sqEntries;
+		_header->cqEntries = _cqEntries;
+		_header->sqOffset = static_cast<unsigned int>(sqOffset);
+		_header->cqOffset = static_cast<unsigned int>(cqOffset);
+
+		return this;
+	}
+
+	void Uring::Dealloc()
+	{
+		if(_header)
+			Sys::Free(_header, Sys::VM::Directory::GetKernelDirectory(), _pages);
+
+		IO::Object::Dealloc();
+	}
+
+	KernReturn<vm_address_t> Uring::MapIntoTask(Task *task)
+	{
+		Sys::VM::Directory *directory = task->GetDirectory();
+
+		KernReturn<vm_address_t> vmemory = directory->Alloc(_pmemory, _pages, kVMFlagsUserlandRW);
+		if(!vmemory.IsValid())
+			return vmemory.GetError();
+
+		MmapTaskEntry *entry = new MmapTaskEntry(nullptr);
+		if(!entry)
+		{
+			directory->Free(vmemory, _pages);
+			return Error(KERN_NO_MEMORY);
+		}
+
+		entry->phaddress = _pmemory;
+		entry->vmaddress = vmemory;
+		entry->protection = PROT_READ | PROT_WRITE;
+		entry->pages = _pages;
+		entry->flags = MAP_SHARED | MAP_URING;
+		entry->offset = 0;
+		entry->object = Retain();
+
+		task->Lock();
+		task->mmapList.push_front(entry->taskEntry);
+		task->Unlock();
+
+		return vmemory;
+	}
+
+	void Uring::Submit()
+	{
+		spinlock_lock(&_lock);
+
+		_pending = true;
+
+		bool schedule = !_scheduled;
+		_scheduled = true;
+
+		spinlock_unlock(&_lock);
+
+		if(schedule)
+		{
+			// The worker might outlive the last reference the task has on us, and we need the task for the VFS context
+			Retain();
+			_task->Retain();
+
+			bool pushed;
+
+			{
+				InterruptGuard guard(InterruptGuard::Mode::DisableInterrupts);
+				pushed = Sys::CPU::GetCurrentCPU()->GetWorkQueue()->PushEntry(&Uring::Drain, this);
+			}
+
+			if(!pushed)
+				Drain(this);
+		}
+	}
+
+	KernReturn<void> Uring::Wait(Thread *thread, uint32_t minComplete)
+	{
+		if(minComplete > _cqEntries)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		// Drain() posts and wakes up under the same lock, so the wakeup can't slip in between the check and the wait
+		spinlock_lock(&_lock);
+
+		uint32_t available = _cqTail - __atomic_load_n(&_header->cqHead, __ATOMIC_ACQUIRE);
+		if(available >= minComplete)
+		{
+			spinlock_unlock(&_lock);
+			return ErrorNone;
+		}
+
+		KernReturn<void> result = WaitThread(thread, this);
+		spinlock_unlock(&_lock);
+
+		return result;
+	}
+
+	bool Uring::ConsumeSubmission(uring_sqe_t &sqe)
+	{
+		uint32_t head = _sqHead;
+		uint32_t tail = __atomic_load_n(&_header->sqTail, __ATOMIC_ACQUIRE);
+
+		if(head == tail || tail - head > _sqEntries)
+			return false;
+
+		// Back pressure, leave the submission queued until userland reaped some completions
+		uint32_t completions = _cqTail - __atomic_load_n(&_header->cqHead, __ATOMIC_ACQUIRE);
+		if(completions >= _cqEntries)
+			return false;
+
+		// Userland can scribble over the shared entry at any point, so work on a private copy
+		memcpy(&sqe, _sqes + (head & (_sqEntries - 1)), sizeof(uring_sqe_t));
+
+		_sqHead = head + 1;
+		__atomic_store_n(&_header->sqHead, _sqHead, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	static KernReturn<uint32_t> TransferResult(KernReturn<size_t> &&result)
+	{
+		if(!result.IsValid())
+			return result.GetError();
+
+		return static_cast<uint32_t>(result.Get());
+	}
+
+	KernReturn<uint32_t> Uring::Execute(const uring_sqe_t &sqe)
+	{
+		VFS::Context *context = _task->GetVFSContext();
+
+		switch(sqe.opcode)
+		{
+			case URING_OP_NOP:
+				return 0;
+
+			case URING_OP_READ:
+				if(sqe.offset == -1)
+					return TransferResult(VFS::Read(context, sqe.fd, sqe.address, sqe.length));
+
+				return TransferResult(VFS::ReadAt(context, sqe.fd, sqe.address, sqe.length, sqe.offset));
+
+			case URING_OP_WRITE:
+				if(sqe.offset == -1)
+					return TransferResult(VFS::Write(context, sqe.fd, sqe.address, sqe.length));
+
+				return TransferResult(VFS::WriteAt(context, sqe.fd, sqe.address, sqe.length, sqe.offset));
+
+			case URING_OP_READV:
+				return TransferResult(VFS::ReadVector(context, sqe.fd, reinterpret_cast<const iovec *>(sqe.address), static_cast<int>(sqe.length)));
+
+			case URING_OP_WRITEV:
+				return TransferResult(VFS::WriteVector(context, sqe.fd, reinterpret_cast<const iovec *>(sqe.address), static_cast<int>(sqe.length)));
+
+			case URING_OP_IPC_SEND:
+			{
+				SyscallScopedMapping mapping(_task, sqe.address, sqe.length + sizeof(ipc_header_t));
+
+				KernReturn<ipc_header_t *> header = mapping.GetMemory<ipc_header_t>();
+				if(!header.IsValid())
+					return Error(KERN_INVALID_ADDRESS, EFAULT);
+
+				if(header->size > sqe.length)
+					return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+				IPC::Message *message = IPC::Message::Alloc()->Init(header);
+				if(!message)
+					return Error(KERN_NO_MEMORY, ENOMEM);
+
+				IPC::Space *space = _task->GetIPCSpace();
+
+				space->Lock();
+				KernReturn<void> result = space->Write(message);
+				space->Unlock();
+
+				message->Release();
+
+				if(!result.IsValid())
+					return result.GetError();
+
+				return 0;
+			}
+
+			default:
+				return Error(KERN_INVALID_ARGUMENT, EINVAL);
+		}
+	}
+
+	void Uring::PostCompletion(uint64_t userData, const KernReturn<uint32_t> &result)
+	{
+		uint32_t tail = _cqTail;
+		uring_cqe_t *cqe = _cqes + (tail & (_cqEntries - 1));
+
+		cqe->userData = userData;
+
+		if(result.IsValid())
+		{
+			cqe->result = result.Get();
+			cqe->error = 0;
+		}
+		else
+		{
+			cqe->result = static_cast<uint32_t>(-1);
+			cqe->error = result.GetError().GetErrno();
+		}
+
+		spinlock_lock(&_lock);
+		_cqTail = tail + 1;
+		__atomic_store_n(&_header->cqTail, _cqTail, __ATOMIC_RELEASE);
+		Wakeup(this);
+		spinlock_unlock(&_lock);
+	}
+
+	void Uring::Drain(void *context)
+	{
+		Uring *uring = reinterpret_cast<Uring *>(context);
+
+		while(1)
+		{
+			uring_sqe_t sqe;
+
+			while(uring->ConsumeSubmission(sqe))
+			{
+				KernReturn<uint32_t> result = uring->Execute(sqe);
+				uring->PostCompletion(sqe.userData, result);
+			}
+
+			// Submissions that came in while we were busy were only flagged as pending
+			spinlock_lock(&uring->_lock);
+
+			if(!uring->_pending)
+			{
+				uring->_scheduled = false;
+				spinlock_unlock(&uring->_lock);
+
+				break;
+			}
+
+			uring->_pending = false;
+			spinlock_unlock(&uring->_lock);
+		}
+
+		uring->_task->Release();
+		uring->Release();
+	}
+
+
+	KernReturn<uint32_t> Syscall_UringSetup(Thread *thread, UringSetupArgs *arguments)
+	{
+		Task *task = thread->GetTask();
+
+		Uring *uring = Uring::Alloc()->Init(task, arguments->entries);
+		if(!uring)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		uring_params_t params;
+		params.entries = static_cast<unsigned int>(uring->GetEntries());
+		params.size = static_cast<unsigned int>(uring->GetPages() * VM_PAGE_SIZE);
+
+		KernReturn<void> result = task->GetDirectory()->CopyUserDataIn(&params, reinterpret_cast<vm_address_t>(arguments->params), sizeof(uring_params_t));
+		if(!result.IsValid())
+		{
+			uring->Release();
+			return Error(KERN_INVALID_ADDRESS, EFAULT);
+		}
+
+		result = task->SetUring(uring);
+		uring->Release();
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return 0;
+	}
+
+	KernReturn<uint32_t> Syscall_UringEnter(Thread *thread, UringEnterArgs *arguments)
+	{
+		Uring *uring = thread->GetTask()->CopyUring();
+		if(!uring)
+			return Error(KERN_RESOURCE_NOT_FOUND, ENXIO);
+
+		if(arguments->toSubmit > 0)
+			uring->Submit();
+
+		if(arguments->flags & URING_ENTER_GETEVENTS && arguments->minComplete > 0)
+		{
+			KernReturn<void> result = uring->Wait(thread, arguments->minComplete);
+			if(!result.IsValid())
+			{
+				uring->Release();
+				return result.GetError();
+			}
+		}
+
+		uring->Release();
+		return 0;
+	}
+}
@@ -0,0 +1,98 @@
+//
+//  syscall_uring.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYSCALL_URING_H_
+#define _SYSCALL_URING_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libc/sys/spinlock.h>
+#include <libc/sys/uring.h>
+#include <kern/kern_return.h>
+#include <libio/core/IOObject.h>
+#include <machine/memory/memory.h>
+
+namespace OS
+{
+	class Task;
+	class Thread;
+
+	struct UringSetupArgs
+	{
+		uint32_t entries;
+		uring_params_t *params;
+	} __attribute__((packed));
+
+	struct UringEnterArgs
+	{
+		uint32_t toSubmit;
+		uint32_t minComplete;
+		int flags;
+	} __attribute__((packed));
+
+	// Submission and completion rings shared with a task. Userland queues operations
+	// and rings the doorbell through uring_enter(), the rings are drained by the kernel
+	// worker which posts a completion for every consumed submission. Submissions are
+	// only consumed while there is room for their completion
+	class Uring : public IO::Object
+	{
+	public:
+		Uring *Init(Task *task, size_t entries);
+		void Dealloc() override;
+
+		KernReturn<vm_address_t> MapIntoTask(Task *task);
+
+		void Submit();
+		KernReturn<void> Wait(Thread *thread, uint32_t minComplete);
+
+		size_t GetEntries() const { return _sqEntries; }
+		size_t GetPages() const { return _pages; }
+
+	private:
+		static void Drain(void *context);
+
+		bool ConsumeSubmission(uring_sqe_t &sqe);
+		KernReturn<uint32_t> Execute(const uring_sqe_t &sqe);
+		void PostCompletion(uint64_t userData, const KernReturn<uint32_t> &result);
+
+		uring_header_t *_header; // Kernel side mapping of the shared pages
+		uintptr_t _pmemory;
+		size_t _pages;
+
+		// Userland can rewrite the header at will, so the geometry and the indices
+		// the kernel owns are kept here and only published to the shared page
+		uring_sqe_t *_sqes;
+		uring_cqe_t *_cqes;
+		uint32_t _sqEntries;
+		uint32_t _cqEntries;
+		uint32_t _sqHead;
+		uint32_t _cqTail;
+
+		Task *_task; // Not retained, the task owns the ring
+		spinlock_t _lock;
+		bool _scheduled;
+		bool _pending;
+
+		IODeclareMeta(Uring)
+	};
+
+	KernReturn<uint32_t> Syscall_UringSetup(Thread *thread, UringSetupArgs *arguments);
+	KernReturn<uint32_t> Syscall_UringEnter(Thread *thread, UringEnterArgs *arguments);
+}
+
+#endif /* _SYSCALL_URING_H_ */
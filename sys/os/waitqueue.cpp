@@ -16,105 +16,47 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
-#include <libio/core/IOObject.h>
-#include <libio/core/IODictionary.h>
-#include <libcpp/vector.h>
+#include <libc/sys/spinlock.h>
+#include <libcpp/intrusive_list.h>
 #include <os/scheduler/scheduler.h>
 #include "waitqueue.h"
 
 namespace OS
 {
-	class WaitqueueLookup : public IO::Object
-	{
-	public:
-		WaitqueueLookup *Init(void *channel)
-		{
-			if(!IO::Object::Init())
-				return nullptr;
-
-			_channel = channel;
-
-			return this;
-		}
-
-		size_t GetHash() const override
-		{
-			return reinterpret_cast<size_t>(_channel);
-		}
-		bool IsEqual(IO::Object *other) const override
-		{
-			WaitqueueLookup *lookup = static_cast<WaitqueueLookup *>(other);
-			return (lookup->_channel == _channel);
-		}
-
-		void AddThread(Thread *thread)
-		{
-			_waiters.push_back(thread);
-		}
-		std::vector<Thread *>::iterator GetBegin()
-		{
-			return _waiters.begin();
-		}
-		std::vector<Thread *>::iterator GetEnd()
-		{
-			return _waiters.end();
-		}
-
-	private:
-		std::vector<Thread *> _waiters;
-		void *_channel;
-
-		IODeclareMeta(WaitqueueLookup)
-	};
+	// Channels hash into a fixed set of buckets, each with its own lock and an intrusive
+	// list threaded through the waiting threads, so waiting and waking never allocate
+	static constexpr size_t kWaitqueueBuckets = 256;
 
-	class WaitqueueEntry : public IO::Object
+	struct WaitqueueBucket
 	{
-	public:
-		WaitqueueEntry *Init()
-		{
-			if(!IO::Object::Init())
-				return nullptr;
-			return this;
-		}
+		spinlock_t lock;
+		std::intrusive_list<Thread> waiters;
+	};
 
-		void AddThread(Thread *thread)
-		{
-			_waiters.push_back(thread);
-		}
-		std::vector<Thread *>::iterator GetBegin()
-		{
-			return _waiters.begin();
-		}
-		std::vector<Thread *>::iterator GetEnd()
-		{
-			return _waiters.end();
-		}
+	static WaitqueueBucket _waitqueue[kWaitqueueBuckets];
 
-		Thread *PopAny()
-		{
-			std::vector<Thread *>::iterator last = _waiters.end() - 1;
+	static WaitqueueBucket *GetBucket(void *channel)
+	{
+		uintptr_t hash = reinterpret_cast<uintptr_t>(channel);
 
-			Thread *thread = *last;
-			_waiters.erase(last);
+		// Channels are mostly object pointers, the low bits carry little information
+		hash = (hash >> 4) ^ (hash >> 12);
+		return &_waitqueue[hash % kWaitqueueBuckets];
+	}
 
-			return thread;
-		}
-		bool IsEmpty() const
-		{
-			return (_waiters.size() == 0);
-		}
+	static void EnqueueThread(Thread *thread, void *channel)
+	{
+		WaitqueueBucket *bucket = GetBucket(channel);
 
-	private:
-		std::vector<Thread *> _waiters;
+		spinlock_lock(&bucket->lock);
 
-		IODeclareMeta(WaitqueueEntry)
-	};
+		Scheduler::GetScheduler()->BlockThread(thread);
 
-	IODefineMeta(WaitqueueLookup, IO::Object)
-	IODefineMeta(WaitqueueEntry, IO::Object)
+		thread->waitChannel = channel;
+		bucket->waiters.push_back(thread->waitEntry);
 
-	static IO::Dictionary *_waitqueue;
-	static spinlock_t _waitLock = SPINLOCK_INIT;
+		spinlock_unlock(&bucket->lock);
+	}
 
 
 	KernReturn<void> Wait(void *channel)
@@ -124,28 +66,12 @@ namespace OS
 
 	KernReturn<void> WaitWithCallback(void *channel, IO::Function<void ()> &&callback)
 	{
-		if(!Sys::CPU::GetCurrentCPU()->GetFlagsSet(Sys::CPU::Flags::WaitQueueEnabled))
-			return Error(KERN_RESOURCES_MISSING);
-
-		WaitqueueLookup *lookup = WaitqueueLookup::Alloc()->Init(channel);
-
-		spinlock_lock(&_waitLock);
-
-		WaitqueueEntry *entry = _waitqueue->GetObjectForKey<WaitqueueEntry>(lookup);
-		if(!entry)
-		{
-			entry = WaitqueueEntry::Alloc()->Init();
-			_waitqueue->SetObjectForKey(entry, lookup);
-		}
-
 		Thread *thread = Scheduler::GetScheduler()->GetActiveThread();
 
-		Scheduler::GetScheduler()->BlockThread(thread);
-		entry->AddThread(thread);
-
-		spinlock_unlock(&_waitLock);
+		if(!Sys::CPU::GetCurrentCPU()->GetFlagsSet(Sys::CPU::Flags::WaitQueueEnabled) || !thread->IsWaitEnabled())
+			return Error(KERN_RESOURCES_MISSING);
 
-		lookup->Release();
+		EnqueueThread(thread, channel);
 
 		callback();
 		Scheduler::GetScheduler()->RescheduleCPU(Sys::CPU::GetCurrentCPU()); // Make sure we don't return until Wakeup() is called
@@ -155,82 +81,106 @@ namespace OS
 
 	KernReturn<void> WaitThread(Thread *thread, void *channel)
 	{
-		IO::StrongRef<WaitqueueLookup> lookup(IOTransferRef(WaitqueueLookup::Alloc()->Init(channel)));
-
-		spinlock_lock(&_waitLock);
-
-		WaitqueueEntry *entry = _waitqueue->GetObjectForKey<WaitqueueEntry>(lookup);
-		if(!entry)
-		{
-			entry = WaitqueueEntry::Alloc()->Init();
-			_waitqueue->SetObjectForKey(entry, lookup);
-		}
-		
-		Scheduler::GetScheduler()->BlockThread(thread);
-		entry->AddThread(thread);
-
-		spinlock_unlock(&_waitLock);
-
+		EnqueueThread(thread, channel);
 		return ErrorNone;
 	}
 	
 	void Wakeup(void *channel)
 	{
-		IO::StrongRef<WaitqueueLookup> lookup(IOTransferRef(WaitqueueLookup::Alloc()->Init(channel)));
+		WaitqueueBucket *bucket = GetBucket(channel);
+		std::intrusive_list<Thread> woken;
 
-		spinlock_lock(&_waitLock);
+		spinlock_lock(&bucket->lock);
 
-		WaitqueueEntry *entry = _waitqueue->GetObjectForKey<WaitqueueEntry>(lookup);
-		if(!entry)
+		std::intrusive_list<Thread>::member *entry = bucket->waiters.head();
+		while(entry)
 		{
-			spinlock_unlock(&_waitLock);
-			return;
-		}
+			Thread *thread = entry->get();
+
+			if(thread->waitChannel == channel)
+			{
+				entry = bucket->waiters.erase(entry);
 
-		entry->Retain();
+				thread->waitChannel = nullptr;
+				woken.push_back(thread->waitEntry);
 
-		_waitqueue->RemoveObjectForKey(lookup);
-		spinlock_unlock(&_waitLock);
+				continue;
+			}
+
+			entry = entry->next();
+		}
+
+		spinlock_unlock(&bucket->lock);
 
 		// Unblock all threads waiting on the channel
-		std::vector<Thread *>::iterator iterator = entry->GetBegin();
-		while(iterator != entry->GetEnd())
+		// Once unblocked a thread may wait again and reuse its entry, so unlink it first
+		while(!woken.empty())
 		{
-			Thread *thread = *iterator;
-			Scheduler::GetScheduler()->UnblockThread(thread);
+			Thread *thread = woken.head()->get();
+			woken.erase(woken.head());
 
-			iterator ++;
+			Scheduler::GetScheduler()->UnblockThread(thread);
 		}
-
-		entry->Release();
 	}
 
 	void WakeupOne(void *channel)
 	{
-		IO::StrongRef<WaitqueueLookup> lookup(IOTransferRef(WaitqueueLookup::Alloc()->Init(channel)));
+		WaitqueueBucket *bucket = GetBucket(channel);
+		Thread *thread = nullptr;
 
-		spinlock_lock(&_waitLock);
+		spinlock_lock(&bucket->lock);
 
-		WaitqueueEntry *entry = _waitqueue->GetObjectForKey<WaitqueueEntry>(lookup);
-		if(!entry)
+		std::intrusive_list<Thread>::member *entry = bucket->waiters.head();
+		while(entry)
 		{
-			spinlock_unlock(&_waitLock);
-			return;
+			if(entry->get()->waitChannel == channel)
+			{
+				thread = entry->get();
+				thread->waitChannel = nullptr;
+
+				bucket->waiters.erase(entry);
+				break;
+			}
+
+			entry = entry->next();
 		}
 
-		Thread *thread = entry->PopAny();
+		spinlock_unlock(&bucket->lock);
 
-		if(entry->IsEmpty())
-			_waitqueue->RemoveObjectForKey(lookup);
+		if(thread)
+			Scheduler::GetScheduler()->UnblockThread(thread);
+	}
 
-		spinlock_unlock(&_waitLock);
+	void *CancelWait(Thread *thread)
+	{
+		void *channel = thread->waitChannel;
+		if(!channel)
+			return nullptr;
+
+		WaitqueueBucket *bucket = GetBucket(channel);
+
+		spinlock_lock(&bucket->lock);
 
-		Scheduler::GetScheduler()->UnblockThread(thread);
+		// A wakeup might have beaten us to the lock
+		if(thread->waitChannel != channel)
+		{
+			spinlock_unlock(&bucket->lock);
+			return nullptr;
+		}
+
+		bucket->waiters.erase(thread->waitEntry);
+		thread->waitChannel = nullptr;
+
+		spinlock_unlock(&bucket->lock);
+
+		return channel;
 	}
 
 	KernReturn<void> WaitqueueInit()
 	{
-		_waitqueue = IO::Dictionary::Alloc()->Init();
+		for(size_t i = 0; i < kWaitqueueBuckets; i ++)
+			spinlock_init(&_waitqueue[i].lock);
+
 		return ErrorNone;
 	}
 }
@@ -35,6 +35,8 @@ namespace OS
 	void Wakeup(void *channel);
 	void WakeupOne(void *channel);
 
+	void *CancelWait(Thread *thread); // Dequeues the thread without unblocking it, returns the channel it waited on
+
 	KernReturn<void> WaitqueueInit();
 }
 
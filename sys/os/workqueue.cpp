@@ -17,106 +17,156 @@
 //
 
 #include <kern/kprintf.h>
+#include <libcpp/algorithm.h>
+#include <machine/interrupts/interrupts.h>
 #include "workqueue.h"
 
 namespace OS
 {
 	WorkQueue::WorkQueue() :
-		_exhausted(false),
+		_exhausted(true),
+		_capacity(0),
+		_freeCount(0),
 		_freeListHead(nullptr),
-		_workListHead(nullptr)
+		_workListHead(nullptr),
+		_workListTail(nullptr)
 	{
 		spinlock_init(&_readWriterLock);
-		_ExtendFreeList(50);
+		Grow();
 	}
 
-	void WorkQueue::_ExtendFreeList(size_t size)
+	// Interrupt handlers push into the queue of their CPU, so the lock must never be held with interrupts enabled
+	bool WorkQueue::Lock()
 	{
+		bool enabled = Sys::DisableInterrupts();
+		spinlock_lock(&_readWriterLock);
+
+		return enabled;
+	}
+
+	void WorkQueue::Unlock(bool enabled)
+	{
+		spinlock_unlock(&_readWriterLock);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+	}
+
+	void WorkQueue::Grow()
+	{
+		// Doubles the capacity on every call
+		size_t size = std::max(kInitialEntries, _capacity);
+
+		if(_capacity + size > kMaxEntries)
+			size = kMaxEntries - _capacity;
+
+		if(size == 0)
+			return;
+
 		Entry *entries = new Entry[size];
+		if(!entries)
+			return;
+
+		for(size_t i = 0; i < size; i ++)
+		{
+			entries[i].owner = this;
+			entries[i].next = (i < size - 1) ? entries + i + 1 : nullptr;
+		}
+
+		bool enabled = Lock();
 
-		for(size_t i = 0; i < size - 1; i ++)
+		// Another worker beat us to it
+		if(!_exhausted || _capacity + size > kMaxEntries)
 		{
-			Entry *entry = entries + i;
-			Entry *next = entries + i + 1;
+			Unlock(enabled);
+			delete[] entries;
 
-			entry->next = next;
-			next->next = nullptr;
+			return;
 		}
 
-		RefurbishList(entries);
+		entries[size - 1].next = _freeListHead;
+		_freeListHead = entries;
+
+		_capacity += size;
+		_freeCount += size;
+		_exhausted = false;
+
+		Unlock(enabled);
+	}
+
+	void WorkQueue::AppendEntry(Entry *entry)
+	{
+		entry->next = nullptr;
+
+		if(_workListTail)
+			_workListTail->next = entry;
+		else
+			_workListHead = entry;
+
+		_workListTail = entry;
 	}
 
 	bool WorkQueue::PushEntry(Callback callback, void *context)
 	{
-		spinlock_lock(&_readWriterLock);
+		bool enabled = Lock();
 
 		Entry *entry = _freeListHead;
 		if(!entry)
 		{
-			spinlock_unlock(&_readWriterLock);
+			_exhausted = true;
+			Unlock(enabled);
+
 			return false;
 		}
 
 		_freeListHead = entry->next;
+		_freeCount --;
+
+		// Ask for more entries before actually running dry
+		if(_freeCount < _capacity / 4 && _capacity < kMaxEntries)
+			_exhausted = true;
 
 		entry->callback = callback;
 		entry->context = context;
 
-		entry->next = _workListHead;
-		_workListHead = entry;
+		AppendEntry(entry);
 
-		spinlock_unlock(&_readWriterLock);
+		Unlock(enabled);
 		return true;
 	}
 
-	WorkQueue::Entry *WorkQueue::PopAll()
+	void WorkQueue::PushEntry(Entry *entry)
 	{
-		Entry *entry = _workListHead;
-		_workListHead = nullptr;
+		bool enabled = Lock();
+		AppendEntry(entry);
+		Unlock(enabled);
+	}
+
+	WorkQueue::Entry *WorkQueue::PopEntry()
+	{
+		bool enabled = Lock();
 
-		// Pop All is not safe to call from an interrupt context
-		// Which means it is safe for us to extend the free list
-		if(_exhausted)
+		Entry *entry = _workListHead;
+		if(entry)
 		{
-			_ExtendFreeList(10);
-			_exhausted = false;
+			_workListHead = entry->next;
+
+			if(!_workListHead)
+				_workListTail = nullptr;
 		}
 
+		Unlock(enabled);
 		return entry;
 	}
 
-	WorkQueue::Entry *WorkQueue::PopAllRemote()
+	void WorkQueue::RefurbishEntry(Entry *entry)
 	{
-		spinlock_lock(&_readWriterLock);
-		Entry *result = PopAll();
-		spinlock_unlock(&_readWriterLock);
-
-		return result;
-	}
+		bool enabled = Lock();
 
-	void WorkQueue::RefurbishList(Entry *entry)
-	{
-		if(!entry->next)
-		{		
-			entry->next = _freeListHead;
-			_freeListHead = entry;
-		}
-		else
-		{
-			Entry *last = entry;
-			do {
-				last = last->next;
-			} while(last->next);
-			
-			last->next = _freeListHead;
-			_freeListHead = entry;
-		}
-	}
+		entry->next = _freeListHead;
+		_freeListHead = entry;
+		_freeCount ++;
 
-	void WorkQueue::RefurbishListRemote(Entry *entry)
-	{
-		spinlock_lock(&_readWriterLock);
-		RefurbishList(entry);
-		spinlock_unlock(&_readWriterLock);
+		Unlock(enabled);
 	}
 }
@@ -28,15 +28,14 @@ namespace OS
 	/**
 	 * The work queue class is supposed to be used from within an interrupt context
 	 * to communicate work to non-interrupt context kernel workers. They are per CPU
-	 * and writes and reads happen with interrupts disabled. However, reads from the work queue
-	 * from another CPU are additionally protected by a spin lock which is only taken
-	 * when reading from another CPUs work queue.
+	 * and the queue disables interrupts itself while it holds its lock, so it can
+	 * be used from any context. The kernel workers drain all queues
+	 * and hand the entries out one at a time, in the order they were pushed.
 	 *
-	 * Inserts into the list can fail and should be handled gracefully
-	 *
-	 * Accessing other CPUs work queues requires the usage of the xxxRemote methods and must
-	 * never be performed with the regular methods. Likewise, accessing the current CPUs work
-	 * queue must only be done via the non suffixed methods.
+	 * Inserts into the list can fail when the free list is exhausted. The queue can't
+	 * allocate in the interrupt context, instead it asks the workers to grow it via
+	 * NeedsGrowth() once it runs low. Failed inserts have to be handled gracefully,
+	 * callers that can't fail embed their own Entry and use the Entry based PushEntry().
 	 **/
 	class WorkQueue
 	{
@@ -44,28 +43,47 @@ namespace OS
 		typedef void (*Callback)(void *);
 		struct Entry
 		{
+			Entry() :
+				callback(nullptr),
+				context(nullptr),
+				next(nullptr),
+				owner(nullptr)
+			{}
+
 			Callback callback;
 			void *context;
 			Entry *next;
+			WorkQueue *owner; // Free list the entry returns to, nullptr if the entry is owned by the caller
 		};
 
+		static constexpr size_t kInitialEntries = 64;
+		static constexpr size_t kMaxEntries = 4096;
+
 		WorkQueue();
 
 		bool PushEntry(Callback callback, void *context);
+		void PushEntry(Entry *entry); // The entry must not be queued already
 
-		Entry *PopAll();
-		Entry *PopAllRemote();
+		Entry *PopEntry();
+		void RefurbishEntry(Entry *entry);
 
-		void RefurbishList(Entry *entry);
-		void RefurbishListRemote(Entry *entry);
+		bool HasWork() const { return (_workListHead != nullptr); }
+		bool NeedsGrowth() const { return _exhausted; }
+		void Grow(); // Must not be called from an interrupt context
 
 	private:
-		void _ExtendFreeList(size_t size);
+		bool Lock();
+		void Unlock(bool enabled);
+
+		void AppendEntry(Entry *entry);
 
 		spinlock_t _readWriterLock;
 		bool _exhausted;
+		size_t _capacity;
+		size_t _freeCount;
 		Entry *_freeListHead;
 		Entry *_workListHead;
+		Entry *_workListTail;
 	};
 }
 
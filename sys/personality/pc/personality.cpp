@@ -40,6 +40,7 @@ extern "C" init_array_func_t __init_array_end;
 #include <os/scheduler/scheduler.h>
 #include <os/syscall/syscall.h>
 #include <os/waitqueue.h>
+#include <os/locks/futex.h>
 #include <os/ipc/IPC.h>
 #include <os/linker/LDStore.h>
 #include <vfs/vfs.h>
@@ -154,6 +155,7 @@ namespace Sys
 		Init("clock", Sys::ClockInit);
 		Init("smp", Sys::SMPInit);
 		Init("waitqueue", OS::WaitqueueInit);
+		Init("futex", OS::FutexInit);
 		Init("ipc", OS::IPCInit);
 		Init("scheduler", OS::SchedulerInit);
 
@@ -0,0 +1,259 @@
+//
+//  ata.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/stdio.h>
+#include <libcpp/algorithm.h>
+#include <machine/port.h>
+#include <kern/kprintf.h>
+#include "ata.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		IODefineMeta(ATA, Device)
+
+		// Register offsets from the bus' I/O base
+		static constexpr uint16_t kATARegisterData = 0;
+		static constexpr uint16_t kATARegisterSectorCount = 2;
+		static constexpr uint16_t kATARegisterLBALow = 3;
+		static constexpr uint16_t kATARegisterLBAMid = 4;
+		static constexpr uint16_t kATARegisterLBAHigh = 5;
+		static constexpr uint16_t kATARegisterDrive = 6;
+		static constexpr uint16_t kATARegisterCommand = 7; // Reads as the status register
+
+		static constexpr uint8_t kATAStatusError = (1 << 0);
+		static constexpr uint8_t kATAStatusDataRequest = (1 << 3);
+		static constexpr uint8_t kATAStatusDeviceFault = (1 << 5);
+		static constexpr uint8_t kATAStatusBusy = (1 << 7);
+
+		static constexpr uint8_t kATACommandReadSectors = 0x20;
+		static constexpr uint8_t kATACommandWriteSectors = 0x30;
+		static constexpr uint8_t kATACommandFlushCache = 0xe7;
+		static constexpr uint8_t kATACommandIdentify = 0xec;
+
+		static constexpr uint8_t kATAControlNoInterrupts = (1 << 1);
+		static constexpr size_t kATAPollLimit = 10000000;
+
+		static ATA::Bus _buses[2] = {
+			{ 0x1f0, 0x3f6, SPINLOCK_INIT },
+			{ 0x170, 0x376, SPINLOCK_INIT }
+		};
+
+		// Reading the alternate status takes about 100ns, the drive needs 400ns after selection
+		static void ATADelay(ATA::Bus *bus)
+		{
+			for(int i = 0; i < 4; i ++)
+				inb(bus->control);
+		}
+
+		static KernReturn<void> ATAPoll(ATA::Bus *bus, bool drq)
+		{
+			for(size_t i = 0; i < kATAPollLimit; i ++)
+			{
+				uint8_t status = inb(bus->io + kATARegisterCommand);
+
+				if(status & kATAStatusBusy)
+					continue;
+
+				if(status & (kATAStatusError | kATAStatusDeviceFault))
+					return Error(KERN_FAILURE, EIO);
+
+				if(!drq || (status & kATAStatusDataRequest))
+					return ErrorNone;
+			}
+
+			return Error(KERN_TIMEOUT, EIO);
+		}
+
+
+		ATA *ATA::Init(const char *name, Bus *bus, bool slave, uint64_t sectors)
+		{
+			if(!Device::Init(name, kSectorSize, sectors))
+				return nullptr;
+
+			_bus = bus;
+			_slave = slave;
+
+			return this;
+		}
+
+		KernReturn<uint64_t> ATA::Identify(Bus *bus, bool slave)
+		{
+			// A floating bus reads all ones
+			if(inb(bus->io + kATARegisterCommand) == 0xff)
+				return Error(KERN_RESOURCES_MISSING, ENODEV);
+
+			outb(bus->control, kATAControlNoInterrupts);
+			outb(bus->io + kATARegisterDrive, 0xa0 | (slave << 4));
+			ATADelay(bus);
+
+			outb(bus->io + kATARegisterSectorCount, 0);
+			outb(bus->io + kATARegisterLBALow, 0);
+			outb(bus->io + kATARegisterLBAMid, 0);
+			outb(bus->io + kATARegisterLBAHigh, 0);
+			outb(bus->io + kATARegisterCommand, kATACommandIdentify);
+
+			if(inb(bus->io + kATARegisterCommand) == 0)
+				return Error(KERN_RESOURCES_MISSING, ENODEV);
+
+			for(size_t i = 0; i < kATAPollLimit; i ++)
+			{
+				if(!(inb(bus->io + kATARegisterCommand) & kATAStatusBusy))
+					break;
+			}
+
+			// ATAPI and SATA devices identify themselves through the LBA registers
+			if(inb(bus->io + kATARegisterLBAMid) != 0 || inb(bus->io + kATARegisterLBAHigh) != 0)
+				return Error(KERN_UNSUPPORTED, ENODEV);
+
+			KernReturn<void> result = ATAPoll(bus, true);
+			if(!result.IsValid())
+				return result.GetError();
+
+			uint16_t identity[256];
+
+			for(size_t i = 0; i < 256; i ++)
+				identity[i] = inw(bus->io + kATARegisterData);
+
+			uint64_t sectors = identity[60] | (static_cast<uint32_t>(identity[61]) << 16);
+			if(sectors == 0)
+				return Error(KERN_UNSUPPORTED, ENODEV);
+
+			return sectors;
+		}
+
+		void ATA::Probe()
+		{
+			int index = 0;
+
+			for(size_t i = 0; i < 2; i ++)
+			{
+				for(int slave = 0; slave < 2; slave ++)
+				{
+					Bus *bus = &_buses[i];
+
+					spinlock_lock(&bus->lock);
+					KernReturn<uint64_t> sectors = Identify(bus, slave);
+					spinlock_unlock(&bus->lock);
+
+					if(!sectors.IsValid())
+						continue;
+
+					char name[16];
+					sprintf(name, "ata%d", index ++);
+
+					ATA *disk = ATA::Alloc()->Init(name, bus, slave, sectors);
+					if(disk)
+					{
+						RegisterDevice(disk);
+						disk->Release();
+					}
+				}
+			}
+		}
+
+
+		// Bus lock must be held
+		void ATA::Select(uint64_t lba)
+		{
+			outb(_bus->io + kATARegisterDrive, 0xe0 | (_slave << 4) | ((lba >> 24) & 0x0f));
+			ATADelay(_bus);
+		}
+
+		KernReturn<void> ATA::Transfer(uint64_t block, size_t count, uint8_t *data, bool write)
+		{
+			KernReturn<void> result = CheckRange(block, count);
+			if(!result.IsValid())
+				return result;
+
+			spinlock_lock(&_bus->lock);
+
+			while(count > 0)
+			{
+				size_t sectors = std::min(count, kMaxSectorsPerCommand);
+
+				Select(block);
+
+				result = ATAPoll(_bus, false);
+				if(!result.IsValid())
+					break;
+
+				outb(_bus->io + kATARegisterSectorCount, static_cast<uint8_t>(sectors)); // 0 means 256
+				outb(_bus->io + kATARegisterLBALow, block & 0xff);
+				outb(_bus->io + kATARegisterLBAMid, (block >> 8) & 0xff);
+				outb(_bus->io + kATARegisterLBAHigh, (block >> 16) & 0xff);
+				outb(_bus->io + kATARegisterCommand, write ? kATACommandWriteSectors : kATACommandReadSectors);
+
+				for(size_t i = 0; i < sectors; i ++)
+				{
+					result = ATAPoll(_bus, true);
+					if(!result.IsValid())
+						break;
+
+					uint16_t *words = reinterpret_cast<uint16_t *>(data);
+
+					for(size_t j = 0; j < kSectorSize / 2; j ++)
+					{
+						if(write)
+							outw(_bus->io + kATARegisterData, words[j]);
+						else
+							words[j] = inw(_bus->io + kATARegisterData);
+					}
+
+					data += kSectorSize;
+				}
+
+				if(!result.IsValid())
+					break;
+
+				block += sectors;
+				count -= sectors;
+			}
+
+			if(result.IsValid() && write)
+				result = ATAPoll(_bus, false);
+
+			spinlock_unlock(&_bus->lock);
+			return result;
+		}
+
+		KernReturn<void> ATA::ReadBlocks(uint64_t block, size_t count, void *data)
+		{
+			return Transfer(block, count, static_cast<uint8_t *>(data), false);
+		}
+
+		KernReturn<void> ATA::WriteBlocks(uint64_t block, size_t count, const void *data)
+		{
+			return Transfer(block, count, const_cast<uint8_t *>(static_cast<const uint8_t *>(data)), true);
+		}
+
+		KernReturn<void> ATA::Flush()
+		{
+			spinlock_lock(&_bus->lock);
+
+			Select(0);
+			outb(_bus->io + kATARegisterCommand, kATACommandFlushCache);
+
+			KernReturn<void> result = ATAPoll(_bus, false);
+			spinlock_unlock(&_bus->lock);
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+//
+//  ata.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_BLOCK_ATA_H_
+#define _VFS_BLOCK_ATA_H_
+
+#include <prefix.h>
+#include <libc/sys/spinlock.h>
+#include "block_device.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		// Polling PIO driver for the legacy IDE controller, as emulated by QEMU and Bochs.
+		// Only LBA28 is used, which limits disks to 128 GiB
+		class ATA : public Device
+		{
+		public:
+			struct Bus
+			{
+				uint16_t io;
+				uint16_t control;
+				spinlock_t lock; // Both drives of a bus share its registers
+			};
+
+			static void Probe();
+
+			KernReturn<void> ReadBlocks(uint64_t block, size_t count, void *data) override;
+			KernReturn<void> WriteBlocks(uint64_t block, size_t count, const void *data) override;
+			KernReturn<void> Flush() override;
+
+		private:
+			static constexpr size_t kSectorSize = 512;
+			static constexpr size_t kMaxSectorsPerCommand = 256;
+
+			ATA *Init(const char *name, Bus *bus, bool slave, uint64_t sectors);
+
+			void Select(uint64_t lba);
+			KernReturn<void> Transfer(uint64_t block, size_t count, uint8_t *data, bool write);
+
+			static KernReturn<uint64_t> Identify(Bus *bus, bool slave);
+
+			Bus *_bus;
+			bool _slave;
+
+			IODeclareMeta(ATA)
+		};
+	}
+}
+
+#endif /* _VFS_BLOCK_ATA_H_ */
@@ -0,0 +1,117 @@
+//
+//  block_device.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libc/sys/spinlock.h>
+#include <libio/core/IOArray.h>
+#include <kern/kprintf.h>
+#include "block_device.h"
+#include "ram_disk.h"
+#include "ata.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		IODefineMetaVirtual(Device, IO::Object)
+
+		static constexpr size_t kRamDiskPages = 512;
+
+		static spinlock_t _deviceLock = SPINLOCK_INIT;
+		static IO::Array *_devices;
+
+		Device *Device::Init(const char *name, size_t blockSize, uint64_t blockCount)
+		{
+			if(!IO::Object::Init())
+				return nullptr;
+
+			_name = IO::String::Alloc()->InitWithCString(name);
+			_blockSize = blockSize;
+			_blockCount = blockCount;
+
+			return this;
+		}
+
+		void Device::Dealloc()
+		{
+			IO::SafeRelease(_name);
+			IO::Object::Dealloc();
+		}
+
+		KernReturn<void> Device::Flush()
+		{
+			return ErrorNone;
+		}
+
+		KernReturn<void> Device::CheckRange(uint64_t block, size_t count) const
+		{
+			if(count == 0 || block >= _blockCount || count > _blockCount - block)
+				return Error(KERN_INVALID_ARGUMENT, ENXIO);
+
+			return ErrorNone;
+		}
+
+
+		void RegisterDevice(Device *device)
+		{
+			spinlock_lock(&_deviceLock);
+			_devices->AddObject(device);
+			spinlock_unlock(&_deviceLock);
+
+			kprintf("Block device %s, %u blocks of %u bytes\n", device->GetName(), static_cast<uint32_t>(device->GetBlockCount()), static_cast<uint32_t>(device->GetBlockSize()));
+		}
+
+		IO::StrongRef<Device> GetDevice(const char *name)
+		{
+			IO::StrongRef<Device> result;
+
+			spinlock_lock(&_deviceLock);
+
+			_devices->Enumerate<Device>([&](Device *device, __unused size_t index, bool &stop) {
+
+				if(strcmp(device->GetName(), name) == 0)
+				{
+					result = device;
+					stop = true;
+				}
+
+			});
+
+			spinlock_unlock(&_deviceLock);
+
+			return result;
+		}
+
+		KernReturn<void> Init()
+		{
+			_devices = IO::Array::Alloc()->Init();
+			if(!_devices)
+				return Error(KERN_NO_MEMORY);
+
+			RamDisk *disk = RamDisk::Alloc()->Init("ram0", kRamDiskPages);
+			if(disk)
+			{
+				RegisterDevice(disk);
+				disk->Release();
+			}
+
+			ATA::Probe();
+			return ErrorNone;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+//
+//  block_device.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_BLOCK_DEVICE_H_
+#define _VFS_BLOCK_DEVICE_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <kern/kern_return.h>
+#include <libio/core/IOObject.h>
+#include <libio/core/IOString.h>
+
+namespace VFS
+{
+	namespace Block
+	{
+		// A device addressed in fixed size blocks. Transfers always cover whole blocks
+		// and go to and from kernel memory, file systems put a buffer cache in front
+		class Device : public IO::Object
+		{
+		public:
+			const char *GetName() const { return _name->GetCString(); }
+			size_t GetBlockSize() const { return _blockSize; }
+			uint64_t GetBlockCount() const { return _blockCount; }
+
+			virtual KernReturn<void> ReadBlocks(uint64_t block, size_t count, void *data) = 0;
+			virtual KernReturn<void> WriteBlocks(uint64_t block, size_t count, const void *data) = 0;
+			virtual KernReturn<void> Flush(); // Forces written blocks out of volatile device caches
+
+		protected:
+			Device *Init(const char *name, size_t blockSize, uint64_t blockCount);
+			void Dealloc() override;
+
+			KernReturn<void> CheckRange(uint64_t block, size_t count) const;
+
+		private:
+			IO::String *_name;
+			size_t _blockSize;
+			uint64_t _blockCount;
+
+			IODeclareMetaVirtual(Device)
+		};
+
+		void RegisterDevice(Device *device);
+		IO::StrongRef<Device> GetDevice(const char *name);
+
+		// Creates the RAM disk and probes the ATA buses
+		KernReturn<void> Init();
+	}
+}
+
+#endif /* _VFS_BLOCK_DEVICE_H_ */
@@ -0,0 +1,274 @@
+//
+//  buffer_cache.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <kern/kalloc.h>
+#include <machine/memory/memory.h>
+#include "buffer_cache.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		IODefineMeta(BufferCache, IO::Object)
+
+		BufferCache *BufferCache::Init(Device *device, size_t blockSize, size_t capacity)
+		{
+			if(!IO::Object::Init())
+				return nullptr;
+
+			_device = nullptr;
+			_buffers = nullptr;
+			_memory = nullptr;
+
+			if(blockSize == 0 || (blockSize % device->GetBlockSize()) != 0)
+			{
+				Release();
+				return nullptr;
+			}
+
+			spinlock_init(&_lock);
+
+			_device = device->Retain();
+			_blockSize = blockSize;
+			_deviceBlocks = blockSize / device->GetBlockSize();
+			_blockCount = device->GetBlockCount() / _deviceBlocks;
+			_capacity = capacity;
+			_clock = 0;
+
+			_memoryPages = VM_PAGE_COUNT(capacity * blockSize);
+			_memory = Sys::Alloc<uint8_t>(Sys::VM::Directory::GetKernelDirectory(), _memoryPages, kVMFlagsKernel);
+			_buffers = static_cast<Buffer *>(kalloc(capacity * sizeof(Buffer)));
+
+			if(!_memory || !_buffers)
+			{
+				Release();
+				return nullptr;
+			}
+
+			for(size_t i = 0; i < capacity; i ++)
+			{
+				Buffer *buffer = _buffers + i;
+
+				buffer->block = 0;
+				buffer->data = _memory + i * blockSize;
+				buffer->lastUse = 0;
+				buffer->valid = false;
+				buffer->dirty = false;
+				buffer->hashNext = nullptr;
+			}
+
+			for(size_t i = 0; i < kBufferHashSize; i ++)
+				_hash[i] = nullptr;
+
+			return this;
+		}
+
+		void BufferCache::Dealloc()
+		{
+			if(_device && _buffers && _memory)
+				Sync().Suppress();
+
+			if(_memory)
+				Sys::Free(_memory, Sys::VM::Directory::GetKernelDirectory(), _memoryPages);
+			if(_buffers)
+				kfree(_buffers);
+
+			IO::SafeRelease(_device);
+			IO::Object::Dealloc();
+		}
+
+
+		// Lock must be held
+		void BufferCache::Unhash(Buffer *buffer)
+		{
+			Buffer **link = &_hash[buffer->block % kBufferHashSize];
+
+			while(*link)
+			{
+				if(*link == buffer)
+				{
+					*link = buffer->hashNext;
+					break;
+				}
+
+				link = &(*link)->hashNext;
+			}
+
+			buffer->hashNext = nullptr;
+			buffer->valid = false;
+		}
+
+		// Lock must be held
+		KernReturn<void> BufferCache::WriteBuffer(Buffer *buffer)
+		{
+			KernReturn<void> result = _device->WriteBlocks(buffer->block * _deviceBlocks, _deviceBlocks, buffer->data);
+			if(result.IsValid())
+				buffer->dirty = false;
+
+			return result;
+		}
+
+		// Lock must be held. Without fill the content of a newly cached block is undefined
+		KernReturn<BufferCache::Buffer *> BufferCache::GetBuffer(uint64_t block, bool fill)
+		{
+			if(block >= _blockCount)
+				return Error(KERN_INVALID_ARGUMENT, ENXIO);
+
+			for(Buffer *buffer = _hash[block % kBufferHashSize]; buffer; buffer = buffer->hashNext)
+			{
+				if(buffer->block == block)
+				{
+					buffer->lastUse = ++ _clock;
+					return buffer;
+				}
+			}
+
+			// Recycle the least recently used buffer
+			Buffer *victim = _buffers;
+
+			for(size_t i = 0; i < _capacity; i ++)
+			{
+				Buffer *buffer = _buffers + i;
+
+				if(!buffer->valid)
+				{
+					victim = buffer;
+					break;
+				}
+
+				if(buffer->lastUse < victim->lastUse)
+					victim = buffer;
+			}
+
+			if(victim->valid)
+			{
+				if(victim->dirty)
+				{
+					KernReturn<void> result = WriteBuffer(victim);
+					if(!result.IsValid())
+						return result.GetError();
+				}
+
+				Unhash(victim);
+			}
+
+			if(fill)
+			{
+				KernReturn<void> result = _device->ReadBlocks(block * _deviceBlocks, _deviceBlocks, victim->data);
+				if(!result.IsValid())
+					return result.GetError();
+			}
+
+			victim->block = block;
+			victim->valid = true;
+			victim->dirty = false;
+			victim->lastUse = ++ _clock;
+			victim->hashNext = _hash[block % kBufferHashSize];
+
+			_hash[block % kBufferHashSize] = victim;
+
+			return victim;
+		}
+
+
+		KernReturn<void> BufferCache::Read(uint64_t block, size_t offset, void *data, size_t length)
+		{
+			if(offset > _blockSize || length > _blockSize - offset)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			spinlock_lock(&_lock);
+
+			KernReturn<Buffer *> buffer = GetBuffer(block, true);
+			if(!buffer.IsValid())
+			{
+				spinlock_unlock(&_lock);
+				return buffer.GetError();
+			}
+
+			memcpy(data, buffer->data + offset, length);
+			spinlock_unlock(&_lock);
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> BufferCache::Write(uint64_t block, size_t offset, const void *data, size_t length)
+		{
+			if(offset > _blockSize || length > _blockSize - offset)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			spinlock_lock(&_lock);
+
+			// Overwriting the whole block doesn't need its old content
+			KernReturn<Buffer *> buffer = GetBuffer(block, (length != _blockSize));
+			if(!buffer.IsValid())
+			{
+				spinlock_unlock(&_lock);
+				return buffer.GetError();
+			}
+
+			memcpy(buffer->data + offset, data, length);
+			buffer->dirty = true;
+
+			spinlock_unlock(&_lock);
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> BufferCache::Zero(uint64_t block)
+		{
+			spinlock_lock(&_lock);
+
+			KernReturn<Buffer *> buffer = GetBuffer(block, false);
+			if(!buffer.IsValid())
+			{
+				spinlock_unlock(&_lock);
+				return buffer.GetError();
+			}
+
+			memset(buffer->data, 0, _blockSize);
+			buffer->dirty = true;
+
+			spinlock_unlock(&_lock);
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> BufferCache::Sync()
+		{
+			KernReturn<void> result;
+
+			spinlock_lock(&_lock);
+
+			for(size_t i = 0; i < _capacity && result.IsValid(); i ++)
+			{
+				Buffer *buffer = _buffers + i;
+
+				if(buffer->valid && buffer->dirty)
+					result = WriteBuffer(buffer);
+			}
+
+			if(result.IsValid())
+				result = _device->Flush();
+
+			spinlock_unlock(&_lock);
+
+			return result;
+		}
+	}
+}
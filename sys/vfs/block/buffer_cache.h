@@ -0,0 +1,92 @@
+//
+//  buffer_cache.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_BLOCK_BUFFER_CACHE_H_
+#define _VFS_BLOCK_BUFFER_CACHE_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <libc/sys/spinlock.h>
+#include <kern/kern_return.h>
+#include <libio/core/IOObject.h>
+#include "block_device.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		// Write back cache of file system blocks in front of a device. File system blocks are
+		// a multiple of the device's block size, the least recently used clean or dirty buffer
+		// is recycled on a miss. Transfers hold the cache lock, including the device I/O
+		class BufferCache : public IO::Object
+		{
+		public:
+			BufferCache *Init(Device *device, size_t blockSize, size_t capacity);
+
+			// Transfer a range within a single block
+			KernReturn<void> Read(uint64_t block, size_t offset, void *data, size_t length);
+			KernReturn<void> Write(uint64_t block, size_t offset, const void *data, size_t length);
+			KernReturn<void> Zero(uint64_t block);
+
+			// Writes all dirty buffers and flushes the device
+			KernReturn<void> Sync();
+
+			size_t GetBlockSize() const { return _blockSize; }
+			uint64_t GetBlockCount() const { return _blockCount; }
+
+		protected:
+			void Dealloc() override;
+
+		private:
+			struct Buffer
+			{
+				uint64_t block;
+				uint8_t *data;
+				uint64_t lastUse;
+				bool valid;
+				bool dirty;
+				Buffer *hashNext;
+			};
+
+			static constexpr size_t kBufferHashSize = 64;
+
+			KernReturn<Buffer *> GetBuffer(uint64_t block, bool fill);
+			KernReturn<void> WriteBuffer(Buffer *buffer);
+			void Unhash(Buffer *buffer);
+
+			Device *_device;
+			size_t _blockSize;
+			uint64_t _blockCount;
+			size_t _deviceBlocks; // Device blocks per file system block
+
+			Buffer *_buffers;
+			size_t _capacity;
+			uint8_t *_memory;
+			size_t _memoryPages;
+			uint64_t _clock;
+
+			Buffer *_hash[kBufferHashSize];
+			spinlock_t _lock;
+
+			IODeclareMeta(BufferCache)
+		};
+	}
+}
+
+#endif /* _VFS_BLOCK_BUFFER_CACHE_H_ */
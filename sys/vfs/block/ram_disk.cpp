@@ -0,0 +1,80 @@
+//
+//  ram_disk.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <machine/memory/memory.h>
+#include "ram_disk.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		IODefineMeta(RamDisk, Device)
+
+		RamDisk *RamDisk::Init(const char *name, size_t pages)
+		{
+			if(!Device::Init(name, kRamDiskBlockSize, (pages * VM_PAGE_SIZE) / kRamDiskBlockSize))
+				return nullptr;
+
+			spinlock_init(&_lock);
+
+			_pages = pages;
+			_memory = Sys::Alloc<uint8_t>(Sys::VM::Directory::GetKernelDirectory(), pages, kVMFlagsKernel);
+
+			if(!_memory)
+				return nullptr;
+
+			memset(_memory, 0, pages * VM_PAGE_SIZE);
+			return this;
+		}
+
+		void RamDisk::Dealloc()
+		{
+			if(_memory)
+				Sys::Free(_memory, Sys::VM::Directory::GetKernelDirectory(), _pages);
+
+			Device::Dealloc();
+		}
+
+		KernReturn<void> RamDisk::ReadBlocks(uint64_t block, size_t count, void *data)
+		{
+			KernReturn<void> result = CheckRange(block, count);
+			if(!result.IsValid())
+				return result;
+
+			spinlock_lock(&_lock);
+			memcpy(data, _memory + block * kRamDiskBlockSize, count * kRamDiskBlockSize);
+			spinlock_unlock(&_lock);
+
+			return ErrorNone;
+		}
+
+		KernReturn<void> RamDisk::WriteBlocks(uint64_t block, size_t count, const void *data)
+		{
+			KernReturn<void> result = CheckRange(block, count);
+			if(!result.IsValid())
+				return result;
+
+			spinlock_lock(&_lock);
+			memcpy(_memory + block * kRamDiskBlockSize, data, count * kRamDiskBlockSize);
+			spinlock_unlock(&_lock);
+
+			return ErrorNone;
+		}
+	}
+}
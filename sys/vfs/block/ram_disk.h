@@ -0,0 +1,54 @@
+//
+//  ram_disk.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_BLOCK_RAM_DISK_H_
+#define _VFS_BLOCK_RAM_DISK_H_
+
+#include <prefix.h>
+#include <libc/sys/spinlock.h>
+#include "block_device.h"
+
+namespace VFS
+{
+	namespace Block
+	{
+		// Block device backed by wired kernel memory, starts out zeroed
+		class RamDisk : public Device
+		{
+		public:
+			RamDisk *Init(const char *name, size_t pages);
+
+			KernReturn<void> ReadBlocks(uint64_t block, size_t count, void *data) override;
+			KernReturn<void> WriteBlocks(uint64_t block, size_t count, const void *data) override;
+
+		protected:
+			void Dealloc() override;
+
+		private:
+			static constexpr size_t kRamDiskBlockSize = 512;
+
+			uint8_t *_memory;
+			size_t _pages;
+			spinlock_t _lock;
+
+			IODeclareMeta(RamDisk)
+		};
+	}
+}
+
+#endif /* _VFS_BLOCK_RAM_DISK_H_ */
@@ -89,9 +89,9 @@ namespace CFS
 	{
 		VFS::Directory *directory = static_cast<VFS::Directory *>(tnode);
 
-		directory->Lock();
+		directory->LockShared();
 		IO::StrongRef<VFS::Node> node = directory->FindNode(name);
-		directory->Unlock();
+		directory->UnlockShared();
 
 		if(!node)
 			return Error(KERN_RESOURCES_MISSING);
@@ -162,7 +162,7 @@ namespace CFS
 	KernReturn<off_t> Instance::FileSeek(__unused VFS::Context *context, VFS::File *file, off_t offset, int whence)
 	{
 		CFS::Node *node = static_cast<CFS::Node *>(file->GetNode());
-		node->Lock();
+		node->LockShared();
 
 		size_t toffset = 0;
 
@@ -179,7 +179,7 @@ namespace CFS
 				break;
 
 			default:
-				node->Unlock();
+				node->UnlockShared();
 				return Error(KERN_INVALID_ARGUMENT);
 		}
 
@@ -189,12 +189,12 @@ namespace CFS
 		if(toffset <= node->GetSize())
 		{
 			file->SetOffset(toffset);
-			node->Unlock();
+			node->UnlockShared();
 
 			return static_cast<off_t>(toffset);
 		}
 
-		node->Unlock();
+		node->UnlockShared();
 		return Error(KERN_INVALID_ARGUMENT);
 	}
 
@@ -208,7 +208,7 @@ namespace CFS
 	{
 		VFS::FileDirectory *directory = static_cast<VFS::FileDirectory *>(file);
 		CFS::Node *node = static_cast<CFS::Node *>(file->GetNode());
-		node->Lock();
+		node->LockShared();
 
 		const struct dirent *entries = directory->GetEntries() + directory->GetOffset();
 		size_t left = directory->GetCount() - directory->GetOffset();
@@ -221,7 +221,7 @@ namespace CFS
 			KernReturn<void> result = context->CopyDataIn(entries, entry, count * sizeof(struct dirent));
 			if(!result.IsValid())
 			{
-				node->Unlock();
+				node->UnlockShared();
 				return result.GetError();
 			}
 
@@ -229,7 +229,7 @@ namespace CFS
 			read = count;
 		}
 
-		node->Unlock();
+		node->UnlockShared();
 		return read;
 	}
 
@@ -16,8 +16,8 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
-#ifndef _FFS_NODE_H_
-#define _FFS_NODE_H_
+#ifndef _CFS_NODE_H_
+#define _CFS_NODE_H_
 
 #include <prefix.h>
 #include <vfs/node.h>
@@ -82,4 +82,4 @@ namespace CFS
 	};
 }
 
-#endif /* _FFS_NODE_H_ */
+#endif /* _CFS_NODE_H_ */
@@ -96,35 +96,13 @@ namespace VFS
 		if(!data || !target || length == 0)
 			return Error(KERN_INVALID_ARGUMENT);
 
-		Sys::VM::Directory *kernelDir = Sys::VM::Directory::GetKernelDirectory();
-		if(_directory == kernelDir)
+		if(_directory == Sys::VM::Directory::GetKernelDirectory())
 		{
 			memcpy(target, data, length);
 			return ErrorNone;
 		}
-		else
-		{
-			vm_address_t temp = reinterpret_cast<vm_address_t>(data);
-			vm_address_t page = VM_PAGE_ALIGN_DOWN(temp);
-
-			size_t pages  = VM_PAGE_COUNT(length);
-			size_t offset = temp - page; 
-
-			KernReturn<uintptr_t> physical;
-
-			if((physical = _directory->ResolveAddress(page)).IsValid() == false)
-				return physical.GetError();
-			
-			KernReturn<vm_address_t> mapping;
 
-			if((mapping = kernelDir->Alloc(physical, pages, kVMFlagsKernel)).IsValid() == false)
-				return mapping.GetError();
-
-			memcpy(target, reinterpret_cast<void *>(mapping + offset), length);
-			kernelDir->Free(mapping, pages);
-		}
-
-		return ErrorNone;
+		return _directory->CopyDataOut(reinterpret_cast<vm_address_t>(data), target, length);
 	}
 
 	KernReturn<void> Context::CopyDataIn(const void *data, void *target, size_t length)
@@ -132,35 +110,13 @@ namespace VFS
 		if(!data || !target || length == 0)
 			return Error(KERN_INVALID_ARGUMENT);
 
-		Sys::VM::Directory *kernelDir = Sys::VM::Directory::GetKernelDirectory();
-		if(_directory == kernelDir)
+		if(_directory == Sys::VM::Directory::GetKernelDirectory())
 		{
 			memcpy(target, data, length);
 			return ErrorNone;
 		}
-		else
-		{
-			vm_address_t temp = reinterpret_cast<vm_address_t>(target);
-			vm_address_t page = VM_PAGE_ALIGN_DOWN(temp);
-
-			size_t pages  = VM_PAGE_COUNT(length);
-			size_t offset = temp - page; 
-
-			KernReturn<uintptr_t> physical;
-
-			if((physical = _directory->ResolveAddress(page)).IsValid() == false)
-				return physical.GetError();
-			
-			KernReturn<vm_address_t> mapping;
 
-			if((mapping = kernelDir->Alloc(physical, pages, kVMFlagsKernel)).IsValid() == false)
-				return mapping.GetError();
-
-			memcpy(reinterpret_cast<void *>(mapping + offset), data, length);
-			kernelDir->Free(mapping, pages);
-		}
-
-		return ErrorNone;
+		return _directory->CopyDataIn(data, reinterpret_cast<vm_address_t>(target), length);
 	}
 
 
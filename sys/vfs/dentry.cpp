@@ -0,0 +1,259 @@
+//
+//  dentry.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libc/sys/spinlock.h>
+#include <libcpp/atomic.h>
+#include <os/locks/epoch.h>
+#include "dentry.h"
+#include "node.h"
+
+namespace VFS
+{
+	static constexpr size_t kDentryBuckets = 256;
+	static constexpr size_t kDentryWays = 4;
+	static constexpr size_t kDentryNameLength = 32; // Longer names are looked up but not cached
+
+	struct DentrySlot
+	{
+		Directory *parent; // Not retained, directories purge their slots when they go away
+		Node *node; // Retained, nullptr for a negative entry
+		uint32_t hash;
+		uint32_t length;
+		char name[kDentryNameLength];
+	};
+
+	// Writers hold the lock and keep the sequence odd while modifying slots,
+	// readers retry until they saw the same even sequence before and after the scan
+	struct DentryBucket
+	{
+		spinlock_t lock;
+		std::atomic<uint32_t> sequence;
+		uint32_t victim;
+		DentrySlot slots[kDentryWays];
+	};
+
+	static DentryBucket _dentries[kDentryBuckets];
+
+	// Writers synchronize on the epoch before releasing a node they unlinked, so a reader never retains a freed node
+	static OS::Epoch _epoch;
+
+
+	DentryName::DentryName(const char *tname, size_t tlength) :
+		name(tname),
+		length(tlength),
+		hash(2166136261u)
+	{
+		for(size_t i = 0; i < length; i ++)
+		{
+			hash ^= static_cast<uint8_t>(name[i]);
+			hash *= 16777619u;
+		}
+	}
+
+	static DentryBucket *GetBucket(Directory *parent, uint32_t hash)
+	{
+		uint32_t index = hash ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(parent) >> 4);
+		return &_dentries[index % kDentryBuckets];
+	}
+
+	static bool SlotMatches(const DentrySlot *slot, Directory *parent, const DentryName &name)
+	{
+		return (slot->parent == parent && slot->hash == name.hash && slot->length == name.length && strncmp(slot->name, name.name, name.length) == 0);
+	}
+
+	static void ReleaseNodes(Node **nodes, size_t count)
+	{
+		if(count == 0)
+			return;
+
+		_epoch.Synchronize();
+
+		for(size_t i = 0; i < count; i ++)
+			nodes[i]->Release();
+	}
+
+	// Bucket lock must be held
+	static void BeginWrite(DentryBucket *bucket)
+	{
+		bucket->sequence.fetch_add(1, std::memory_order_acq_rel);
+	}
+	static void EndWrite(DentryBucket *bucket)
+	{
+		bucket->sequence.fetch_add(1, std::memory_order_release);
+	}
+
+
+	bool DentryLookup(Directory *parent, const DentryName &name, IO::StrongRef<Node> &result, uint32_t &sequence)
+	{
+		DentryBucket *bucket = GetBucket(parent, name.hash);
+
+		uint32_t epoch = _epoch.Enter();
+
+		bool found;
+		Node *node;
+
+		while(1)
+		{
+			sequence = bucket->sequence.load(std::memory_order_acquire);
+
+			if(sequence & 1)
+			{
+				__asm__ volatile("pause");
+				continue;
+			}
+
+			found = false;
+			node = nullptr;
+
+			for(size_t i = 0; i < kDentryWays; i ++)
+			{
+				const DentrySlot *slot = &bucket->slots[i];
+
+				if(SlotMatches(slot, parent, name))
+				{
+					found = true;
+					node = slot->node;
+					break;
+				}
+			}
+
+			if(bucket->sequence.load(std::memory_order_acquire) == sequence)
+				break;
+		}
+
+		if(found)
+			result = node; // Retains while the epoch still holds off writers
+
+		_epoch.Exit(epoch);
+		return found;
+	}
+
+	void DentryInsert(Directory *parent, const DentryName &name, Node *node, uint32_t sequence)
+	{
+		if(name.length > kDentryNameLength)
+			return;
+
+		DentryBucket *bucket = GetBucket(parent, name.hash);
+		Node *evicted = nullptr;
+
+		spinlock_lock(&bucket->lock);
+
+		// Anything that changed the bucket since the lookup may have been an invalidation of this name
+		if(bucket->sequence.load(std::memory_order_relaxed) != sequence)
+		{
+			spinlock_unlock(&bucket->lock);
+			return;
+		}
+
+		DentrySlot *slot = nullptr;
+
+		for(size_t i = 0; i < kDentryWays; i ++)
+		{
+			if(!bucket->slots[i].parent)
+			{
+				slot = &bucket->slots[i];
+				break;
+			}
+		}
+
+		if(!slot)
+		{
+			slot = &bucket->slots[bucket->victim];
+			bucket->victim = (bucket->victim + 1) % kDentryWays;
+		}
+
+		BeginWrite(bucket);
+
+		evicted = slot->node;
+
+		slot->parent = parent;
+		slot->node = node ? node->Retain() : nullptr;
+		slot->hash = name.hash;
+		slot->length = static_cast<uint32_t>(name.length);
+		memcpy(slot->name, name.name, name.length);
+
+		EndWrite(bucket);
+		spinlock_unlock(&bucket->lock);
+
+		ReleaseNodes(&evicted, evicted ? 1 : 0);
+	}
+
+	void DentryInvalidate(Directory *parent, const char *tname)
+	{
+		DentryName name(tname, strlen(tname));
+		DentryBucket *bucket = GetBucket(parent, name.hash);
+
+		Node *evicted = nullptr;
+
+		spinlock_lock(&bucket->lock);
+		BeginWrite(bucket); // Also fails racing inserts of a miss
+
+		for(size_t i = 0; i < kDentryWays; i ++)
+		{
+			DentrySlot *slot = &bucket->slots[i];
+
+			if(SlotMatches(slot, parent, name))
+			{
+				evicted = slot->node;
+
+				slot->parent = nullptr;
+				slot->node = nullptr;
+				break;
+			}
+		}
+
+		EndWrite(bucket);
+		spinlock_unlock(&bucket->lock);
+
+		ReleaseNodes(&evicted, evicted ? 1 : 0);
+	}
+
+	void DentryPurge(Directory *parent)
+	{
+		for(size_t i = 0; i < kDentryBuckets; i ++)
+		{
+			DentryBucket *bucket = &_dentries[i];
+
+			Node *evicted[kDentryWays];
+			size_t count = 0;
+
+			spinlock_lock(&bucket->lock);
+			BeginWrite(bucket);
+
+			for(size_t j = 0; j < kDentryWays; j ++)
+			{
+				DentrySlot *slot = &bucket->slots[j];
+
+				if(slot->parent == parent)
+				{
+					if(slot->node)
+						evicted[count ++] = slot->node;
+
+					slot->parent = nullptr;
+					slot->node = nullptr;
+				}
+			}
+
+			EndWrite(bucket);
+			spinlock_unlock(&bucket->lock);
+
+			ReleaseNodes(evicted, count);
+		}
+	}
+}
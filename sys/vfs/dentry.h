@@ -0,0 +1,52 @@
+//
+//  dentry.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_DENTRY_H_
+#define _VFS_DENTRY_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <libio/core/IOObject.h>
+
+namespace VFS
+{
+	class Node;
+	class Directory;
+
+	// Global cache of (parent, name) -> node lookups, including lookups that found nothing.
+	// Hits are served without locks or allocations, directories invalidate entries as their children change
+	struct DentryName
+	{
+		DentryName(const char *name, size_t length);
+
+		const char *name;
+		size_t length;
+		uint32_t hash;
+	};
+
+	// Returns true on a hit, result is nullptr for a cached miss.
+	// On a miss, sequence receives a token that has to be passed to DentryInsert()
+	bool DentryLookup(Directory *parent, const DentryName &name, IO::StrongRef<Node> &result, uint32_t &sequence);
+	void DentryInsert(Directory *parent, const DentryName &name, Node *node, uint32_t sequence); // node may be nullptr
+
+	void DentryInvalidate(Directory *parent, const char *name);
+	void DentryPurge(Directory *parent); // Drops all entries of the directory
+}
+
+#endif /* _VFS_DENTRY_H_ */
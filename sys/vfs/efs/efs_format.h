@@ -0,0 +1,93 @@
+//
+//  efs_format.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _EFS_FORMAT_H_
+#define _EFS_FORMAT_H_
+
+#include <prefix.h>
+#include <libc/stdint.h>
+#include <libc/stddef.h>
+
+// On-disk layout of the extent file system. Block 0 holds the superblock, followed by the
+// block allocation bitmap, the inode table and the data blocks. Files are described by up
+// to kInodeExtents runs of contiguous blocks, directories are files of fixed size entries.
+// All values are little endian
+
+namespace EFS
+{
+	static constexpr uint32_t kSuperblockMagic = 0x53464645; // 'EFFS'
+	static constexpr uint32_t kVersion = 1;
+
+	static constexpr size_t kBlockSize = 4096;
+	static constexpr size_t kInodeSize = 128;
+	static constexpr size_t kInodesPerBlock = kBlockSize / kInodeSize;
+	static constexpr size_t kInodeExtents = 12;
+	static constexpr size_t kNameLength = 58;
+
+	static constexpr uint32_t kRootInode = 1; // Inode 0 is never used, it marks free directory entries
+
+	struct Superblock
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t blockSize;
+		uint32_t blockCount;
+		uint32_t inodeCount;
+		uint32_t bitmapStart;
+		uint32_t bitmapBlocks;
+		uint32_t inodeStart;
+		uint32_t inodeBlocks;
+		uint32_t dataStart;
+	} __attribute__((packed));
+
+	enum class InodeType : uint16_t
+	{
+		Free,
+		File,
+		Directory
+	};
+
+	struct Extent
+	{
+		uint32_t start;
+		uint32_t length;
+	} __attribute__((packed));
+
+	struct Inode
+	{
+		InodeType type;
+		uint16_t extentCount;
+		uint32_t reserved;
+		uint64_t size;
+		Extent extents[kInodeExtents];
+		uint8_t padding[16];
+	} __attribute__((packed));
+
+	struct DirectoryEntry
+	{
+		uint32_t inode;
+		uint8_t type; // InodeType of the entry
+		uint8_t nameLength;
+		char name[kNameLength];
+	} __attribute__((packed));
+
+	static_assert(sizeof(Inode) == kInodeSize, "Inodes must fill the inode table exactly");
+	static_assert(sizeof(DirectoryEntry) == 64, "Directory entries must not straddle blocks");
+}
+
+#endif /* _EFS_FORMAT_H_ */
@@ -0,0 +1,943 @@
+//
+//  efs_instance.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libcpp/algorithm.h>
+#include <kern/kalloc.h>
+#include <kern/kprintf.h>
+#include <machine/memory/memory.h>
+#include <vfs/file.h>
+#include <vfs/context.h>
+#include "efs_instance.h"
+#include "efs_node.h"
+
+namespace EFS
+{
+	IODefineMeta(Instance, VFS::Instance)
+
+	static constexpr size_t kBounceSize = 512; // File data is staged on the stack between the cache and the context
+	static constexpr uint8_t _zeroes[kBounceSize] = { 0 };
+
+	static uint32_t GetBlockCount(uint64_t size)
+	{
+		return static_cast<uint32_t>((size + kBlockSize - 1) / kBlockSize);
+	}
+
+	bool Instance::IsFormatted(VFS::Block::Device *device)
+	{
+		size_t size = device->GetBlockSize();
+		if(size < sizeof(Superblock))
+			return false;
+
+		uint8_t *buffer = static_cast<uint8_t *>(kalloc(size));
+		if(!buffer)
+			return false;
+
+		Superblock superblock;
+		KernReturn<void> result = device->ReadBlocks(0, 1, buffer);
+
+		memcpy(&superblock, buffer, sizeof(Superblock));
+		kfree(buffer);
+
+		if(!result.IsValid())
+			return false;
+
+		return (superblock.magic == kSuperblockMagic && superblock.version == kVersion && superblock.blockSize == kBlockSize);
+	}
+
+	KernReturn<void> Instance::Format(VFS::Block::Device *device)
+	{
+		VFS::Block::BufferCache *cache = VFS::Block::BufferCache::Alloc()->Init(device, kBlockSize, kBufferCacheCapacity);
+		if(!cache)
+			return Error(KERN_NO_MEMORY);
+
+		uint32_t blocks = static_cast<uint32_t>(std::min<uint64_t>(cache->GetBlockCount(), UINT32_MAX));
+		uint32_t inodes = std::max<uint32_t>(blocks / 8, kInodesPerBlock);
+
+		Superblock superblock;
+
+		superblock.magic = kSuperblockMagic;
+		superblock.version = kVersion;
+		superblock.blockSize = kBlockSize;
+		superblock.blockCount = blocks;
+		superblock.inodeCount = (inodes + kInodesPerBlock - 1) & ~(kInodesPerBlock - 1);
+		superblock.bitmapStart = 1;
+		superblock.bitmapBlocks = (blocks + (kBlockSize * 8) - 1) / (kBlockSize * 8);
+		superblock.inodeStart = superblock.bitmapStart + superblock.bitmapBlocks;
+		superblock.inodeBlocks = superblock.inodeCount / kInodesPerBlock;
+		superblock.dataStart = superblock.inodeStart + superblock.inodeBlocks;
+
+		if(superblock.dataStart >= blocks)
+		{
+			cache->Release();
+			return Error(KERN_RESOURCE_EXHAUSTED, ENOSPC);
+		}
+
+		KernReturn<void> result;
+
+		// Metadata starts out zeroed, which leaves every inode free
+		for(uint32_t i = 0; i < superblock.dataStart && result.IsValid(); i ++)
+			result = cache->Zero(i);
+
+		if(result.IsValid())
+			result = cache->Write(0, 0, &superblock, sizeof(Superblock));
+
+		for(uint32_t i = 0; i < superblock.dataStart && result.IsValid(); i ++)
+		{
+			uint32_t byte = i / 8;
+			uint8_t bits;
+
+			result = cache->Read(superblock.bitmapStart + byte / kBlockSize, byte % kBlockSize, &bits, 1);
+			if(!result.IsValid())
+				break;
+
+			bits |= (1 << (i % 8));
+			result = cache->Write(superblock.bitmapStart + byte / kBlockSize, byte % kBlockSize, &bits, 1);
+		}
+
+		if(result.IsValid())
+		{
+			Inode root;
+			memset(&root, 0, sizeof(Inode));
+
+			root.type = InodeType::Directory;
+			result = cache->Write(superblock.inodeStart + kRootInode / kInodesPerBlock, (kRootInode % kInodesPerBlock) * kInodeSize, &root, sizeof(Inode));
+		}
+
+		if(result.IsValid())
+			result = cache->Sync();
+
+		cache->Release();
+		return result;
+	}
+
+
+	Instance *Instance::Init(VFS::Block::Device *device)
+	{
+		_cache = nullptr;
+		_bitmap = nullptr;
+		_claimed = nullptr;
+		_nextFree = 0;
+
+		_cache = VFS::Block::BufferCache::Alloc()->Init(device, kBlockSize, kBufferCacheCapacity);
+		if(!_cache)
+		{
+			Release();
+			return nullptr;
+		}
+
+		if(!_cache->Read(0, 0, &_superblock, sizeof(Superblock)).IsValid())
+		{
+			Release();
+			return nullptr;
+		}
+
+		if(_superblock.magic != kSuperblockMagic || _superblock.version != kVersion || _superblock.blockSize != kBlockSize)
+		{
+			Release();
+			return nullptr;
+		}
+
+		if(_superblock.blockCount > _cache->GetBlockCount() || _superblock.dataStart >= _superblock.blockCount)
+		{
+			kprintf("EFS: Superblock of %s doesn't fit the device\n", device->GetName());
+			Release();
+			return nullptr;
+		}
+
+		// The layout is trusted from here on, the bitmap has to cover every block and the inode table has to hold every inode
+		bool bitmapFits = (static_cast<uint64_t>(_superblock.bitmapBlocks) * kBlockSize * 8 >= _superblock.blockCount);
+		bool inodesFit = (static_cast<uint64_t>(_superblock.inodeCount) <= static_cast<uint64_t>(_superblock.inodeBlocks) * kInodesPerBlock);
+		bool inodesEndAtData = (static_cast<uint64_t>(_superblock.inodeStart) + _superblock.inodeBlocks == _superblock.dataStart);
+
+		if(!bitmapFits || !inodesFit || !inodesEndAtData)
+		{
+			kprintf("EFS: Superblock of %s has an inconsistent layout\n", device->GetName());
+			Release();
+			return nullptr;
+		}
+
+		_nextFree = _superblock.dataStart;
+		_bitmapPages = VM_PAGE_COUNT(_superblock.bitmapBlocks * kBlockSize);
+		_bitmap = Sys::Alloc<uint8_t>(Sys::VM::Directory::GetKernelDirectory(), _bitmapPages, kVMFlagsKernel);
+
+		if(!_bitmap)
+		{
+			Release();
+			return nullptr;
+		}
+
+		for(uint32_t i = 0; i < _superblock.bitmapBlocks; i ++)
+		{
+			if(!_cache->Read(_superblock.bitmapStart + i, 0, _bitmap + i * kBlockSize, kBlockSize).IsValid())
+			{
+				Release();
+				return nullptr;
+			}
+		}
+
+		_claimedPages = VM_PAGE_COUNT((_superblock.inodeCount + 7) / 8);
+		_claimed = Sys::Alloc<uint8_t>(Sys::VM::Directory::GetKernelDirectory(), _claimedPages, kVMFlagsKernel);
+
+		if(!_claimed)
+		{
+			Release();
+			return nullptr;
+		}
+
+		memset(_claimed, 0, _claimedPages * VM_PAGE_SIZE);
+
+		Inode inode;
+
+		if(!LoadInode(kRootInode, inode).IsValid() || inode.type != InodeType::Directory)
+		{
+			kprintf("EFS: Root directory of %s is corrupt\n", device->GetName());
+			Release();
+			return nullptr;
+		}
+
+		// The instance lock isn't set up before VFS::Instance::Init()
+		_claimed[kRootInode / 8] |= (1 << (kRootInode % 8));
+
+		Directory *root = Directory::Alloc()->Init("", this, kRootInode, inode);
+		if(!root)
+		{
+			Release();
+			return nullptr;
+		}
+
+		if(!VFS::Instance::Init(root))
+		{
+			root->Release();
+			Release();
+			return nullptr;
+		}
+
+		root->Release();
+		return this;
+	}
+
+	void Instance::Dealloc()
+	{
+		if(_cache)
+		{
+			Sync().Suppress();
+			_cache->Release();
+		}
+
+		if(_bitmap)
+			Sys::Free(_bitmap, Sys::VM::Directory::GetKernelDirectory(), _bitmapPages);
+		if(_claimed)
+			Sys::Free(_claimed, Sys::VM::Directory::GetKernelDirectory(), _claimedPages);
+
+		VFS::Instance::Dealloc();
+	}
+
+	KernReturn<void> Instance::Sync()
+	{
+		return _cache->Sync();
+	}
+
+
+	// MARK: -
+	// MARK: Block allocation
+
+	void Instance::MarkBlocks(uint32_t start, uint32_t length, bool used)
+	{
+		for(uint32_t i = start; i < start + length; i ++)
+		{
+			if(used)
+				_bitmap[i / 8] |= (1 << (i % 8));
+			else
+				_bitmap[i / 8] &= ~(1 << (i % 8));
+		}
+
+		// Write the touched bytes through, split at bitmap block boundaries
+		uint32_t first = start / 8;
+		uint32_t last = (start + length - 1) / 8;
+
+		while(first <= last)
+		{
+			uint32_t offset = first % kBlockSize;
+			uint32_t count = std::min<uint32_t>(last - first + 1, kBlockSize - offset);
+
+			KernReturn<void> result = _cache->Write(_superblock.bitmapStart + first / kBlockSize, offset, _bitmap + first, count);
+			if(!result.IsValid())
+				kprintf("EFS: Failed to update the allocation bitmap\n");
+
+			first += count;
+		}
+	}
+
+	KernReturn<Extent> Instance::AllocateBlocks(uint32_t hint, uint32_t count)
+	{
+		auto isFree = [&](uint32_t block) -> bool {
+			return !(_bitmap[block / 8] & (1 << (block % 8)));
+		};
+
+		uint32_t start = 0;
+
+		if(hint >= _superblock.dataStart && hint < _superblock.blockCount && isFree(hint))
+		{
+			start = hint;
+		}
+		else
+		{
+			// Next fit, starting where the last allocation left off
+			uint32_t range = _superblock.blockCount - _superblock.dataStart;
+
+			for(uint32_t i = 0; i < range; i ++)
+			{
+				uint32_t block = _superblock.dataStart + ((_nextFree - _superblock.dataStart + i) % range);
+
+				if(isFree(block))
+				{
+					start = block;
+					break;
+				}
+			}
+
+			if(start == 0)
+				return Error(KERN_RESOURCE_EXHAUSTED, ENOSPC);
+		}
+
+		uint32_t length = 1;
+
+		while(length < count && start + length < _superblock.blockCount && isFree(start + length))
+			length ++;
+
+		MarkBlocks(start, length, true);
+		_nextFree = start + length;
+
+		if(_nextFree >= _superblock.blockCount)
+			_nextFree = _superblock.dataStart;
+
+		Extent extent;
+		extent.start = start;
+		extent.length = length;
+
+		return extent;
+	}
+
+	void Instance::FreeBlocks(uint32_t start, uint32_t length)
+	{
+		if(length > 0)
+			MarkBlocks(start, length, false);
+	}
+
+
+	// MARK: -
+	// MARK: Inodes
+
+	KernReturn<void> Instance::LoadInode(uint32_t number, Inode &inode)
+	{
+		if(number == 0 || number >= _superblock.inodeCount)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		return _cache->Read(_superblock.inodeStart + number / kInodesPerBlock, (number % kInodesPerBlock) * kInodeSize, &inode, sizeof(Inode));
+	}
+
+	KernReturn<void> Instance::StoreInode(uint32_t number, const Inode &inode)
+	{
+		if(number == 0 || number >= _superblock.inodeCount)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		return _cache->Write(_superblock.inodeStart + number / kInodesPerBlock, (number % kInodesPerBlock) * kInodeSize, &inode, sizeof(Inode));
+	}
+
+	bool Instance::ClaimInode(uint32_t number)
+	{
+		if(number == 0 || number >= _superblock.inodeCount)
+			return false;
+
+		Lock();
+
+		bool claimed = (_claimed[number / 8] & (1 << (number % 8)));
+		_claimed[number / 8] |= (1 << (number % 8));
+
+		Unlock();
+		return !claimed;
+	}
+
+	void Instance::UnclaimInode(uint32_t number)
+	{
+		if(number == 0 || number >= _superblock.inodeCount)
+			return;
+
+		Lock();
+		_claimed[number / 8] &= ~(1 << (number % 8));
+		Unlock();
+	}
+
+	KernReturn<uint32_t> Instance::AllocateInode(InodeType type)
+	{
+		Lock();
+
+		for(uint32_t i = kRootInode + 1; i < _superblock.inodeCount; i ++)
+		{
+			Inode inode;
+
+			KernReturn<void> result = LoadInode(i, inode);
+			if(!result.IsValid())
+			{
+				Unlock();
+				return result.GetError();
+			}
+
+			if(inode.type != InodeType::Free)
+				continue;
+
+			memset(&inode, 0, sizeof(Inode));
+			inode.type = type;
+
+			result = StoreInode(i, inode);
+			Unlock();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			return i;
+		}
+
+		Unlock();
+		return Error(KERN_RESOURCE_EXHAUSTED, ENOSPC);
+	}
+
+	uint32_t Instance::MapBlock(const Inode &inode, uint32_t index) const
+	{
+		for(uint16_t i = 0; i < inode.extentCount; i ++)
+		{
+			if(index < inode.extents[i].length)
+				return inode.extents[i].start + index;
+
+			index -= inode.extents[i].length;
+		}
+
+		return 0;
+	}
+
+	// Grows the inode to at least count blocks, new blocks are zeroed
+	KernReturn<void> Instance::ReserveBlocks(Inode &inode, uint32_t count)
+	{
+		uint32_t reserved = 0;
+
+		for(uint16_t i = 0; i < inode.extentCount; i ++)
+			reserved += inode.extents[i].length;
+
+		while(reserved < count)
+		{
+			Extent *last = (inode.extentCount > 0) ? &inode.extents[inode.extentCount - 1] : nullptr;
+			uint32_t hint = last ? (last->start + last->length) : 0;
+
+			Lock();
+
+			KernReturn<Extent> allocation = AllocateBlocks(hint, count - reserved);
+			if(!allocation.IsValid())
+			{
+				Unlock();
+				return allocation.GetError();
+			}
+
+			Extent extent = allocation.Get();
+			bool extends = (last && extent.start == hint);
+
+			if(!extends && inode.extentCount == kInodeExtents)
+			{
+				FreeBlocks(extent.start, extent.length);
+				Unlock();
+
+				return Error(KERN_RESOURCE_EXHAUSTED, EFBIG);
+			}
+
+			Unlock();
+
+			if(extends)
+				last->length += extent.length;
+			else
+				inode.extents[inode.extentCount ++] = extent;
+
+			for(uint32_t i = 0; i < extent.length; i ++)
+			{
+				KernReturn<void> result = _cache->Zero(extent.start + i);
+				if(!result.IsValid())
+					return result;
+			}
+
+			reserved += extent.length;
+		}
+
+		return ErrorNone;
+	}
+
+	KernReturn<size_t> Instance::ReadInode(VFS::Context *context, const Inode &inode, off_t offset, void *data, size_t size)
+	{
+		if(offset < 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		if(static_cast<uint64_t>(offset) >= inode.size)
+			return 0;
+
+		size = std::min<uint64_t>(size, inode.size - offset);
+
+		uint8_t bounce[kBounceSize];
+		uint8_t *buffer = static_cast<uint8_t *>(data);
+		size_t total = 0;
+
+		while(total < size)
+		{
+			uint64_t position = offset + total;
+			size_t blockOffset = position % kBlockSize;
+			size_t chunk = std::min(std::min(size - total, kBlockSize - blockOffset), kBounceSize);
+
+			uint32_t block = MapBlock(inode, position / kBlockSize);
+			KernReturn<void> result;
+
+			if(block)
+				result = _cache->Read(block, blockOffset, bounce, chunk);
+			else
+				memset(bounce, 0, chunk);
+
+			if(result.IsValid())
+				result = context->CopyDataIn(bounce, buffer + total, chunk);
+
+			if(!result.IsValid())
+			{
+				if(total > 0)
+					break;
+
+				return result.GetError();
+			}
+
+			total += chunk;
+		}
+
+		return total;
+	}
+
+	KernReturn<size_t> Instance::WriteInode(VFS::Context *context, uint32_t number, Inode &inode, off_t offset, const void *data, size_t size)
+	{
+		if(offset < 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		uint64_t end = offset + size;
+		if(end / kBlockSize >= UINT32_MAX)
+			return Error(KERN_INVALID_ARGUMENT, EFBIG);
+
+		KernReturn<void> result = ReserveBlocks(inode, GetBlockCount(end));
+		if(!result.IsValid())
+		{
+			StoreInode(number, inode).Suppress(); // Keep the blocks that were reserved
+			return result.GetError();
+		}
+
+		uint8_t bounce[kBounceSize];
+		const uint8_t *buffer = static_cast<const uint8_t *>(data);
+		size_t total = 0;
+
+		while(total < size)
+		{
+			uint64_t position = offset + total;
+			size_t blockOffset = position % kBlockSize;
+			size_t chunk = std::min(std::min(size - total, kBlockSize - blockOffset), kBounceSize);
+
+			result = context->CopyDataOut(buffer + total, bounce, chunk);
+
+			if(result.IsValid())
+				result = _cache->Write(MapBlock(inode, position / kBlockSize), blockOffset, bounce, chunk);
+
+			if(!result.IsValid())
+				break;
+
+			total += chunk;
+		}
+
+		if(static_cast<uint64_t>(offset + total) > inode.size)
+			inode.size = offset + total;
+
+		KernReturn<void> stored = StoreInode(number, inode);
+
+		if(total == 0 && !result.IsValid())
+			return result.GetError();
+		if(!stored.IsValid())
+			return stored.GetError();
+
+		return total;
+	}
+
+	KernReturn<void> Instance::ResizeInode(uint32_t number, Inode &inode, uint64_t size)
+	{
+		if(size > inode.size)
+		{
+			if(size / kBlockSize >= UINT32_MAX)
+				return Error(KERN_INVALID_ARGUMENT, EFBIG);
+
+			KernReturn<void> result = ReserveBlocks(inode, GetBlockCount(size));
+			if(!result.IsValid())
+				return result;
+		}
+		else if(size < inode.size)
+		{
+			// Clear the tail of the last block, growing the file again has to read zeros
+			uint32_t block = MapBlock(inode, size / kBlockSize);
+
+			for(size_t offset = size % kBlockSize; block && offset > 0 && offset < kBlockSize;)
+			{
+				size_t chunk = std::min(kBlockSize - offset, kBounceSize);
+
+				KernReturn<void> result = _cache->Write(block, offset, _zeroes, chunk);
+				if(!result.IsValid())
+					return result;
+
+				offset += chunk;
+			}
+
+			// Release the extents past the new end
+			uint32_t keep = GetBlockCount(size);
+			uint32_t position = 0;
+			uint16_t count = 0;
+
+			Lock();
+
+			for(uint16_t i = 0; i < inode.extentCount; i ++)
+			{
+				Extent &extent = inode.extents[i];
+
+				if(position >= keep)
+				{
+					FreeBlocks(extent.start, extent.length);
+					position += extent.length;
+
+					extent.start = 0;
+					extent.length = 0;
+					continue;
+				}
+
+				if(position + extent.length > keep)
+				{
+					uint32_t kept = keep - position;
+					FreeBlocks(extent.start + kept, extent.length - kept);
+
+					position += extent.length;
+					extent.length = kept;
+				}
+				else
+				{
+					position += extent.length;
+				}
+
+				count = i + 1;
+			}
+
+			Unlock();
+
+			inode.extentCount = count;
+		}
+
+		inode.size = size;
+		return StoreInode(number, inode);
+	}
+
+
+	// MARK: -
+	// MARK: VFS interface
+
+	KernReturn<VFS::Node *> Instance::CreateNode(VFS::Node *parent, const char *name, InodeType type)
+	{
+		Directory *directory = parent ? parent->Downcast<Directory>() : nullptr;
+		if(!directory)
+			return Error(KERN_INVALID_ARGUMENT, ENOTDIR);
+
+		if(strlen(name) > kNameLength)
+			return Error(KERN_INVALID_ARGUMENT, ENAMETOOLONG);
+
+		KernReturn<uint32_t> number = AllocateInode(type);
+		if(!number.IsValid())
+			return number.GetError();
+
+		// A corrupt directory entry may already point at the freshly allocated inode
+		if(!ClaimInode(number))
+			return Error(KERN_RESOURCE_EXISTS, EEXIST);
+
+		Inode inode;
+		memset(&inode, 0, sizeof(Inode));
+		inode.type = type;
+
+		VFS::Node *node;
+
+		if(type == InodeType::Directory)
+			node = Directory::Alloc()->Init(name, this, number, inode);
+		else
+			node = Node::Alloc()->Init(name, this, number, inode);
+
+		KernReturn<void> result;
+
+		if(!node)
+			result = Error(KERN_NO_MEMORY);
+
+		if(result.IsValid())
+		{
+			directory->Lock();
+
+			result = directory->Populate();
+
+			if(result.IsValid() && directory->FindNode(name))
+				result = Error(KERN_RESOURCE_EXISTS, EEXIST);
+
+			if(result.IsValid())
+				result = directory->AddEntry(name, number, type);
+			if(result.IsValid())
+				result = directory->AttachNode(node);
+
+			directory->Unlock();
+		}
+
+		if(!result.IsValid())
+		{
+			inode.type = InodeType::Free;
+			StoreInode(number, inode).Suppress();
+			UnclaimInode(number);
+
+			IO::SafeRelease(node);
+			return result.GetError();
+		}
+
+		Sync().Suppress();
+		return node;
+	}
+
+	KernReturn<VFS::Node *> Instance::CreateFile(__unused VFS::Context *context, VFS::Node *parent, const char *name)
+	{
+		return CreateNode(parent, name, InodeType::File);
+	}
+
+	KernReturn<VFS::Node *> Instance::CreateDirectory(__unused VFS::Context *context, VFS::Node *parent, const char *name)
+	{
+		return CreateNode(parent, name, InodeType::Directory);
+	}
+
+	KernReturn<void> Instance::DeleteNode(__unused VFS::Context *context, __unused VFS::Node *node)
+	{
+		return Error(KERN_UNSUPPORTED);
+	}
+
+
+	KernReturn<IO::StrongRef<VFS::Node>> Instance::LookUpNode(__unused VFS::Context *context, __unused uint64_t id)
+	{
+		return Error(KERN_RESOURCES_MISSING);
+	}
+	KernReturn<IO::StrongRef<VFS::Node>> Instance::LookUpNode(__unused VFS::Context *context, VFS::Node *tnode, const char *name)
+	{
+		Directory *directory = tnode->Downcast<Directory>();
+		if(!directory)
+			return Error(KERN_INVALID_ARGUMENT, ENOTDIR);
+
+		directory->LockShared();
+
+		if(directory->IsPopulated())
+		{
+			IO::StrongRef<VFS::Node> node = directory->FindNode(name);
+			directory->UnlockShared();
+
+			if(!node)
+				return Error(KERN_RESOURCES_MISSING);
+
+			return node;
+		}
+
+		directory->UnlockShared();
+
+		// First lookup, reading the entries in needs the exclusive lock
+		directory->Lock();
+
+		KernReturn<void> result = directory->Populate();
+		IO::StrongRef<VFS::Node> node = result.IsValid() ? directory->FindNode(name) : nullptr;
+
+		directory->Unlock();
+
+		if(!result.IsValid())
+			return result.GetError();
+		if(!node)
+			return Error(KERN_RESOURCES_MISSING);
+
+		return node;
+	}
+
+
+	KernReturn<VFS::File *> Instance::OpenFile(__unused VFS::Context *context, VFS::Node *tnode, int flags)
+	{
+		if(tnode->IsFile())
+		{
+			VFS::File *file = VFS::File::Alloc()->Init(tnode, flags);
+			if(!file)
+				return Error(KERN_NO_MEMORY);
+
+			if(flags & O_TRUNC)
+			{
+				tnode->Lock();
+				tnode->SetSize(0);
+				tnode->Unlock();
+
+				Sync().Suppress();
+			}
+
+			return file;
+		}
+
+		if(tnode->IsDirectory())
+		{
+			Directory *directory = tnode->Downcast<Directory>();
+
+			directory->Lock();
+			KernReturn<void> result = directory->Populate();
+			directory->Unlock();
+
+			if(!result.IsValid())
+				return result.GetError();
+
+			VFS::File *file = VFS::FileDirectory::Alloc()->Init(tnode, flags);
+			if(!file)
+				return Error(KERN_NO_MEMORY);
+
+			return file;
+		}
+
+		return Error(KERN_FAILURE);
+	}
+
+	void Instance::CloseFile(__unused VFS::Context *context, VFS::File *file)
+	{
+		file->Release();
+	}
+
+
+	KernReturn<size_t> Instance::FileRead(VFS::Context *context, VFS::Node *tnode, off_t offset, void *data, size_t size)
+	{
+		Node *node = tnode->Downcast<Node>();
+
+		node->LockShared();
+		KernReturn<size_t> result = ReadInode(context, node->GetInode(), offset, data, size);
+		node->UnlockShared();
+
+		return result;
+	}
+	KernReturn<size_t> Instance::FileWrite(VFS::Context *context, VFS::Node *tnode, off_t offset, const void *data, size_t size)
+	{
+		Node *node = tnode->Downcast<Node>();
+
+		node->Lock();
+
+		KernReturn<size_t> result = WriteInode(context, node->GetInodeNumber(), node->GetInode(), offset, data, size);
+		node->UpdateSize();
+
+		node->Unlock();
+
+		return result;
+	}
+	KernReturn<off_t> Instance::FileSeek(__unused VFS::Context *context, VFS::File *file, off_t offset, int whence)
+	{
+		VFS::Node *node = file->GetNode();
+		node->LockShared();
+
+		size_t toffset = 0;
+
+		switch(whence)
+		{
+			case SEEK_SET:
+				toffset = offset;
+				break;
+			case SEEK_CUR:
+				toffset = file->GetOffset() + offset;
+				break;
+			case SEEK_END:
+				toffset = node->GetSize() + offset;
+				break;
+
+			default:
+				node->UnlockShared();
+				return Error(KERN_INVALID_ARGUMENT);
+		}
+
+		if(toffset <= node->GetSize())
+		{
+			file->SetOffset(toffset);
+			node->UnlockShared();
+
+			return static_cast<off_t>(toffset);
+		}
+
+		node->UnlockShared();
+		return Error(KERN_INVALID_ARGUMENT);
+	}
+
+	KernReturn<void> Instance::FileStat(__unused VFS::Context *context, stat *buf, VFS::Node *node)
+	{
+		node->FillStat(buf);
+		return ErrorNone;
+	}
+
+	KernReturn<off_t> Instance::DirRead(VFS::Context *context, dirent *entry, VFS::File *file, size_t count)
+	{
+		VFS::FileDirectory *directory = static_cast<VFS::FileDirectory *>(file);
+		VFS::Node *node = file->GetNode();
+		node->LockShared();
+
+		const struct dirent *entries = directory->GetEntries() + directory->GetOffset();
+		size_t left = directory->GetCount() - directory->GetOffset();
+
+		count = std::min(left, count);
+		size_t read = 0;
+
+		if(count > 0)
+		{
+			KernReturn<void> result = context->CopyDataIn(entries, entry, count * sizeof(struct dirent));
+			if(!result.IsValid())
+			{
+				node->UnlockShared();
+				return result.GetError();
+			}
+
+			directory->SetOffset(directory->GetOffset() + count);
+			read = count;
+		}
+
+		node->UnlockShared();
+		return read;
+	}
+
+	KernReturn<void> Instance::Mount(__unused VFS::Context *context, VFS::Instance *instance, VFS::Directory *target, const char *name)
+	{
+		VFS::Mountpoint *mountpoint = VFS::Mountpoint::Alloc()->Init(name, instance, this, GetFreeID());
+		if(!mountpoint)
+			return Error(KERN_NO_MEMORY);
+
+		target->Lock();
+		KernReturn<void> result = target->AttachNode(mountpoint);
+		target->Unlock();
+
+		return result;
+	}
+	KernReturn<void> Instance::Unmount(__unused VFS::Context *context, __unused VFS::Mountpoint *target)
+	{
+		return Error(KERN_FAILURE);
+	}
+
+	KernReturn<void> Instance::Ioctl(__unused VFS::Context *context, __unused VFS::File *file, __unused uint32_t request, __unused void *data)
+	{
+		return Error(KERN_INVALID_ARGUMENT);
+	}
+}
@@ -0,0 +1,107 @@
+//
+//  efs_instance.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _EFS_INSTANCE_H_
+#define _EFS_INSTANCE_H_
+
+#include <vfs/instance.h>
+#include <vfs/block/buffer_cache.h>
+#include "efs_format.h"
+
+namespace EFS
+{
+	class Directory;
+
+	class Instance : public VFS::Instance
+	{
+	public:
+		Instance *Init(VFS::Block::Device *device);
+
+		// Writes an empty file system onto the device
+		static KernReturn<void> Format(VFS::Block::Device *device);
+		static bool IsFormatted(VFS::Block::Device *device);
+
+		KernReturn<VFS::Node *> CreateFile(VFS::Context *context, VFS::Node *parent, const char *name) override;
+		KernReturn<VFS::Node *> CreateDirectory(VFS::Context *context, VFS::Node *parent, const char *name) override;
+		KernReturn<void> DeleteNode(VFS::Context *context, VFS::Node *node) override;
+
+		KernReturn<IO::StrongRef<VFS::Node>> LookUpNode(VFS::Context *context, uint64_t id) override;
+		KernReturn<IO::StrongRef<VFS::Node>> LookUpNode(VFS::Context *context, VFS::Node *node, const char *name) override;
+
+		KernReturn<VFS::File *> OpenFile(VFS::Context *context, VFS::Node *node, int flags) override;
+		void CloseFile(VFS::Context *context, VFS::File *file) override;
+		KernReturn<void> FileStat(VFS::Context *context, stat *buf, VFS::Node *node) override;
+
+		KernReturn<size_t> FileRead(VFS::Context *context, VFS::Node *node, off_t offset, void *data, size_t size) override;
+		KernReturn<size_t> FileWrite(VFS::Context *context, VFS::Node *node, off_t offset, const void *data, size_t size) override;
+		KernReturn<off_t> FileSeek(VFS::Context *context, VFS::File *file, off_t offset, int whence) override;
+		KernReturn<off_t> DirRead(VFS::Context *context, dirent *entry, VFS::File *file, size_t count) override;
+
+		KernReturn<void> Mount(VFS::Context *context, VFS::Instance *instance, VFS::Directory *target, const char *name) override;
+		KernReturn<void> Unmount(VFS::Context *context, VFS::Mountpoint *target) override;
+
+		KernReturn<void> Ioctl(VFS::Context *context, VFS::File *file, uint32_t request, void *data) override;
+
+		bool UsesPageCache() const override { return true; }
+
+		// Inode access, the caller holds the lock of the node owning the inode
+		KernReturn<void> LoadInode(uint32_t number, Inode &inode);
+		KernReturn<void> StoreInode(uint32_t number, const Inode &inode);
+
+		KernReturn<size_t> ReadInode(VFS::Context *context, const Inode &inode, off_t offset, void *data, size_t size);
+		KernReturn<size_t> WriteInode(VFS::Context *context, uint32_t number, Inode &inode, off_t offset, const void *data, size_t size);
+		KernReturn<void> ResizeInode(uint32_t number, Inode &inode, uint64_t size);
+
+		// Every inode is backed by at most one node, claiming fails if a node already exists
+		bool ClaimInode(uint32_t number);
+		void UnclaimInode(uint32_t number);
+
+		KernReturn<void> Sync() override;
+
+	protected:
+		void Dealloc() override;
+
+	private:
+		static constexpr size_t kBufferCacheCapacity = 64;
+
+		KernReturn<uint32_t> AllocateInode(InodeType type);
+		KernReturn<VFS::Node *> CreateNode(VFS::Node *parent, const char *name, InodeType type);
+
+		// Block allocation, instance lock must be held
+		KernReturn<Extent> AllocateBlocks(uint32_t hint, uint32_t count);
+		void FreeBlocks(uint32_t start, uint32_t length);
+		void MarkBlocks(uint32_t start, uint32_t length, bool used);
+
+		uint32_t MapBlock(const Inode &inode, uint32_t index) const;
+		KernReturn<void> ReserveBlocks(Inode &inode, uint32_t count);
+
+		VFS::Block::BufferCache *_cache;
+		Superblock _superblock;
+
+		uint8_t *_bitmap; // In memory copy of the allocation bitmap, written through
+		size_t _bitmapPages;
+		uint32_t _nextFree; // Allocations continue searching here
+
+		uint8_t *_claimed; // One bit per inode that has a node, guarded by the instance lock
+		size_t _claimedPages;
+
+		IODeclareMeta(Instance)
+	};
+}
+
+#endif /* _EFS_INSTANCE_H_ */
@@ -0,0 +1,178 @@
+//
+//  efs_node.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <kern/kprintf.h>
+#include <vfs/context.h>
+#include "efs_node.h"
+#include "efs_instance.h"
+
+namespace EFS
+{
+	IODefineMeta(Node, VFS::Node)
+	IODefineMeta(Directory, VFS::Directory)
+
+	Node *Node::Init(const char *name, Instance *instance, uint32_t number, const Inode &inode)
+	{
+		if(!VFS::Node::Init(name, instance, Type::File, number))
+			return nullptr;
+
+		_number = number;
+		_inode = inode;
+
+		VFS::Node::SetSize(inode.size);
+		return this;
+	}
+
+	void Node::SetSize(uint64_t size)
+	{
+		Instance *instance = static_cast<Instance *>(GetInstance());
+
+		KernReturn<void> result = instance->ResizeInode(_number, _inode, size);
+		if(!result.IsValid())
+		{
+			kprintf("EFS: Failed to resize inode %u\n", _number);
+			return;
+		}
+
+		VFS::Node::SetSize(_inode.size);
+	}
+
+
+
+	Directory *Directory::Init(const char *name, Instance *instance, uint32_t number, const Inode &inode)
+	{
+		if(!VFS::Directory::Init(name, instance, number))
+			return nullptr;
+
+		_number = number;
+		_inode = inode;
+		_populated = false;
+
+		return this;
+	}
+
+	KernReturn<void> Directory::Populate()
+	{
+		if(_populated)
+			return ErrorNone;
+
+		Instance *instance = static_cast<Instance *>(GetInstance());
+		VFS::Context *context = VFS::Context::GetKernelContext();
+
+		for(off_t offset = 0; static_cast<uint64_t>(offset) < _inode.size; offset += sizeof(DirectoryEntry))
+		{
+			DirectoryEntry entry;
+
+			KernReturn<size_t> read = instance->ReadInode(context, _inode, offset, &entry, sizeof(DirectoryEntry));
+			if(!read.IsValid())
+				return read.GetError();
+
+			if(entry.inode == 0 || entry.nameLength == 0 || entry.nameLength > kNameLength)
+				continue;
+
+			char name[kNameLength + 1];
+
+			memcpy(name, entry.name, entry.nameLength);
+			name[entry.nameLength] = '\0';
+
+			// Duplicate names, or nodes left over from an earlier pass that failed part way
+			if(FindNode(name))
+				continue;
+
+			Inode inode;
+
+			KernReturn<void> result = instance->LoadInode(entry.inode, inode);
+			if(!result.IsValid())
+				return result;
+
+			VFS::Node *node;
+
+			switch(inode.type)
+			{
+				case InodeType::File:
+					node = EFS::Node::Alloc()->Init(name, instance, entry.inode, inode);
+					break;
+				case InodeType::Directory:
+					node = Directory::Alloc()->Init(name, instance, entry.inode, inode);
+					break;
+
+				default:
+					kprintf("EFS: Entry %s points to free inode %u\n", name, entry.inode);
+					continue;
+			}
+
+			if(!node)
+				return Error(KERN_NO_MEMORY);
+
+			if(!instance->ClaimInode(entry.inode))
+			{
+				kprintf("EFS: Entry %s points to inode %u which already has a node\n", name, entry.inode);
+				node->Release();
+				continue;
+			}
+
+			if(!AttachNode(node).IsValid())
+				instance->UnclaimInode(entry.inode);
+
+			node->Release();
+		}
+
+		_populated = true;
+		return ErrorNone;
+	}
+
+	KernReturn<void> Directory::AddEntry(const char *name, uint32_t number, InodeType type)
+	{
+		Instance *instance = static_cast<Instance *>(GetInstance());
+		VFS::Context *context = VFS::Context::GetKernelContext();
+
+		size_t length = strlen(name);
+		if(length == 0 || length > kNameLength)
+			return Error(KERN_INVALID_ARGUMENT, ENAMETOOLONG);
+
+		// Reuse the first free slot, or append
+		off_t offset = 0;
+
+		for(; static_cast<uint64_t>(offset) < _inode.size; offset += sizeof(DirectoryEntry))
+		{
+			DirectoryEntry entry;
+
+			KernReturn<size_t> read = instance->ReadInode(context, _inode, offset, &entry, sizeof(DirectoryEntry));
+			if(!read.IsValid())
+				return read.GetError();
+
+			if(entry.inode == 0)
+				break;
+		}
+
+		DirectoryEntry entry;
+		memset(&entry, 0, sizeof(DirectoryEntry));
+
+		entry.inode = number;
+		entry.type = static_cast<uint8_t>(type);
+		entry.nameLength = static_cast<uint8_t>(length);
+		memcpy(entry.name, name, length);
+
+		KernReturn<size_t> written = instance->WriteInode(context, _number, _inode, offset, &entry, sizeof(DirectoryEntry));
+		if(!written.IsValid())
+			return written.GetError();
+
+		return ErrorNone;
+	}
+}
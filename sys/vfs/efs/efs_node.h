@@ -0,0 +1,73 @@
+//
+//  efs_node.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _EFS_NODE_H_
+#define _EFS_NODE_H_
+
+#include <prefix.h>
+#include <vfs/node.h>
+#include <vfs/instance.h>
+#include "efs_format.h"
+
+namespace EFS
+{
+	class Instance;
+
+	// The node locks protect the in-memory copy of the inode, which is written back whenever it changes
+	class Node : public VFS::Node
+	{
+	public:
+		Node *Init(const char *name, Instance *instance, uint32_t number, const Inode &inode);
+
+		uint32_t GetInodeNumber() const { return _number; }
+		Inode &GetInode() { return _inode; }
+
+		void SetSize(uint64_t size) override; // Allocates or frees blocks, lock must be held
+		void UpdateSize() { VFS::Node::SetSize(_inode.size); } // After the inode grew through a write
+
+	private:
+		uint32_t _number;
+		Inode _inode;
+
+		IODeclareMeta(Node)
+	};
+
+	// Children are read from disk the first time the directory is looked up or opened
+	class Directory : public VFS::Directory
+	{
+	public:
+		Directory *Init(const char *name, Instance *instance, uint32_t number, const Inode &inode);
+
+		uint32_t GetInodeNumber() const { return _number; }
+		Inode &GetInode() { return _inode; }
+
+		// Lock must be held
+		KernReturn<void> Populate();
+		bool IsPopulated() const { return _populated; }
+		KernReturn<void> AddEntry(const char *name, uint32_t number, InodeType type);
+
+	private:
+		uint32_t _number;
+		Inode _inode;
+		bool _populated;
+
+		IODeclareMeta(Directory)
+	};
+}
+
+#endif /* _EFS_NODE_H_ */
@@ -103,9 +103,9 @@ namespace FFS
 	{
 		VFS::Directory *directory = static_cast<VFS::Directory *>(tnode);
 
-		directory->Lock();
+		directory->LockShared();
 		IO::StrongRef<VFS::Node> node = directory->FindNode(name);
-		directory->Unlock();
+		directory->UnlockShared();
 
 		if(!node)
 			return Error(KERN_RESOURCES_MISSING);
@@ -150,9 +150,9 @@ namespace FFS
 	{
 		FFS::Node *node = tnode->Downcast<FFS::Node>();
 
-		node->Lock();
+		node->LockShared();
 		KernReturn<size_t> result = node->ReadData(context, offset, data, size);
-		node->Unlock();
+		node->UnlockShared();
 
 		return result;
 	}
@@ -169,7 +169,7 @@ namespace FFS
 	KernReturn<off_t> Instance::FileSeek(__unused VFS::Context *context, VFS::File *file, off_t offset, int whence)
 	{
 		FFS::Node *node = static_cast<FFS::Node *>(file->GetNode());
-		node->Lock();
+		node->LockShared();
 
 		size_t toffset = 0;
 
@@ -186,19 +186,19 @@ namespace FFS
 				break;
 
 			default:
-				node->Unlock();
+				node->UnlockShared();
 				return Error(KERN_INVALID_ARGUMENT);
 		}
 
 		if(toffset <= node->GetSize())
 		{
 			file->SetOffset(toffset);
-			node->Unlock();
+			node->UnlockShared();
 			
 			return static_cast<off_t>(toffset);
 		}
 
-		node->Unlock();
+		node->UnlockShared();
 		return Error(KERN_INVALID_ARGUMENT);
 	}
 
@@ -212,7 +212,7 @@ namespace FFS
 	{
 		VFS::FileDirectory *directory = static_cast<VFS::FileDirectory *>(file);
 		FFS::Node *node = static_cast<FFS::Node *>(file->GetNode());
-		node->Lock();
+		node->LockShared();
 
 		const struct dirent *entries = directory->GetEntries() + directory->GetOffset();
 		size_t left = directory->GetCount() - directory->GetOffset();
@@ -225,7 +225,7 @@ namespace FFS
 			KernReturn<void> result = context->CopyDataIn(entries, entry, count * sizeof(struct dirent));
 			if(!result.IsValid())
 			{
-				node->Unlock();
+				node->UnlockShared();
 				return result.GetError();
 			}
 
@@ -233,7 +233,7 @@ namespace FFS
 			read = count;
 		}
 
-		node->Unlock();
+		node->UnlockShared();
 		return read;
 	}
 
@@ -19,105 +19,327 @@
 #include <machine/memory/memory.h>
 #include <kern/kprintf.h>
 #include <libcpp/algorithm.h>
+#include <kern/kalloc.h>
+#include <libc/string.h>
 #include <vfs/context.h>
 #include "ffs_node.h"
 
 namespace FFS
 {
-	constexpr size_t kNodeMaxChunkSize = VM_PAGE_SIZE * 10;
+	static constexpr size_t kRadixShift = 6;
+	static constexpr size_t kRadixFanout = (1 << kRadixShift);
+	static constexpr size_t kRadixMask = kRadixFanout - 1;
+	static constexpr uint32_t kRadixMaxHeight = 4; // 2^24 pages, 64 GB
+
+	struct RadixNode
+	{
+		void *slots[kRadixFanout];
+	};
+
+	static char _zeroPage[VM_PAGE_SIZE]; // Source for reading holes
 
 	IODefineMeta(Node, VFS::Node)
 
+	// Number of pages covered by a tree, or a slot one level below a node, of the given height
+	static size_t GetRadixSpan(uint32_t height)
+	{
+		return (static_cast<size_t>(1) << (height * kRadixShift));
+	}
+	static size_t GetRadixCapacity(uint32_t height)
+	{
+		return (height == 0) ? 0 : GetRadixSpan(height);
+	}
+
+	static RadixNode *AllocateRadixNode()
+	{
+		RadixNode *node = static_cast<RadixNode *>(kalloc(sizeof(RadixNode)));
+		if(node)
+			memset(node, 0, sizeof(RadixNode));
+
+		return node;
+	}
+
+	// Frees all pages with an index >= first below node and returns true if node ended up empty
+	static bool FreeRadixRange(RadixNode *node, uint32_t height, size_t base, size_t first)
+	{
+		size_t span = GetRadixSpan(height - 1);
+		bool empty = true;
+
+		for(size_t i = 0; i < kRadixFanout; i ++)
+		{
+			if(!node->slots[i])
+				continue;
+
+			size_t start = base + (i * span);
+			size_t end = start + span;
+
+			if(end <= first)
+			{
+				empty = false;
+				continue;
+			}
+
+			if(height == 1)
+			{
+				Sys::Free(static_cast<char *>(node->slots[i]), Sys::VM::Directory::GetKernelDirectory(), 1);
+				node->slots[i] = nullptr;
+				continue;
+			}
+
+			RadixNode *child = static_cast<RadixNode *>(node->slots[i]);
+			if(FreeRadixRange(child, height - 1, start, first))
+			{
+				kfree(child);
+				node->slots[i] = nullptr;
+				continue;
+			}
+
+			empty = false;
+		}
+
+		return empty;
+	}
+
+
 	Node *Node::Init(const char *name, VFS::Instance *instance, uint64_t id)
 	{
 		if(!VFS::Node::Init(name, instance, VFS::Node::Type::File, id))
 			return nullptr;
 
-		_data = nullptr;
-		_size = 0;
-		_pages = 0;
+		_pageTree = nullptr;
+		_pageTreeHeight = 0;
+		_external = nullptr;
+		_externalSize = 0;
 
 		return this;
 	}
 
 	void Node::Dealloc()
 	{
-		if(_data)
-			Sys::Free(_data, Sys::VM::Directory::GetKernelDirectory(), _pages);
-
+		FreePages(0);
 		VFS::Node::Dealloc();
 	}
 
-	KernReturn<void> Node::AllocateMemory(size_t minimumSize)
+	char *Node::GetPage(size_t index) const
+	{
+		if(index >= GetRadixCapacity(_pageTreeHeight))
+			return nullptr;
+
+		void *slot = _pageTree;
+
+		for(uint32_t height = _pageTreeHeight; height > 0 && slot; height --)
+		{
+			RadixNode *node = static_cast<RadixNode *>(slot);
+			slot = node->slots[(index >> ((height - 1) * kRadixShift)) & kRadixMask];
+		}
+
+		return static_cast<char *>(slot);
+	}
+
+	KernReturn<char *> Node::AllocatePage(size_t index)
 	{
-		if(!_data)
+		// Grow the tree upwards until it covers the index
+		while(index >= GetRadixCapacity(_pageTreeHeight))
 		{
-			size_t pages = VM_PAGE_COUNT(minimumSize);
+			if(_pageTreeHeight == kRadixMaxHeight)
+				return Error(KERN_INVALID_ARGUMENT, EFBIG);
 
-			_data = Sys::Alloc<char>(Sys::VM::Directory::GetKernelDirectory(), pages, kVMFlagsKernel);
-			if(!_data)
+			RadixNode *root = AllocateRadixNode();
+			if(!root)
 				return Error(KERN_NO_MEMORY);
 
-			_pages = pages;
-			return ErrorNone;
+			root->slots[0] = _pageTree;
+
+			_pageTree = root;
+			_pageTreeHeight ++;
 		}
 
-		size_t pages = VM_PAGE_COUNT(minimumSize);
-		if(pages > _pages)
+		void **slot = &_pageTree;
+
+		for(uint32_t height = _pageTreeHeight; height > 0; height --)
 		{
-			char *temp = Sys::Alloc<char>(Sys::VM::Directory::GetKernelDirectory(), pages, kVMFlagsKernel);
-			if(!temp)
-				return Error(KERN_NO_MEMORY);
+			RadixNode *node = static_cast<RadixNode *>(*slot);
+			slot = &node->slots[(index >> ((height - 1) * kRadixShift)) & kRadixMask];
+
+			if(!*slot)
+			{
+				if(height > 1)
+					*slot = AllocateRadixNode();
+				else
+					*slot = Sys::Alloc<char>(Sys::VM::Directory::GetKernelDirectory(), 1, kVMFlagsKernel);
+
+				if(!*slot)
+					return Error(KERN_NO_MEMORY);
+
+				if(height == 1)
+				{
+					// Copy on write from the external data, if it covers the page
+					size_t offset = index * VM_PAGE_SIZE;
+					size_t copied = 0;
 
-			memcpy(temp, _data, _size);
-			Sys::Free(_data, Sys::VM::Directory::GetKernelDirectory(), _pages);
+					if(offset < _externalSize)
+					{
+						copied = std::min<size_t>(_externalSize - offset, VM_PAGE_SIZE);
+						memcpy(*slot, _external + offset, copied);
+					}
 
-			_data  = temp;
-			_pages = pages;
+					memset(static_cast<char *>(*slot) + copied, 0, VM_PAGE_SIZE - copied);
+				}
+			}
 		}
 
-		return ErrorNone;
+		return static_cast<char *>(*slot);
+	}
+
+	void Node::FreePages(size_t first)
+	{
+		if(!_pageTree)
+			return;
+
+		RadixNode *root = static_cast<RadixNode *>(_pageTree);
+
+		if(FreeRadixRange(root, _pageTreeHeight, 0, first))
+		{
+			kfree(root);
+
+			_pageTree = nullptr;
+			_pageTreeHeight = 0;
+		}
+	}
+
+	void Node::SetExternalData(const void *data, size_t size)
+	{
+		FreePages(0);
+
+		_external = static_cast<const char *>(data);
+		_externalSize = size;
+
+		VFS::Node::SetSize(size);
+	}
+
+	void Node::SetSize(uint64_t size)
+	{
+		if(size < GetSize())
+		{
+			_externalSize = static_cast<size_t>(std::min<uint64_t>(_externalSize, size));
+
+			FreePages(VM_PAGE_COUNT(size));
+
+			// Clear the rest of the last page, so growing the file again reads zeros
+			char *page = GetPage(size / VM_PAGE_SIZE);
+			size_t offset = size % VM_PAGE_SIZE;
+
+			if(page && offset)
+				memset(page + offset, 0, VM_PAGE_SIZE - offset);
+		}
+
+		VFS::Node::SetSize(size);
 	}
 
 	KernReturn<size_t> Node::WriteData(VFS::Context *context, off_t offset, const void *data, size_t size)
 	{
-		size = std::min(size, kNodeMaxChunkSize);
+		if(offset < 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		const uint8_t *source = static_cast<const uint8_t *>(data);
+		size_t written = 0;
+
+		while(written < size)
+		{
+			uint64_t position = offset + written;
+			uint64_t pageIndex = position / VM_PAGE_SIZE;
+
+			// size_t can't hold every page index of a 64 bit offset, check before narrowing
+			if(pageIndex >= GetRadixCapacity(kRadixMaxHeight))
+			{
+				if(written > 0)
+					break;
 
-		KernReturn<void> result;
+				return Error(KERN_INVALID_ARGUMENT, EFBIG);
+			}
 
-		if((result = AllocateMemory(_size + size)).IsValid() == false)
-			return result.GetError();
+			size_t index = static_cast<size_t>(pageIndex);
+			size_t pageOffset = position % VM_PAGE_SIZE;
+			size_t chunk = std::min(size - written, VM_PAGE_SIZE - pageOffset);
+
+			KernReturn<char *> page = AllocatePage(index);
+			if(!page.IsValid())
+			{
+				if(written > 0)
+					break;
+
+				return page.GetError();
+			}
+
+			KernReturn<void> result = context->CopyDataOut(source + written, page.Get() + pageOffset, chunk);
+			if(!result.IsValid())
+			{
+				if(written > 0)
+					break;
+
+				return result.GetError();
+			}
 
-		if((result = Error(context->CopyDataOut(data, _data + offset, size))).IsValid() == false)
-			return result.GetError();
+			written += chunk;
+		}
 
-		if(offset + size > _size)
-			_size += (offset + size) - _size;
+		if(static_cast<uint64_t>(offset) + written > GetSize())
+			SetSize(offset + written);
 
-		SetSize(_size);
-		return size;
+		return written;
 	}
 	KernReturn<size_t> Node::ReadData(VFS::Context *context, off_t offset, void *data, size_t size)
 	{
-		char *end = _data + _size;
-		char *preferredEnd = _data + offset + size;
-
-		end = std::min(end, preferredEnd);
+		uint64_t fileSize = GetSize();
 
-		if(_data + offset > end)
+		if(offset < 0 || static_cast<uint64_t>(offset) >= fileSize)
 			return 0;
 
-		size = end - (_data + offset);
-		size = std::min(size, kNodeMaxChunkSize);
+		size = static_cast<size_t>(std::min<uint64_t>(size, fileSize - offset));
+
+		uint8_t *target = static_cast<uint8_t *>(data);
+		size_t read = 0;
 
-		if(size > 0)
+		while(read < size)
 		{
-			KernReturn<void> result;
+			uint64_t position = offset + read;
+			uint64_t pageIndex = position / VM_PAGE_SIZE;
+
+			if(pageIndex >= GetRadixCapacity(kRadixMaxHeight))
+			{
+				if(read > 0)
+					break;
+
+				return Error(KERN_INVALID_ARGUMENT, EFBIG);
+			}
+
+			size_t index = static_cast<size_t>(pageIndex);
+			size_t pageOffset = position % VM_PAGE_SIZE;
+			size_t chunk = std::min(size - read, VM_PAGE_SIZE - pageOffset);
+
+			char *page = GetPage(index);
+			const char *source = _zeroPage;
+
+			if(page)
+				source = page + pageOffset;
+			else if(position < _externalSize)
+			{
+				source = _external + position;
+				chunk = std::min<size_t>(chunk, _externalSize - position);
+			}
+
+			KernReturn<void> result = context->CopyDataIn(source, target + read, chunk);
+			if(!result.IsValid())
+			{
+				if(read > 0)
+					break;
 
-			if((result = Error(context->CopyDataIn(_data + offset, data, size))).IsValid() == false)
 				return result.GetError();
+			}
+
+			read += chunk;
 		}
 
-		return size;
+		return read;
 	}
 }
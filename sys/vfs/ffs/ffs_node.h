@@ -35,15 +35,27 @@ namespace FFS
 		KernReturn<size_t> WriteData(VFS::Context *context, off_t offset, const void *data, size_t size);
 		KernReturn<size_t> ReadData(VFS::Context *context, off_t offset, void *data, size_t size);
 
+		void SetSize(uint64_t size) override; // Truncating releases the pages past the new end
+
+		// Serves the file from memory that outlives the node, like the initrd, instead of copying it.
+		// Pages are copied into the node the first time they are written. Lock must be held
+		void SetExternalData(const void *data, size_t size);
+
 	protected:
 		void Dealloc() override;
 
 	private:
-		KernReturn<void> AllocateMemory(size_t minimumSize);
+		// File data lives in single pages hanging off a radix tree indexed by page number,
+		// missing pages read from the external data if there is any, and as zeros otherwise
+		char *GetPage(size_t index) const;
+		KernReturn<char *> AllocatePage(size_t index);
+		void FreePages(size_t first);
+
+		void *_pageTree;
+		uint32_t _pageTreeHeight;
 
-		char *_data;
-		off_t _size;
-		size_t _pages;
+		const char *_external;
+		size_t _externalSize;
 
 		IODeclareMeta(Node)
 	};
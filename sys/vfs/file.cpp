@@ -19,6 +19,8 @@
 #include <kern/panic.h>
 #include <kern/kprintf.h>
 #include <libc/string.h>
+#include <libcpp/algorithm.h>
+#include <machine/memory/memory.h>
 #include "file.h"
 #include "node.h"
 
@@ -27,6 +29,9 @@ namespace VFS
 	IODefineMeta(File, IO::Object)
 	IODefineMeta(FileDirectory, File)
 
+	static constexpr size_t kReadaheadMinWindow = 4;
+	static constexpr size_t kReadaheadMaxWindow = 64;
+
 	File *File::Init(Node *node, int flags)
 	{
 		if(!IO::Object::Init())
@@ -36,6 +41,11 @@ namespace VFS
 		_flags  = flags;
 		_offset = 0;
 
+		_readaheadNext = 0;
+		_readaheadEnd = 0;
+		_readaheadWindow = 0;
+
+		spinlock_init(&_lock);
 		return this;
 	}
 
@@ -50,6 +60,34 @@ namespace VFS
 		_offset = offset;
 	}
 
+	size_t File::UpdateReadahead(off_t offset, size_t size, size_t &index)
+	{
+		bool sequential = (offset == _readaheadNext);
+		size_t last = (offset + size + VM_PAGE_SIZE - 1) / VM_PAGE_SIZE;
+
+		_readaheadNext = offset + size;
+
+		if(!sequential)
+		{
+			_readaheadWindow = 0;
+			_readaheadEnd = 0;
+
+			return 0;
+		}
+
+		_readaheadWindow = std::min(std::max(_readaheadWindow * 2, kReadaheadMinWindow), kReadaheadMaxWindow);
+
+		// Only request what the previous windows didn't cover yet
+		size_t end = last + _readaheadWindow;
+		index = std::max(last, _readaheadEnd);
+
+		if(index >= end)
+			return 0;
+
+		_readaheadEnd = end;
+		return end - index;
+	}
+
 
 
 	FileDirectory *FileDirectory::Init(Node *node, int flags)
@@ -61,7 +99,7 @@ namespace VFS
 			panic("Node must be directory!");
 
 		Directory *directory = static_cast<Directory *>(node);
-		directory->Lock();
+		directory->LockShared();
 
 		const IO::Dictionary *children = directory->GetChildren();
 		children->Enumerate<Node, IO::String>([&](Node *node, IO::String *filename, __unused bool &stop) {
@@ -77,7 +115,7 @@ namespace VFS
 
 		});
 
-		directory->Unlock();
+		directory->UnlockShared();
 		return this;
 	}
 }
@@ -25,6 +25,7 @@
 #include <libc/sys/types.h>
 #include <libc/sys/unistd.h>
 #include <libc/sys/dirent.h>
+#include <libc/sys/spinlock.h>
 #include <libcpp/vector.h>
 #include <libio/core/IOObject.h>
 
@@ -42,6 +43,15 @@ namespace VFS
 
 		void SetOffset(off_t offset);
 
+		// Serializes users of the file offset, descriptor lookups themselves don't lock
+		void Lock() { spinlock_lock(&_lock); }
+		void Unlock() { spinlock_unlock(&_lock); }
+
+		// Tracks sequential reads, the lock must be held. Returns the number of pages starting
+		// at index that should be read ahead of the request, the window grows with every
+		// sequential read and collapses on a seek
+		size_t UpdateReadahead(off_t offset, size_t size, size_t &index);
+
 	protected:
 		void Dealloc() override;
 
@@ -49,6 +59,11 @@ namespace VFS
 		Node *_node;
 		off_t _offset;
 		int _flags;
+		spinlock_t _lock;
+
+		off_t _readaheadNext; // Offset a sequential read continues at
+		size_t _readaheadEnd; // First page past the window that was already requested
+		size_t _readaheadWindow;
 
 		IODeclareMeta(File)
 	};
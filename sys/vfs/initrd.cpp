@@ -0,0 +1,284 @@
+//
+//  initrd.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <kern/kalloc.h>
+#include <kern/kprintf.h>
+#include <machine/memory/memory.h>
+#include "initrd.h"
+#include "vfs.h"
+#include "ffs/ffs_node.h"
+
+namespace VFS
+{
+	// Archive layout written by initrd.py:
+	// InitrdHeader, followed by entries of InitrdEntry, the name and then the stored data.
+	// Uncompressed data starts at a page aligned offset into the archive.
+	// Archives without the header are the older format of <nameLength, size, name, data> entries
+	static constexpr uint32_t kInitrdMagic = 0x44524446; // 'FDRD'
+	static constexpr uint32_t kInitrdVersion = 1;
+
+	enum
+	{
+		kInitrdEntryCompressed = (1 << 0) // LZ4 block format
+	};
+
+	struct InitrdHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+	} __attribute__((packed));
+
+	struct InitrdEntry
+	{
+		uint32_t nameLength;
+		uint32_t size;
+		uint32_t storedSize;
+		uint32_t flags;
+	} __attribute__((packed));
+
+
+	static KernReturn<size_t> DecompressLZ4(const uint8_t *source, size_t sourceSize, uint8_t *target, size_t targetSize)
+	{
+		const uint8_t *sourceEnd = source + sourceSize;
+		uint8_t *targetBegin = target;
+		uint8_t *targetEnd = target + targetSize;
+
+		while(source < sourceEnd)
+		{
+			uint8_t token = *source ++;
+
+			// Literals
+			size_t length = token >> 4;
+			if(length == 15)
+			{
+				uint8_t byte;
+				do {
+					if(source >= sourceEnd)
+						return Error(KERN_INVALID_ARGUMENT);
+
+					byte = *source ++;
+					length += byte;
+				} while(byte == 255);
+			}
+
+			if(length > static_cast<size_t>(sourceEnd - source) || length > static_cast<size_t>(targetEnd - target))
+				return Error(KERN_INVALID_ARGUMENT);
+
+			memcpy(target, source, length);
+
+			source += length;
+			target += length;
+
+			if(source >= sourceEnd)
+				break; // The last sequence only has literals
+
+			// Match
+			if(sourceEnd - source < 2)
+				return Error(KERN_INVALID_ARGUMENT);
+
+			size_t offset = source[0] | (source[1] << 8);
+			source += 2;
+
+			if(offset == 0 || offset > static_cast<size_t>(target - targetBegin))
+				return Error(KERN_INVALID_ARGUMENT);
+
+			length = token & 0xf;
+			if(length == 15)
+			{
+				uint8_t byte;
+				do {
+					if(source >= sourceEnd)
+						return Error(KERN_INVALID_ARGUMENT);
+
+					byte = *source ++;
+					length += byte;
+				} while(byte == 255);
+			}
+
+			length += 4;
+
+			if(length > static_cast<size_t>(targetEnd - target))
+				return Error(KERN_INVALID_ARGUMENT);
+
+			// Matches may overlap their own output, so this has to go byte by byte
+			const uint8_t *match = target - offset;
+			for(size_t i = 0; i < length; i ++)
+				target[i] = match[i];
+
+			target += length;
+		}
+
+		return static_cast<size_t>(target - targetBegin);
+	}
+
+	static KernReturn<void> CreateFile(Context *context, const char *name, const uint8_t *data, size_t size, bool inPlace)
+	{
+		KernReturn<int> fd = Open(context, name, O_WRONLY | O_CREAT | O_TRUNC);
+		if(!fd.IsValid())
+			return fd.GetError();
+
+		IO::StrongRef<Node> node = GetNode(context, fd);
+		FFS::Node *ffsNode = (inPlace && node) ? node->Downcast<FFS::Node>() : nullptr;
+		KernReturn<void> result;
+
+		if(ffsNode)
+		{
+			ffsNode->Lock();
+			ffsNode->SetExternalData(data, size);
+			ffsNode->Unlock();
+		}
+		else
+		{
+			size_t left = size;
+			while(left > 0)
+			{
+				KernReturn<size_t> written = Write(context, fd, data, left);
+				if(!written.IsValid())
+				{
+					result = written.GetError();
+					break;
+				}
+
+				left -= written;
+				data += written;
+			}
+		}
+
+		Close(context, fd).Suppress();
+		return result;
+	}
+
+	static KernReturn<void> CreateCompressedFile(Context *context, const char *name, const uint8_t *data, size_t storedSize, size_t size)
+	{
+		size_t pages = VM_PAGE_COUNT(size);
+		uint8_t *buffer = nullptr;
+
+		if(pages > 0)
+		{
+			buffer = Sys::Alloc<uint8_t>(Sys::VM::Directory::GetKernelDirectory(), pages, kVMFlagsKernel);
+			if(!buffer)
+				return Error(KERN_NO_MEMORY);
+		}
+
+		KernReturn<size_t> inflated = DecompressLZ4(data, storedSize, buffer, size);
+		KernReturn<void> result;
+
+		if(!inflated.IsValid() || inflated.Get() != size)
+			result = Error(KERN_INVALID_ARGUMENT);
+		else
+			result = CreateFile(context, name, buffer, size, false);
+
+		if(buffer)
+			Sys::Free(buffer, Sys::VM::Directory::GetKernelDirectory(), pages);
+
+		return result;
+	}
+
+	static void LoadLegacyInitrd(Context *context, uint8_t *buffer, uint8_t *end)
+	{
+		while(buffer < end)
+		{
+			// Read the file header
+			uint32_t nameLength, binaryLength;
+
+			memcpy(&nameLength, buffer + 0, 4);
+			memcpy(&binaryLength, buffer + 4, 4);
+
+			buffer += 8;
+
+			// Read the filename
+			char *name = static_cast<char *>(kalloc(nameLength + 1));
+			memcpy(name, buffer, nameLength);
+
+			name[nameLength] = '\0';
+			buffer += nameLength;
+
+			if(!CreateFile(context, name, buffer, binaryLength, true).IsValid())
+				kprintf("Couldn't create %s\n", name);
+
+			buffer += binaryLength;
+			kfree(name);
+		}
+	}
+
+	static void LoadInitrd(Context *context, uint8_t *begin, uint8_t *end)
+	{
+		uint8_t *buffer = begin + sizeof(InitrdHeader);
+
+		while(buffer + sizeof(InitrdEntry) <= end)
+		{
+			InitrdEntry entry;
+			memcpy(&entry, buffer, sizeof(InitrdEntry));
+
+			buffer += sizeof(InitrdEntry);
+
+			char *name = static_cast<char *>(kalloc(entry.nameLength + 1));
+			memcpy(name, buffer, entry.nameLength);
+
+			name[entry.nameLength] = '\0';
+			buffer += entry.nameLength;
+
+			KernReturn<void> result;
+
+			if(entry.flags & kInitrdEntryCompressed)
+			{
+				result = CreateCompressedFile(context, name, buffer, entry.storedSize, entry.size);
+			}
+			else
+			{
+				buffer = begin + VM_PAGE_ALIGN_UP(buffer - begin);
+				result = CreateFile(context, name, buffer, entry.size, true);
+			}
+
+			if(!result.IsValid())
+				kprintf("Couldn't create %s\n", name);
+
+			buffer += entry.storedSize;
+			kfree(name);
+		}
+	}
+
+	KernReturn<void> LoadInitrdModule(uint8_t *buffer, uint8_t *end)
+	{
+		Context *context = Context::GetKernelContext();
+
+		kprintf("loading initrd (%u bytes)... ", end - buffer);
+
+		InitrdHeader header;
+		memcpy(&header, buffer, sizeof(InitrdHeader));
+
+		if(header.magic == kInitrdMagic)
+		{
+			if(header.version != kInitrdVersion)
+			{
+				kprintf("unsupported version %u", header.version);
+				return Error(KERN_INVALID_ARGUMENT);
+			}
+
+			LoadInitrd(context, buffer, end);
+		}
+		else
+		{
+			LoadLegacyInitrd(context, buffer, end);
+		}
+
+		kprintf("done");
+		return ErrorNone;
+	}
+}
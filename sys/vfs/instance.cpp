@@ -19,6 +19,7 @@
 #include "instance.h"
 #include "node.h"
 #include "context.h"
+#include "page_cache.h"
 
 namespace VFS
 {
@@ -67,15 +68,9 @@ namespace VFS
 		_mountpoint	= IO::SafeRetain(node);
 	}
 
-	KernReturn<OS::MmapTaskEntry *> Instance::Mmap(Context *context, Node *node, OS::MmapArgs *arguments)
+	// Writable private mappings get their own copy of the file
+	static KernReturn<OS::MmapTaskEntry *> MmapPrivate(Context *context, Node *node, OS::MmapArgs *arguments)
 	{
-		// Sanity check the file size
-		uint64_t minSize = static_cast<uint64_t>(arguments->offset) + arguments->length;
-
-		if(node->GetSize() < minSize)
-			return Error(KERN_INVALID_ARGUMENT);
-
-
 		Error error(KERN_FAILURE);
 
 		Sys::VM::Directory *directory = context->GetTask()->GetDirectory();
@@ -115,7 +110,11 @@ namespace VFS
 		// Read the file into the buffer
 		{
 			VFS::Instance *instance = node->GetInstance();
-			KernReturn<size_t> result = instance->FileRead(context, node, arguments->offset, reinterpret_cast<void *>(vmemory), arguments->length);
+			PageCache *cache = instance->UsesPageCache() ? node->GetPageCache(true) : nullptr;
+
+			KernReturn<size_t> result = cache ?
+				cache->Read(context, arguments->offset, reinterpret_cast<void *>(vmemory), arguments->length) :
+				instance->FileRead(context, node, arguments->offset, reinterpret_cast<void *>(vmemory), arguments->length);
 
 			if(!result.IsValid())
 			{
@@ -151,6 +150,80 @@ namespace VFS
 
 		return error;
 	}
+	// Everything else maps the pages of the node's page cache
+	static KernReturn<OS::MmapTaskEntry *> MmapShared(Context *context, Node *node, OS::MmapArgs *arguments)
+	{
+		PageCache *cache = node->GetPageCache(true);
+		if(!cache)
+			return Error(KERN_NO_MEMORY);
+
+		Sys::VM::Directory *directory = context->GetTask()->GetDirectory();
+		Sys::VM::Directory::Flags vmflags = Sys::VM::TranslateMmapProtection(arguments->protection);
+
+		size_t pages = VM_PAGE_COUNT(arguments->length);
+		size_t first = arguments->offset / VM_PAGE_SIZE;
+
+		KernReturn<uintptr_t> page = cache->GetPage(first);
+		if(!page.IsValid())
+			return page.GetError();
+
+		// The cached pages aren't contiguous. Reserve the range kernel only, so other threads of the task
+		// can't reach the frames behind the first page, and map every cached page into it before returning
+		KernReturn<vm_address_t> vmemory = directory->Alloc(page, pages, kVMFlagsKernel);
+		if(!vmemory.IsValid())
+			return vmemory.GetError();
+
+		for(size_t i = 0; i < pages; i ++)
+		{
+			KernReturn<void> result;
+
+			if(i > 0)
+				page = cache->GetPage(first + i);
+
+			if(page.IsValid())
+				result = directory->MapPage(page, vmemory + (i * VM_PAGE_SIZE), vmflags);
+			else
+				result = page.GetError();
+
+			if(!result.IsValid())
+			{
+				directory->Free(vmemory, pages);
+				return result.GetError();
+			}
+		}
+
+		OS::MmapTaskEntry *entry = new OS::MmapTaskEntry(node);
+		if(!entry)
+		{
+			directory->Free(vmemory, pages);
+			return Error(KERN_NO_MEMORY);
+		}
+
+		entry->phaddress = 0x0; // Not contiguous
+		entry->vmaddress = vmemory;
+		entry->protection = arguments->protection;
+		entry->pages = pages;
+		entry->flags = arguments->flags;
+		entry->offset = arguments->offset;
+		entry->object = cache->Retain();
+
+		return entry;
+	}
+
+	KernReturn<OS::MmapTaskEntry *> Instance::Mmap(Context *context, Node *node, OS::MmapArgs *arguments)
+	{
+		// Sanity check the file size
+		uint64_t minSize = static_cast<uint64_t>(arguments->offset) + arguments->length;
+
+		if(node->GetSize() < minSize)
+			return Error(KERN_INVALID_ARGUMENT);
+
+		if((arguments->flags & MAP_PRIVATE) && (arguments->protection & PROT_WRITE))
+			return MmapPrivate(context, node, arguments);
+
+		return MmapShared(context, node, arguments);
+	}
+
 	KernReturn<size_t> Instance::Msync(Context *context, OS::MmapTaskEntry *entry, OS::MsyncArgs *arguments)
 	{
 		// Adjust the offset
@@ -159,9 +232,13 @@ namespace VFS
 		// Flush it down to the file
 		KernReturn<size_t> result = FileWrite(context, entry->node, entry->offset + offset, reinterpret_cast<void *>(entry->vmaddress), arguments->length);
 
-		if(result.IsValid())
-			return 0;
+		if(!result.IsValid())
+			return result.GetError();
+
+		KernReturn<void> synced = Sync();
+		if(!synced.IsValid())
+			return synced.GetError();
 
-		return result.GetError();
+		return 0;
 	}
 }
@@ -79,6 +79,13 @@ namespace VFS
 		virtual KernReturn<OS::MmapTaskEntry *> Mmap(Context *context, Node *node, OS::MmapArgs *args);
 		virtual KernReturn<size_t> Msync(Context *context, OS::MmapTaskEntry *entry, OS::MsyncArgs *args);
 
+		// File data of instances using the page cache is read and written through the node's cache,
+		// with readahead and writeback. Worthwhile for file systems that aren't backed by memory
+		virtual bool UsesPageCache() const { return false; }
+
+		// Writes out what the instance buffers below the page cache, once per cache flush and msync
+		virtual KernReturn<void> Sync() { return ErrorNone; }
+
 		Node *GetRootNode() const { return _rootNode; }
 
 	protected:
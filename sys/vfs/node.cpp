@@ -21,6 +21,8 @@
 
 #include "node.h"
 #include "instance.h"
+#include "dentry.h"
+#include "page_cache.h"
 
 namespace VFS
 {
@@ -34,20 +36,20 @@ namespace VFS
 		if(!Object::Init())
 			return nullptr;
 
-		spinlock_init(&_lock);
-
 		_name = IO::String::Alloc()->InitWithCString(name);
 		_instance = instance;
 		_id = id;
 		_type = type;
 		_size = 0;
 		_parent = nullptr;
+		_pageCache = nullptr;
 
 		return this;
 	}
 
 	void Node::Dealloc()
 	{
+		IO::SafeRelease(_pageCache);
 		_name->Release();
 		Object::Dealloc();
 	}
@@ -56,11 +58,33 @@ namespace VFS
 
 	void Node::Lock()
 	{
-		spinlock_lock(&_lock);
+		_lock.Lock();
 	}
 	void Node::Unlock()
 	{
-		spinlock_unlock(&_lock);
+		_lock.Unlock();
+	}
+	void Node::LockShared()
+	{
+		_lock.LockShared();
+	}
+	void Node::UnlockShared()
+	{
+		_lock.UnlockShared();
+	}
+
+
+	PageCache *Node::GetPageCache(bool create)
+	{
+		_lock.Lock();
+
+		if(!_pageCache && create)
+			_pageCache = PageCache::Alloc()->Init(this);
+
+		PageCache *cache = _pageCache;
+		_lock.Unlock();
+
+		return cache;
 	}
 
 
@@ -69,9 +93,23 @@ namespace VFS
 		SafeRelease(_name);
 		_name = IO::String::Alloc()->InitWithCString(name);
 	}
+	uint64_t Node::GetSize() const
+	{
+		uint64_t size;
+		uint32_t sequence;
+
+		do {
+			sequence = _sizeSequence.BeginRead();
+			size = _size;
+		} while(_sizeSequence.RetryRead(sequence));
+
+		return size;
+	}
 	void Node::SetSize(uint64_t size)
 	{
+		_sizeSequence.BeginWrite();
 		_size = size;
+		_sizeSequence.EndWrite();
 	}
 
 	void Node::FillStat(stat *buf)
@@ -80,7 +118,7 @@ namespace VFS
 		strlcpy(buf->name, _name->GetCString(), MAXNAME);
 
 		buf->id   = _id;
-		buf->size = _size;
+		buf->size = Node::GetSize();
 	}
 
 	void Node::SetParent(Directory *parent)
@@ -102,6 +140,7 @@ namespace VFS
 
 	void Directory::Dealloc()
 	{
+		DentryPurge(this);
 		_children->Release();
 		Node::Dealloc();
 	}
@@ -117,6 +156,8 @@ namespace VFS
 		_children->SetObjectForKey(node, node->GetName());
 		node->SetParent(this);
 
+		DentryInvalidate(this, node->GetName()->GetCString());
+
 		return ErrorNone;
 	}
 	KernReturn<void> Directory::RemoveNode(Node *node)
@@ -130,6 +171,8 @@ namespace VFS
 		_children->RemoveObjectForKey(node->GetName());
 		node->SetParent(nullptr);
 
+		DentryInvalidate(this, node->GetName()->GetCString());
+
 		return ErrorNone;
 	}
 	KernReturn<void> Directory::RenameNode(Node *node, const char *filename)
@@ -153,8 +196,11 @@ namespace VFS
 		node->Retain();
 
 		_children->RemoveObjectForKey(node->GetName());
+		DentryInvalidate(this, node->GetName()->GetCString());
+
 		node->SetName(filename);
 		_children->SetObjectForKey(node, node->GetName());
+		DentryInvalidate(this, filename);
 
 		node->Release();
 
@@ -26,6 +26,7 @@
 #include <libc/stdint.h>
 #include <libc/sys/unistd.h>
 #include <libc/sys/dirent.h>
+#include <os/locks/rwlock.h>
 
 #include <libio/core/IOObject.h>
 #include <libio/core/IODictionary.h>
@@ -35,6 +36,7 @@ namespace VFS
 {
 	class Instance;
 	class Directory;
+	class PageCache;
 
 	class Node : public IO::Object
 	{
@@ -56,14 +58,21 @@ namespace VFS
 		bool IsMountpoint() const { return (_type == Type::Mountpoint); }
 
 		uint64_t GetID() const { return _id; }
-		virtual uint64_t GetSize() const { return _size; }
+		virtual uint64_t GetSize() const; // Lockless, the size is published through a sequence counter
 		Type GetType() const { return _type; }
 		IO::String *GetName() const { return _name; }
 		Instance *GetInstance() const { return _instance; }
 		Directory *GetParent() const { return _parent; }
 
+		// Lock() excludes everyone and is required for modifications, LockShared() admits
+		// concurrent readers of the data and, for directories, of the children
 		void Lock();
 		void Unlock();
+		void LockShared();
+		void UnlockShared();
+
+		// The cache lives as long as the node, returns nullptr if it doesn't exist and create is false
+		PageCache *GetPageCache(bool create);
 
 		// Lock must be held before calling these
 		virtual void SetName(const char *name);
@@ -73,16 +82,18 @@ namespace VFS
 		virtual void SetParent(Directory *parent);
 
 	protected:
-		spinlock_t _lock;
+		OS::RWLock _lock;
 
 	private:
 		IO::String *_name;
 		uint64_t _id;
 		uint64_t _size;
+		OS::SeqCount _sizeSequence;
 		Type _type;
 
 		Directory *_parent;
 		Instance *_instance;
+		PageCache *_pageCache;
 
 		IODeclareMeta(Node)
 	};
@@ -98,6 +109,7 @@ namespace VFS
 		KernReturn<void> RemoveNode(Node *node);
 		KernReturn<void> RenameNode(Node *node, const char *filename); // Calls SetName() on the node!
 
+		// Shared lock is enough
 		IO::StrongRef<Node> FindNode(const char *filename) const;
 		const IO::Dictionary *GetChildren() const { return _children; }
 
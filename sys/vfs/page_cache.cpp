@@ -0,0 +1,479 @@
+//
+//  page_cache.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/string.h>
+#include <libcpp/algorithm.h>
+#include <kern/kalloc.h>
+#include <kern/kprintf.h>
+#include <machine/memory/memory.h>
+#include <machine/interrupts/interrupts.h>
+#include <machine/cpu.h>
+#include <os/workqueue.h>
+#include "page_cache.h"
+#include "writeback.h"
+#include "node.h"
+#include "instance.h"
+#include "context.h"
+
+namespace VFS
+{
+	IODefineMeta(PageCache, IO::Object)
+
+	// Cached pages are page aligned, so the low bit of an entry is free to mark it dirty
+	static constexpr uintptr_t kPageDirty = 1;
+
+	struct ReadaheadRequest
+	{
+		Node *node; // Retained, keeps the cache alive until the request ran
+		size_t index;
+		size_t count;
+	};
+
+	PageCache *PageCache::Init(Node *node)
+	{
+		if(!IO::Object::Init())
+			return nullptr;
+
+		spinlock_init(&_lock);
+
+		_node = node;
+		_pages = nullptr;
+		_capacity = 0;
+		_dirtyPages = 0;
+
+		return this;
+	}
+
+	void PageCache::Dealloc()
+	{
+		if(_pages)
+		{
+			for(size_t i = 0; i < _capacity; i ++)
+			{
+				if(_pages[i])
+					Sys::PM::Free(_pages[i] & ~kPageDirty, 1);
+			}
+
+			kfree(_pages);
+		}
+
+		IO::Object::Dealloc();
+	}
+
+	// Lock must be held
+	KernReturn<void> PageCache::Reserve(size_t index)
+	{
+		if(index < _capacity)
+			return ErrorNone;
+
+		size_t capacity = std::max<size_t>(16, _capacity);
+		while(capacity <= index)
+			capacity *= 2;
+
+		uintptr_t *pages = static_cast<uintptr_t *>(kalloc(capacity * sizeof(uintptr_t)));
+		if(!pages)
+			return Error(KERN_NO_MEMORY);
+
+		if(_pages)
+		{
+			memcpy(pages, _pages, _capacity * sizeof(uintptr_t));
+			kfree(_pages);
+		}
+
+		memset(pages + _capacity, 0, (capacity - _capacity) * sizeof(uintptr_t));
+
+		_pages = pages;
+		_capacity = capacity;
+
+		return ErrorNone;
+	}
+
+	KernReturn<void> PageCache::FillPage(uintptr_t page, size_t index, size_t offset, size_t length)
+	{
+		Sys::VM::Directory *directory = Sys::VM::Directory::GetKernelDirectory();
+
+		KernReturn<vm_address_t> vaddress = directory->Alloc(page, 1, kVMFlagsKernel);
+		if(!vaddress.IsValid())
+			return vaddress.GetError();
+
+		uint8_t *buffer = reinterpret_cast<uint8_t *>(vaddress.Get()) + offset;
+		size_t read = 0;
+
+		// Pages past the end of the file are only ever created by writes extending it
+		KernReturn<size_t> result;
+
+		if(index * VM_PAGE_SIZE + offset < _node->GetSize())
+		{
+			Instance *instance = _node->GetInstance();
+			result = instance->FileRead(Context::GetKernelContext(), _node, index * VM_PAGE_SIZE + offset, buffer, length);
+
+			if(result.IsValid())
+				read = result.Get();
+		}
+
+		// Beyond the end of file the page reads as zeros
+		if(read < length)
+			memset(buffer + read, 0, length - read);
+
+		directory->Free(vaddress, 1);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return ErrorNone;
+	}
+
+	KernReturn<uintptr_t> PageCache::GetPage(size_t index)
+	{
+		spinlock_lock(&_lock);
+
+		if(index < _capacity && _pages[index])
+		{
+			uintptr_t page = _pages[index] & ~kPageDirty;
+			spinlock_unlock(&_lock);
+
+			return page;
+		}
+
+		spinlock_unlock(&_lock);
+
+		// Read the page without holding the lock, the file system might block
+		KernReturn<uintptr_t> page = Sys::PM::Alloc(1);
+		if(!page.IsValid())
+			return page.GetError();
+
+		KernReturn<void> result = FillPage(page, index, 0, VM_PAGE_SIZE);
+		if(!result.IsValid())
+		{
+			Sys::PM::Free(page, 1);
+			return result.GetError();
+		}
+
+		spinlock_lock(&_lock);
+
+		result = Reserve(index);
+		if(!result.IsValid())
+		{
+			spinlock_unlock(&_lock);
+			Sys::PM::Free(page, 1);
+
+			return result.GetError();
+		}
+
+		// Somebody else might have filled the page in the meantime
+		uintptr_t cached = _pages[index];
+		if(!cached)
+			_pages[index] = cached = page.Get();
+
+		spinlock_unlock(&_lock);
+
+		if(cached != page.Get())
+			Sys::PM::Free(page, 1);
+
+		return cached;
+	}
+
+	void PageCache::Refresh(off_t offset, size_t length)
+	{
+		if(length == 0)
+			return;
+
+		size_t first = offset / VM_PAGE_SIZE;
+		size_t last = (offset + length - 1) / VM_PAGE_SIZE;
+
+		for(size_t i = first; i <= last; i ++)
+		{
+			off_t pageBegin = static_cast<off_t>(i) * VM_PAGE_SIZE;
+
+			size_t begin = (offset > pageBegin) ? static_cast<size_t>(offset - pageBegin) : 0;
+			size_t end = std::min<size_t>(VM_PAGE_SIZE, (offset + length) - pageBegin);
+
+			spinlock_lock(&_lock);
+
+			if(i >= _capacity)
+			{
+				spinlock_unlock(&_lock);
+				break;
+			}
+
+			// The file system's content is authoritative again. Pending writeback is only dropped
+			// if the whole page is replaced, otherwise it still holds stores that weren't synced
+			uintptr_t page = _pages[i] & ~kPageDirty;
+
+			if((_pages[i] & kPageDirty) && begin == 0 && end == VM_PAGE_SIZE)
+			{
+				_pages[i] = page;
+				_dirtyPages --;
+			}
+
+			spinlock_unlock(&_lock);
+
+			// Pages are never dropped while the cache is alive, so the page stays valid without the lock
+			if(page)
+				FillPage(page, i, begin, end - begin).Suppress();
+		}
+	}
+
+	void PageCache::RefreshAll()
+	{
+		spinlock_lock(&_lock);
+		size_t capacity = _capacity;
+		spinlock_unlock(&_lock);
+
+		Refresh(0, capacity * VM_PAGE_SIZE);
+	}
+
+
+	KernReturn<void> PageCache::CopyPage(Context *context, size_t index, size_t offset, void *data, size_t length, bool write)
+	{
+		KernReturn<uintptr_t> page = GetPage(index);
+		if(!page.IsValid())
+			return page.GetError();
+
+		Sys::VM::Directory *directory = Sys::VM::Directory::GetKernelDirectory();
+
+		KernReturn<vm_address_t> vaddress = directory->Alloc(page, 1, kVMFlagsKernel);
+		if(!vaddress.IsValid())
+			return vaddress.GetError();
+
+		uint8_t *buffer = reinterpret_cast<uint8_t *>(vaddress.Get()) + offset;
+
+		KernReturn<void> result = write ?
+			context->CopyDataOut(data, buffer, length) :
+			context->CopyDataIn(buffer, data, length);
+
+		directory->Free(vaddress, 1);
+		return result;
+	}
+
+	KernReturn<size_t> PageCache::Read(Context *context, off_t offset, void *data, size_t size)
+	{
+		uint64_t fileSize = _node->GetSize();
+		if(static_cast<uint64_t>(offset) >= fileSize)
+			return 0;
+
+		size = std::min<uint64_t>(size, fileSize - offset);
+
+		uint8_t *buffer = static_cast<uint8_t *>(data);
+		size_t total = 0;
+
+		while(total < size)
+		{
+			size_t pageOffset = (offset + total) % VM_PAGE_SIZE;
+			size_t chunk = std::min(size - total, VM_PAGE_SIZE - pageOffset);
+
+			KernReturn<void> result = CopyPage(context, (offset + total) / VM_PAGE_SIZE, pageOffset, buffer + total, chunk, false);
+			if(!result.IsValid())
+			{
+				if(total > 0)
+					break;
+
+				return result.GetError();
+			}
+
+			total += chunk;
+		}
+
+		return total;
+	}
+
+	KernReturn<size_t> PageCache::Write(Context *context, off_t offset, const void *data, size_t size)
+	{
+		uint8_t *buffer = const_cast<uint8_t *>(static_cast<const uint8_t *>(data));
+		size_t total = 0;
+		size_t dirtied = 0;
+
+		while(total < size)
+		{
+			size_t index = (offset + total) / VM_PAGE_SIZE;
+			size_t pageOffset = (offset + total) % VM_PAGE_SIZE;
+			size_t chunk = std::min(size - total, VM_PAGE_SIZE - pageOffset);
+
+			KernReturn<void> result = CopyPage(context, index, pageOffset, buffer + total, chunk, true);
+			if(!result.IsValid())
+			{
+				if(total > 0)
+					break;
+
+				return result.GetError();
+			}
+
+			spinlock_lock(&_lock);
+
+			if(!(_pages[index] & kPageDirty))
+			{
+				_pages[index] |= kPageDirty;
+				_dirtyPages ++;
+				dirtied ++;
+			}
+
+			spinlock_unlock(&_lock);
+
+			total += chunk;
+		}
+
+		_node->Lock();
+
+		if(static_cast<uint64_t>(offset + total) > _node->GetSize())
+			_node->SetSize(offset + total);
+
+		_node->Unlock();
+
+		if(dirtied > 0)
+			WritebackMarkDirty(_node, dirtied);
+
+		return total;
+	}
+
+
+	void PageCache::ReadaheadCallback(void *context)
+	{
+		ReadaheadRequest *request = static_cast<ReadaheadRequest *>(context);
+		PageCache *cache = request->node->GetPageCache(false);
+
+		for(size_t i = 0; i < request->count; i ++)
+		{
+			size_t index = request->index + i;
+
+			if(index * VM_PAGE_SIZE >= request->node->GetSize())
+				break;
+
+			KernReturn<uintptr_t> page = cache->GetPage(index);
+			if(!page.IsValid())
+				break;
+		}
+
+		request->node->Release();
+		delete request;
+	}
+
+	void PageCache::Readahead(size_t index, size_t count)
+	{
+		// Only queue the part of the window that isn't cached yet
+		spinlock_lock(&_lock);
+
+		while(count > 0 && index < _capacity && _pages[index])
+		{
+			index ++;
+			count --;
+		}
+
+		spinlock_unlock(&_lock);
+
+		if(count == 0 || index * VM_PAGE_SIZE >= _node->GetSize())
+			return;
+
+		ReadaheadRequest *request = new ReadaheadRequest;
+		if(!request)
+			return;
+
+		request->node = _node->Retain();
+		request->index = index;
+		request->count = count;
+
+		bool enabled = Sys::DisableInterrupts();
+		bool queued = Sys::CPU::GetCurrentCPU()->GetWorkQueue()->PushEntry(&ReadaheadCallback, request);
+
+		if(enabled)
+			Sys::EnableInterrupts();
+
+		// Readahead is only a hint, drop it if the queue is full
+		if(!queued)
+		{
+			request->node->Release();
+			delete request;
+		}
+	}
+
+
+	KernReturn<void> PageCache::Flush()
+	{
+		Sys::VM::Directory *directory = Sys::VM::Directory::GetKernelDirectory();
+		Instance *instance = _node->GetInstance();
+		bool flushed = false;
+
+		for(size_t index = 0;; index ++)
+		{
+			uintptr_t page = 0;
+
+			spinlock_lock(&_lock);
+
+			for(; index < _capacity; index ++)
+			{
+				if(_pages[index] & kPageDirty)
+				{
+					page = _pages[index] & ~kPageDirty;
+
+					// Cleared before the write, so a concurrent write dirties the page again
+					_pages[index] = page;
+					_dirtyPages --;
+					break;
+				}
+			}
+
+			spinlock_unlock(&_lock);
+
+			// The file system is free to buffer the writes, sync it once for the whole flush
+			if(!page)
+			{
+				if(flushed)
+					return instance->Sync();
+
+				return ErrorNone;
+			}
+
+			uint64_t fileSize = _node->GetSize();
+			off_t offset = index * VM_PAGE_SIZE;
+
+			// Truncated since it was written
+			if(static_cast<uint64_t>(offset) >= fileSize)
+				continue;
+
+			KernReturn<vm_address_t> vaddress = directory->Alloc(page, 1, kVMFlagsKernel);
+			KernReturn<size_t> result;
+
+			if(vaddress.IsValid())
+			{
+				size_t length = std::min<uint64_t>(VM_PAGE_SIZE, fileSize - offset);
+
+				result = instance->FileWrite(Context::GetKernelContext(), _node, offset, reinterpret_cast<void *>(vaddress.Get()), length);
+				directory->Free(vaddress, 1);
+			}
+			else
+			{
+				result = vaddress.GetError();
+			}
+
+			if(!result.IsValid())
+			{
+				spinlock_lock(&_lock);
+
+				if(!(_pages[index] & kPageDirty))
+				{
+					_pages[index] |= kPageDirty;
+					_dirtyPages ++;
+				}
+
+				spinlock_unlock(&_lock);
+				return result.GetError();
+			}
+
+			flushed = true;
+		}
+	}
+}
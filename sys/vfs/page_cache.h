@@ -0,0 +1,83 @@
+//
+//  page_cache.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _VFS_PAGE_CACHE_H_
+#define _VFS_PAGE_CACHE_H_
+
+#include <prefix.h>
+#include <libc/stddef.h>
+#include <libc/stdint.h>
+#include <libc/sys/types.h>
+#include <libc/sys/spinlock.h>
+#include <libcpp/atomic.h>
+#include <kern/kern_return.h>
+#include <libio/core/IOObject.h>
+
+namespace VFS
+{
+	class Node;
+	class Context;
+
+	// Physical pages holding a node's content, filled on demand through the kernel context.
+	// Shared file mappings map these pages directly, so every task mapping a file shares one copy.
+	// For instances that use the page cache, reads and writes go through it as well, written
+	// pages are kept dirty and written back later by the writeback thread
+	class PageCache : public IO::Object
+	{
+	public:
+		PageCache *Init(Node *node);
+		void Dealloc() override;
+
+		// Returns the physical page holding the given page of the file, reading it in if needed
+		KernReturn<uintptr_t> GetPage(size_t index);
+
+		// Re-reads the range in the cached pages, after it was written through the file system.
+		// Only the given bytes are replaced, the rest of the pages keeps unsynced stores of shared mappings
+		void Refresh(off_t offset, size_t length);
+		void RefreshAll();
+
+		// Transfers file data between the cache and the context, reads stop at the end of the file
+		KernReturn<size_t> Read(Context *context, off_t offset, void *data, size_t size);
+		KernReturn<size_t> Write(Context *context, off_t offset, const void *data, size_t size);
+
+		// Fills the pages on a kernel worker, pages that are already cached are skipped
+		void Readahead(size_t index, size_t count);
+
+		// Writes the dirty pages back through the file system
+		KernReturn<void> Flush();
+		bool IsDirty() const { return (_dirtyPages.load() > 0); }
+
+	private:
+		KernReturn<void> FillPage(uintptr_t page, size_t index, size_t offset, size_t length);
+		KernReturn<void> Reserve(size_t index);
+		KernReturn<void> CopyPage(Context *context, size_t index, size_t offset, void *data, size_t length, bool write);
+
+		static void ReadaheadCallback(void *context);
+
+		Node *_node; // Not retained, the node owns the cache and mappings retain both
+		spinlock_t _lock;
+
+		uintptr_t *_pages; // Indexed by page, 0 if not cached, kPageDirty is set for pages that need writeback
+		size_t _capacity;
+		std::atomic<size_t> _dirtyPages;
+
+		IODeclareMeta(PageCache)
+	};
+}
+
+#endif /* _VFS_PAGE_CACHE_H_ */
@@ -20,16 +20,21 @@
 #include <kern/kprintf.h>
 #include "path.h"
 #include "instance.h"
+#include "dentry.h"
 
 namespace VFS
 {
 	Path::Path(const char *path, Context *context) :
+		_name(nullptr),
+		_nameLength(0),
 		_context(context),
 		_node(nullptr),
 		_totalElements(0),
 		_elementsLeft(0)
 	{
-		_path = static_cast<char *>(kalloc(strlen(path + 1)));
+		size_t length = strlen(path);
+
+		_path = (length < MAXNAME) ? _buffer : static_cast<char *>(kalloc(length + 1));
 		_element = _path;
 
 		if(!_path)
@@ -62,32 +67,86 @@ namespace VFS
 
 	Path::~Path()
 	{
-		if(_path)
+		if(_path && _path != _buffer)
 			kfree(_path);
 	}
 
 
+	static size_t GetElementLength(char *element)
+	{
+		char *end = strchr(element, '/');
+		return end ? static_cast<size_t>(end - element) : strlen(element);
+	}
+
+	IO::StrongRef<IO::String> Path::CopyElement(char *element, size_t length)
+	{
+		char temp = element[length];
+		element[length] = '\0';
+
+		IO::StrongRef<IO::String> name = IOTransferRef(IO::String::Alloc()->InitWithCString(element));
+
+		element[length] = temp;
+		return name;
+	}
+
+	IO::StrongRef<IO::String> Path::GetCurrentName()
+	{
+		if(!_name)
+			return nullptr;
+
+		return CopyElement(_name, _nameLength);
+	}
+
 	IO::StrongRef<IO::String> Path::GetNextName()
 	{
 		while(*_element == '/')
 			_element ++;
 
-		// Get the name of the element
-		char *element = strpbrk(_element, "/");
-		size_t offset = 0;
+		return CopyElement(_element, GetElementLength(_element));
+	}
 
-		if(element)
+	KernReturn<IO::StrongRef<Node>> Path::LookUpElement(size_t length)
+	{
+		Instance *instance = _node->GetInstance();
+
+		if(!_node->IsDirectory())
 		{
-			offset = element - _element;
-			_element[offset] = '\0';
+			char temp = _element[length];
+			_element[length] = '\0';
+
+			KernReturn<IO::StrongRef<Node>> result = instance->LookUpNode(_context, _node, _element);
+
+			_element[length] = temp;
+			return result;
 		}
 
-		IO::StrongRef<IO::String> name = IOTransferRef(IO::String::Alloc()->InitWithCString(_element));
+		Directory *directory = _node->Downcast<Directory>();
+		DentryName name(_element, length);
 
-		if(element)
-			_element[offset] = '/';
+		IO::StrongRef<Node> node;
+		uint32_t sequence;
 
-		return name;
+		if(DentryLookup(directory, name, node, sequence))
+		{
+			if(!node)
+				return Error(KERN_RESOURCES_MISSING);
+
+			return node;
+		}
+
+		char temp = _element[length];
+		_element[length] = '\0';
+
+		KernReturn<IO::StrongRef<Node>> result = instance->LookUpNode(_context, _node, _element);
+
+		_element[length] = temp;
+
+		if(result.IsValid())
+			DentryInsert(directory, name, result.Get(), sequence);
+		else if(result.GetError().GetCode() == KERN_RESOURCES_MISSING)
+			DentryInsert(directory, name, nullptr, sequence);
+
+		return result;
 	}
 
 	KernReturn<Node *> Path::ResolveElement()
@@ -102,30 +161,15 @@ namespace VFS
 		while(*_element == '/')
 			_element ++;
 
-		// Get the name of the element
-		char *element = strpbrk(_element, "/");
-		size_t offset = 0;
+		size_t length = GetElementLength(_element);
 
-		if(element)
-		{
-			offset = element - _element;
-			_element[offset] = '\0';
-		}
-		
-		_name = IOTransferRef(IO::String::Alloc()->InitWithCString(_element));
+		_name = _element;
+		_nameLength = length;
 		
 		// Look up the next node
-		Instance *instance = _node->GetInstance();
-
-		KernReturn<IO::StrongRef<Node>> result = instance->LookUpNode(_context, _node, _name->GetCString());
+		KernReturn<IO::StrongRef<Node>> result = LookUpElement(length);
 		if(!result.IsValid())
-		{
-			// Revert to the old state and bail
-			if(element)
-				_element[offset] = '/';
-
 			return result.GetError();
-		}
 
 		_node = result;
 
@@ -135,7 +179,7 @@ namespace VFS
 			_node = _node->Downcast<Mountpoint>()->GetLinkedNode();
 
 		// Advance to the next element
-		_element += offset + 1;
+		_element += length;
 		_elementsLeft --;
 
 		return _node.Load();
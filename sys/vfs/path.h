@@ -21,6 +21,7 @@
 
 #include <prefix.h>
 #include <kern/kern_return.h>
+#include <libc/sys/unistd.h>
 #include "node.h"
 #include "context.h"
 
@@ -37,7 +38,7 @@ namespace VFS
 		~Path();
 
 		IO::StrongRef<Node> GetCurrentNode() const { return _node; }
-		IO::StrongRef<IO::String> GetCurrentName() const { return _name; }
+		IO::StrongRef<IO::String> GetCurrentName(); // Name of the last element ResolveElement() looked at
 		IO::StrongRef<IO::String> GetNextName();
 
 		size_t GetElementsLeft() const { return _elementsLeft; }
@@ -46,16 +47,22 @@ namespace VFS
 		KernReturn<Node *> ResolveElement();
 
 	private:
+		KernReturn<IO::StrongRef<Node>> LookUpElement(size_t length);
+		IO::StrongRef<IO::String> CopyElement(char *element, size_t length);
+
 		char *_path;
 		char *_element;
+		char *_name;
+		size_t _nameLength;
 
 		Context *_context;
 
-		IO::StrongRef<IO::String> _name;
 		IO::StrongRef<Node> _node;
 
 		size_t _totalElements;
 		size_t _elementsLeft;
+
+		char _buffer[MAXNAME]; // Avoids allocating for common path lengths
 	};
 }
 
@@ -20,16 +20,25 @@
 #include <kern/kalloc.h>
 #include <kern/kprintf.h>
 #include <libc/string.h>
+#include <libc/stdio.h>
 #include <libcpp/vector.h>
 #include <os/scheduler/scheduler.h>
+#include <os/ipc/IPCStatistics.h>
+#include <os/syscall/syscall_statistics.h>
 
 #include "vfs.h"
 #include "path.h"
 #include "file.h"
+#include "page_cache.h"
+#include "initrd.h"
+#include "writeback.h"
 
 #include <vfs/ffs/ffs_descriptor.h>
 #include <vfs/cfs/cfs_descriptor.h>
 #include <vfs/devfs/devices.h>
+#include <vfs/efs/efs_descriptor.h>
+#include <vfs/efs/efs_instance.h>
+#include <vfs/block/block_device.h>
 
 #include <bootstrap/multiboot.h>
 
@@ -89,14 +98,10 @@ namespace VFS
 	KernReturn<int> Open(Context *context, const char *path, int flags)
 	{
 		OS::Task *task = context->GetTask();
-		task->Lock();
 
 		int fd = task->AllocateFileDescriptor();
 		if(fd == -1)
-		{
-			task->Unlock();
 			return Error(KERN_NO_MEMORY);
-		}
 
 		Path resolver(path, context);
 
@@ -107,8 +112,6 @@ namespace VFS
 			if(result.IsValid() == false)
 			{
 				task->FreeFileDescriptor(fd);
-				task->Unlock();
-
 				return result.GetError();
 			}
 		}
@@ -121,8 +124,6 @@ namespace VFS
 			if(flags & O_EXCL)
 			{
 				task->FreeFileDescriptor(fd);
-				task->Unlock();
-
 				return Error(KERN_RESOURCE_EXISTS);
 			}
 
@@ -132,22 +133,23 @@ namespace VFS
 			if(!file.IsValid())
 			{
 				task->FreeFileDescriptor(fd);
-				task->Unlock();
-
 				return file.GetError();
 			}
 
-			task->SetFileForDescriptor(file, fd);
-			task->Unlock();
+			if(flags & O_TRUNC)
+			{
+				PageCache *cache = node->GetPageCache(false);
+				if(cache)
+					cache->RefreshAll();
+			}
 
+			task->SetFileForDescriptor(file, fd);
 			return fd;
 		}
 
 		if(resolver.GetTotalElements() == 0)
 		{
 			task->FreeFileDescriptor(fd);
-			task->Unlock();
-
 			return Error(KERN_INVALID_ARGUMENT, ENOENT);
 		}
 
@@ -159,8 +161,6 @@ namespace VFS
 			if(!node.IsValid())
 			{	
 				task->FreeFileDescriptor(fd);
-				task->Unlock();
-
 				return node.GetError();
 			}
 
@@ -169,157 +169,345 @@ namespace VFS
 			if(!file.IsValid())
 			{
 				task->FreeFileDescriptor(fd);
-				task->Unlock();
-
 				return file.GetError();
 			}
 
 			task->SetFileForDescriptor(file, fd);
-			task->Unlock();
-
 			return fd;
 		}
 
 		task->FreeFileDescriptor(fd);
-		task->Unlock();
-
 		return Error(KERN_RESOURCES_MISSING, ENOENT);
 	}
 	KernReturn<void> Close(Context *context, int fd)
 	{
 		OS::Task *task = context->GetTask();
-
-		task->Lock();
-
-		File *file = task->GetFileForDescriptor(fd);
+		File *file = task->RemoveFileForDescriptor(fd);
 
 		if(!file)
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT, EBADF);
-		}
 
 		Node *node = file->GetNode();
 		Instance *instance = node->GetInstance();
 
+		// Start writing the file back, without making close wait for it
+		PageCache *cache = node->GetPageCache(false);
+		if(cache && cache->IsDirty())
+			WritebackKick();
+
 		instance->CloseFile(context, file);
-		task->FreeFileDescriptor(fd);
-		task->Unlock();
+		file->Release();
 
 		return ErrorNone;
 	}
 
 
-	KernReturn<size_t> Write(Context *context, int fd, const void *data, size_t size)
+	// Shared implementation of the read and write family. Transfers the vector in order and stops at the first
+	// short transfer. If position is null, the transfer starts at and advances the file offset, otherwise the
+	// offset is left untouched.
+	static KernReturn<size_t> FileTransfer(Context *context, int fd, const iovec *vector, int count, const off_t *position, bool write)
 	{
 		OS::Task *task = context->GetTask();
-		task->Lock();
 
-		File *file = task->GetFileForDescriptor(fd);
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
+		int mode = write ? O_WRONLY : O_RDONLY;
 
-		if(!file || !(file->GetFlags() & O_WRONLY || file->GetFlags() & O_RDWR))
-		{
-			task->Unlock();
+		if(!file || !(file->GetFlags() & mode || file->GetFlags() & O_RDWR))
 			return Error(KERN_INVALID_ARGUMENT, EBADF);
-		}
 		
 		Node *node = file->GetNode();
 		if(node->IsDirectory())
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT, EISDIR);
-		}
 
 		Instance *instance = node->GetInstance();
-		KernReturn<size_t> result = instance->FileWrite(context, node, file->GetOffset(), data, size);
+		PageCache *cache = instance->UsesPageCache() ? node->GetPageCache(true) : nullptr;
 
-		if(!result.IsValid())
+		// Positioned transfers leave the offset alone and don't need to serialize on it
+		if(!position)
+			file->Lock();
+
+		off_t offset = position ? *position : file->GetOffset();
+		size_t total = 0;
+
+		for(int i = 0; i < count; i ++)
 		{
-			task->Unlock();
-			return result.GetError();
-		}
+			if(vector[i].iov_len == 0)
+				continue;
 
-		file->SetOffset(result.Get() + file->GetOffset());
-		task->Unlock();
+			KernReturn<size_t> result;
 
-		return result.Get();
-	}
+			if(cache)
+				result = write ?
+					cache->Write(context, offset, vector[i].iov_base, vector[i].iov_len) :
+					cache->Read(context, offset, vector[i].iov_base, vector[i].iov_len);
+			else
+				result = write ?
+					instance->FileWrite(context, node, offset, vector[i].iov_base, vector[i].iov_len) :
+					instance->FileRead(context, node, offset, vector[i].iov_base, vector[i].iov_len);
 
-	KernReturn<size_t> Read(Context *context, int fd, void *data, size_t size)
-	{
-		OS::Task *task = context->GetTask();
-		task->Lock();
+			if(!result.IsValid())
+			{
+				// Report the partial transfer, the error surfaces again on the next call
+				if(total > 0)
+					break;
 
-		File *file = task->GetFileForDescriptor(fd);
+				if(!position)
+					file->Unlock();
 
-		if(!file || !(file->GetFlags() & O_RDONLY || file->GetFlags() & O_RDWR))
-		{
-			task->Unlock();
-			return Error(KERN_INVALID_ARGUMENT, EBADF);
+				return result.GetError();
+			}
+
+			size_t transferred = result.Get();
+
+			if(write && !cache)
+			{
+				// Keep the pages of shared mappings coherent with the file
+				PageCache *mapped = node->GetPageCache(false);
+				if(mapped)
+					mapped->Refresh(offset, transferred);
+			}
+
+			offset += transferred;
+			total += transferred;
+
+			if(transferred < vector[i].iov_len)
+				break;
 		}
-		
-		Node *node = file->GetNode();
-		if(node->IsDirectory())
+
+		if(!position)
 		{
-			task->Unlock();
-			return Error(KERN_INVALID_ARGUMENT, EISDIR);
+			size_t first;
+			size_t count = 0;
+
+			if(cache && !write && total > 0)
+				count = file->UpdateReadahead(file->GetOffset(), total, first);
+
+			file->SetOffset(offset);
+			file->Unlock();
+
+			if(count > 0)
+				cache->Readahead(first, count);
 		}
 
-		Instance *instance = node->GetInstance();
-		KernReturn<size_t> result = instance->FileRead(context, node, file->GetOffset(), data, size);
+		return total;
+	}
+
+	static KernReturn<size_t> VectorTransfer(Context *context, int fd, const iovec *userVector, int count, bool write)
+	{
+		if(count <= 0 || count > IOV_MAX)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		iovec vector[IOV_MAX];
 
+		KernReturn<void> result = context->CopyDataOut(userVector, vector, count * sizeof(iovec));
 		if(!result.IsValid())
+			return Error(KERN_INVALID_ADDRESS, EFAULT);
+
+		// The transferred size is returned through a register that also carries -1 on error
+		size_t total = 0;
+		for(int i = 0; i < count; i ++)
 		{
-			task->Unlock();
-			return result.GetError();
+			if(vector[i].iov_len > static_cast<size_t>(INT32_MAX) - total)
+				return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+			total += vector[i].iov_len;
 		}
 
-		file->SetOffset(result.Get() + file->GetOffset());
-		task->Unlock();
+		return FileTransfer(context, fd, vector, count, nullptr, write);
+	}
+
+
+	KernReturn<size_t> Write(Context *context, int fd, const void *data, size_t size)
+	{
+		iovec vector = { const_cast<void *>(data), size };
+		return FileTransfer(context, fd, &vector, 1, nullptr, true);
+	}
 
-		return result.Get();
+	KernReturn<size_t> Read(Context *context, int fd, void *data, size_t size)
+	{
+		iovec vector = { data, size };
+		return FileTransfer(context, fd, &vector, 1, nullptr, false);
+	}
+
+	KernReturn<size_t> WriteAt(Context *context, int fd, const void *data, size_t size, off_t offset)
+	{
+		if(offset < 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		iovec vector = { const_cast<void *>(data), size };
+		return FileTransfer(context, fd, &vector, 1, &offset, true);
+	}
+
+	KernReturn<size_t> ReadAt(Context *context, int fd, void *data, size_t size, off_t offset)
+	{
+		if(offset < 0)
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		iovec vector = { data, size };
+		return FileTransfer(context, fd, &vector, 1, &offset, false);
+	}
+
+	KernReturn<size_t> WriteVector(Context *context, int fd, const iovec *vector, int count)
+	{
+		return VectorTransfer(context, fd, vector, count, true);
+	}
+
+	KernReturn<size_t> ReadVector(Context *context, int fd, const iovec *vector, int count)
+	{
+		return VectorTransfer(context, fd, vector, count, false);
 	}
 
 	KernReturn<off_t> ReadDir(Context *context, int fd, dirent *entry, size_t count)
 	{
 		OS::Task *task = context->GetTask();
-		task->Lock();
-
-		File *file = task->GetFileForDescriptor(fd);
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
 
 		if(!file || !(file->GetFlags() & O_RDONLY || file->GetFlags() & O_RDWR))
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT, EBADF);
-		}
 		
 		Node *node = file->GetNode();
 		Instance *instance = node->GetInstance();
 
+		file->Lock();
 		KernReturn<off_t> result = instance->DirRead(context, entry, file, count);
-		task->Unlock();
+		file->Unlock();
 
 		return result;
 	}
 
-	KernReturn<off_t> Seek(Context *context, int fd, off_t offset, int whence)
+	KernReturn<size_t> ReadDirRecords(Context *context, int fd, void *data, size_t size)
 	{
 		OS::Task *task = context->GetTask();
-		task->Lock();
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
+
+		if(!file || !(file->GetFlags() & O_RDONLY || file->GetFlags() & O_RDWR))
+			return Error(KERN_INVALID_ARGUMENT, EBADF);
+
+		if(!file->GetNode()->IsDirectory())
+			return Error(KERN_INVALID_ARGUMENT, ENOTDIR);
 
-		File *file = task->GetFileForDescriptor(fd);
+		// The entries are a snapshot taken at open, so the index is a stable cookie and resuming is O(1)
+		FileDirectory *directory = static_cast<FileDirectory *>(file.Load());
+		uint8_t *target = static_cast<uint8_t *>(data);
 
-		if(!file)
+		uint8_t buffer[1024];
+		size_t buffered = 0;
+		size_t written = 0;
+
+		KernReturn<void> result;
+
+		file->Lock();
+
+		const dirent *entries = directory->GetEntries();
+		size_t index = directory->GetOffset();
+		size_t copied = index; // Entries below this index reached the caller
+
+		for(; index < directory->GetCount(); index ++)
 		{
-			task->Unlock();
-			return Error(KERN_INVALID_ARGUMENT, EBADF);
+			const dirent &entry = entries[index];
+
+			size_t length = offsetof(dirent_record, name) + strlen(entry.name) + 1;
+			length = (length + alignof(dirent_record) - 1) & ~(alignof(dirent_record) - 1);
+
+			if(written + buffered + length > size)
+				break;
+
+			if(buffered + length > sizeof(buffer))
+			{
+				result = context->CopyDataIn(buffer, target + written, buffered);
+				if(!result.IsValid())
+					break;
+
+				written += buffered;
+				buffered = 0;
+				copied = index;
+			}
+
+			dirent_record *record = reinterpret_cast<dirent_record *>(buffer + buffered);
+
+			record->id = entry.id;
+			record->cookie = index + 1;
+			record->length = static_cast<unsigned short>(length);
+			record->type = static_cast<unsigned char>(entry.type);
+
+			// The name runs past the declared array, address it through the record buffer
+			char *name = reinterpret_cast<char *>(record) + offsetof(dirent_record, name);
+			strlcpy(name, entry.name, length - offsetof(dirent_record, name));
+
+			buffered += length;
+		}
+
+		if(result.IsValid() && buffered > 0)
+		{
+			result = context->CopyDataIn(buffer, target + written, buffered);
+
+			if(result.IsValid())
+			{
+				written += buffered;
+				copied = index;
+			}
 		}
 
+		directory->SetOffset(copied);
+		file->Unlock();
+
+		if(!result.IsValid() && written == 0)
+			return result.GetError();
+		if(written == 0 && copied < directory->GetCount())
+			return Error(KERN_INVALID_ARGUMENT, EINVAL); // Buffer too small for the next record
+
+		return written;
+	}
+
+	// Directory offsets are indices into the snapshot and independent of the file system
+	static KernReturn<off_t> SeekDirectory(FileDirectory *directory, off_t offset, int whence)
+	{
+		off_t target;
+
+		switch(whence)
+		{
+			case SEEK_SET:
+				target = offset;
+				break;
+			case SEEK_CUR:
+				target = directory->GetOffset() + offset;
+				break;
+			case SEEK_END:
+				target = directory->GetCount() + offset;
+				break;
+
+			default:
+				return Error(KERN_INVALID_ARGUMENT, EINVAL);
+		}
+
+		if(target < 0 || static_cast<size_t>(target) > directory->GetCount())
+			return Error(KERN_INVALID_ARGUMENT, EINVAL);
+
+		directory->SetOffset(target);
+		return target;
+	}
+
+	KernReturn<off_t> Seek(Context *context, int fd, off_t offset, int whence)
+	{
+		OS::Task *task = context->GetTask();
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
+
+		if(!file)
+			return Error(KERN_INVALID_ARGUMENT, EBADF);
+
 		Node *node = file->GetNode();
 		Instance *instance = node->GetInstance();
 
-		KernReturn<off_t> result = instance->FileSeek(context, file, offset, whence);
-		task->Unlock();
+		file->Lock();
+
+		KernReturn<off_t> result;
+
+		if(node->IsDirectory())
+			result = SeekDirectory(static_cast<FileDirectory *>(file.Load()), offset, whence);
+		else
+			result = instance->FileSeek(context, file, offset, whence);
+
+		file->Unlock();
 
 		return result;
 	}
@@ -386,23 +574,23 @@ namespace VFS
 	KernReturn<void> Ioctl(Context *context, int fd, uint32_t request, void *arg)
 	{
 		OS::Task *task = context->GetTask();
-		task->Lock();
-
-		File *file = task->GetFileForDescriptor(fd);
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
 
 		if(!file)
-		{
-			task->Unlock();
 			return Error(KERN_INVALID_ARGUMENT, EBADF);
-		}
 
 		Node *node = file->GetNode();
 		Instance *instance = node->GetInstance();
 
-		KernReturn<void> result = instance->Ioctl(context, file, request, arg);
-		task->Unlock();
+		return instance->Ioctl(context, file, request, arg);
+	}
 
-		return result;
+	IO::StrongRef<Node> GetNode(Context *context, int fd)
+	{
+		OS::Task *task = context->GetTask();
+		IO::StrongRef<File> file = task->GetFileForDescriptor(fd);
+
+		return file ? file->GetNode() : nullptr;
 	}
 
 
@@ -472,66 +660,47 @@ namespace VFS
 
 
 
-	KernReturn<void> LoadInitrdModule(uint8_t *buffer, uint8_t *end)
+	// Only the volatile RAM disk gets formatted implicitly, disks are mounted if they already carry an EFS
+	static void MountBlockDevice(EFS::Descriptor *efs, const char *name, bool format)
 	{
-		Context *context = Context::GetKernelContext();
-
-		kprintf("loading initrd (%u bytes)... ", end - buffer);
+		IO::StrongRef<Block::Device> device = Block::GetDevice(name);
+		if(!device)
+			return;
 
-		while(buffer < end)
+		if(!EFS::Instance::IsFormatted(device))
 		{
-			// Read the file header
-			uint32_t nameLength, binaryLength;
-
-			memcpy(&nameLength, buffer + 0, 4);
-			memcpy(&binaryLength, buffer + 4, 4);
-
-			buffer += 8;
-
-			// Read the filename
-			char *name = static_cast<char *>(kalloc(nameLength + 1));
-			memcpy(name, buffer, nameLength);
-
-			name[nameLength] = '\0';
-			buffer += nameLength;
-
-			// Create the file
-			KernReturn<int> fd = Open(context, name, O_WRONLY | O_CREAT);
-
-			if(fd.IsValid())
+			if(!format)
 			{
-				size_t left = binaryLength;
-				while(left > 0)
-				{
-					KernReturn<size_t> written = Write(context, fd, buffer, left);
-
-					if(!written.IsValid())
-					{
-						kprintf("Failed to write %s\n", name);
-
-						buffer += left;
-						break;
-					}
-
-					left   -= written;
-					buffer += written;
-				}
-
-				Close(context, fd);
+				kprintf("Not mounting %s, unknown file system\n", name);
+				return;
 			}
-			else
+
+			KernReturn<void> result = EFS::Instance::Format(device);
+			if(!result.IsValid())
 			{
-				kprintf("Couldn't open %s to write\n", name);
-				buffer += binaryLength;
+				kprintf("Couldn't format %s\n", name);
+				return;
 			}
+		}
 
-			kfree(name);
+		KernReturn<Instance *> instance = efs->CreateInstance(device);
+		if(!instance.IsValid())
+		{
+			kprintf("Couldn't create instance for %s\n", name);
+			return;
 		}
 
-		kprintf("done");
-		return ErrorNone;
+		char path[32];
+		sprintf(path, "/mnt/%s", name);
+
+		KernReturn<void> result = MakeDirectory(Context::GetKernelContext(), path);
+		if(result.IsValid())
+			result = Mount(Context::GetKernelContext(), instance, path);
+
+		if(!result.IsValid())
+			kprintf("Couldn't mount %s\n", path);
 	}
-	
+
 	KernReturn<void> Init()
 	{
 		_descriptors = IO::Array::Alloc()->Init();
@@ -539,6 +708,10 @@ namespace VFS
 		if(!_descriptors)
 			return Error(KERN_NO_MEMORY);
 
+		KernReturn<void> writeback = WritebackInit();
+		if(!writeback.IsValid())
+			return writeback;
+
 		Descriptor *ffs = FFS::Descriptor::Alloc()->Init();
 
 		if(!ffs)
@@ -627,10 +800,41 @@ namespace VFS
 
 			_devFS = instance->Downcast<CFS::Instance>();
 			_devFS->CreateNode("null", nullptr, &DevNullRead, &DevNullWrite).Suppress();
+			_devFS->CreateNode("ipcstat", nullptr, &OS::IPC::StatisticsRead, nullptr).Suppress();
+			_devFS->CreateNode("syscallstat", nullptr, &OS::SyscallStatisticsRead, nullptr).Suppress();
+			_devFS->CreateNode("strace", nullptr, &OS::SyscallTraceRead, &OS::SyscallTraceWrite).Suppress();
 
 			VFS::Devices::Init();
 		}
 
+		// Block devices, each formatted with EFS and mounted below /mnt
+		{
+			EFS::Descriptor *efs = EFS::Descriptor::Alloc()->Init();
+			if(!efs)
+			{
+				kprintf("Failed to create EFS");
+				return Error(KERN_FAILURE);
+			}
+
+			if((result = MakeDirectory(Context::GetKernelContext(), "/mnt")).IsValid() == false)
+				return result;
+
+			if(Block::Init().IsValid())
+			{
+				MountBlockDevice(efs, "ram0", true);
+
+				for(int i = 0; i < 4; i ++)
+				{
+					char name[16];
+					sprintf(name, "ata%d", i);
+
+					MountBlockDevice(efs, name, false);
+				}
+			}
+			else
+				kprintf("Failed to initialize block devices");
+		}
+
 #if 0
 		DumpFS();
 #endif
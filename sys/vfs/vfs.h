@@ -26,6 +26,7 @@
 #include <libc/sys/types.h>
 #include <libc/sys/unistd.h>
 #include <libc/sys/dirent.h>
+#include <libc/sys/uio.h>
 #include <kern/kern_return.h>
 #include "cfs/cfs_instance.h"
 
@@ -47,14 +48,22 @@ namespace VFS
 	KernReturn<size_t> Read(Context *context, int fd, void *data, size_t size);
 	KernReturn<off_t> Seek(Context *context, int fd, off_t offset, int whence);
 
+	KernReturn<size_t> WriteAt(Context *context, int fd, const void *data, size_t size, off_t offset);
+	KernReturn<size_t> ReadAt(Context *context, int fd, void *data, size_t size, off_t offset);
+	KernReturn<size_t> WriteVector(Context *context, int fd, const iovec *vector, int count);
+	KernReturn<size_t> ReadVector(Context *context, int fd, const iovec *vector, int count);
+
 	KernReturn<void> MakeDirectory(Context *context, const char *path);
 	KernReturn<off_t> ReadDir(Context *context, int fd, dirent *entry, size_t count);
+	KernReturn<size_t> ReadDirRecords(Context *context, int fd, void *data, size_t size); // Packed dirent_records, as many as fit
 
 	KernReturn<void> Mount(Context *context, Instance *instance, const char *target);
 	KernReturn<void> Unmount(Context *context, const char *path);
 
 	KernReturn<void> Ioctl(Context *context, int fd, uint32_t request, void *arg);
 
+	IO::StrongRef<Node> GetNode(Context *context, int fd); // nullptr if fd isn't open
+
 	KernReturn<void> Init();
 }
 
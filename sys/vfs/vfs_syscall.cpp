@@ -76,6 +76,46 @@ namespace VFS
 		return static_cast<uint32_t>(result.Get());
 	}
 
+	KernReturn<uint32_t> Syscall_VFSPwrite(OS::Thread *thread, VFSPwriteArgs *arguments)
+	{
+		KernReturn<size_t> result = WriteAt(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->data, arguments->size, arguments->offset);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return result.Get();
+	}
+
+	KernReturn<uint32_t> Syscall_VFSPread(OS::Thread *thread, VFSPreadArgs *arguments)
+	{
+		KernReturn<size_t> result = ReadAt(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->data, arguments->size, arguments->offset);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return result.Get();
+	}
+
+	KernReturn<uint32_t> Syscall_VFSWritev(OS::Thread *thread, VFSVectorArgs *arguments)
+	{
+		KernReturn<size_t> result = WriteVector(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->vector, arguments->count);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return result.Get();
+	}
+
+	KernReturn<uint32_t> Syscall_VFSReadv(OS::Thread *thread, VFSVectorArgs *arguments)
+	{
+		KernReturn<size_t> result = ReadVector(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->vector, arguments->count);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return result.Get();
+	}
+
 	KernReturn<uint32_t> Syscall_VFSIoctl(OS::Thread *thread, VFSIoctlArgs *arguments)
 	{
 		KernReturn<void> result = Ioctl(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->request, arguments->arg);
@@ -85,4 +125,14 @@ namespace VFS
 
 		return 0;
 	}
+
+	KernReturn<uint32_t> Syscall_VFSGetdents(OS::Thread *thread, VFSReadArgs *arguments)
+	{
+		KernReturn<size_t> result = ReadDirRecords(thread->GetTask()->GetVFSContext(), arguments->fd, arguments->data, arguments->size);
+
+		if(!result.IsValid())
+			return result.GetError();
+
+		return result.Get();
+	}
 }
@@ -53,6 +53,29 @@ namespace VFS
 		int whence;
 	} __attribute__((packed));
 
+	struct VFSPwriteArgs
+	{
+		int fd;
+		const void *data;
+		size_t size;
+		off_t offset;
+	} __attribute__((packed));
+
+	struct VFSPreadArgs
+	{
+		int fd;
+		void *data;
+		size_t size;
+		off_t offset;
+	} __attribute__((packed));
+
+	struct VFSVectorArgs
+	{
+		int fd;
+		const iovec *vector;
+		int count;
+	} __attribute__((packed));
+
 	struct VFSIoctlArgs
 	{
 		int fd;
@@ -65,5 +88,10 @@ namespace VFS
 	KernReturn<uint32_t> Syscall_VFSWrite(OS::Thread *thread, VFSWriteArgs *arguments);
 	KernReturn<uint32_t> Syscall_VFSRead(OS::Thread *thread, VFSReadArgs *arguments);
 	KernReturn<uint32_t> Syscall_VFSSeek(OS::Thread *thread, VFSSeekArgs *arguments);
+	KernReturn<uint32_t> Syscall_VFSPwrite(OS::Thread *thread, VFSPwriteArgs *arguments);
+	KernReturn<uint32_t> Syscall_VFSPread(OS::Thread *thread, VFSPreadArgs *arguments);
+	KernReturn<uint32_t> Syscall_VFSWritev(OS::Thread *thread, VFSVectorArgs *arguments);
+	KernReturn<uint32_t> Syscall_VFSReadv(OS::Thread *thread, VFSVectorArgs *arguments);
 	KernReturn<uint32_t> Syscall_VFSIoctl(OS::Thread *thread, VFSIoctlArgs *arguments);
+	KernReturn<uint32_t> Syscall_VFSGetdents(OS::Thread *thread, VFSReadArgs *arguments);
 }
\ No newline at end of file
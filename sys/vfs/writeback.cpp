@@ -0,0 +1,142 @@
+//
+//  writeback.cpp
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2015 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libc/sys/spinlock.h>
+#include <libcpp/atomic.h>
+#include <libio/core/IOArray.h>
+#include <kern/kprintf.h>
+#include <os/waitqueue.h>
+#include <os/scheduler/scheduler.h>
+#include "writeback.h"
+#include "page_cache.h"
+#include "node.h"
+
+namespace VFS
+{
+	static constexpr size_t kWritebackBatch = 64; // Dirty pages that wake up the writeback thread
+
+	static spinlock_t _writebackLock = SPINLOCK_INIT;
+	static IO::Array *_writebackNodes; // Nodes with dirty pages, retained until they were flushed
+	static bool _writebackRequested;
+	static std::atomic<size_t> _writebackPending;
+	static std::atomic<bool> _writebackStarted;
+
+	static void WritebackThread()
+	{
+		while(1)
+		{
+			spinlock_lock(&_writebackLock);
+
+			if(!_writebackRequested)
+			{
+				KernReturn<void> result = OS::WaitWithCallback(&_writebackNodes, [] {
+					spinlock_unlock(&_writebackLock);
+				});
+
+				// A refused wait never runs the callback, the lock is still ours
+				if(!result.IsValid())
+				{
+					spinlock_unlock(&_writebackLock);
+
+					OS::Scheduler *scheduler = OS::Scheduler::GetScheduler();
+					scheduler->YieldThread(scheduler->GetActiveThread());
+				}
+
+				continue;
+			}
+
+			IO::Array *nodes = _writebackNodes;
+
+			_writebackNodes = IO::Array::Alloc()->Init();
+			_writebackRequested = false;
+
+			if(!_writebackNodes)
+			{
+				// Keep the old list and retry on the next kick
+				_writebackNodes = nodes;
+				spinlock_unlock(&_writebackLock);
+
+				continue;
+			}
+
+			spinlock_unlock(&_writebackLock);
+
+			nodes->Enumerate<Node>([](Node *node, __unused size_t index, __unused bool &stop) {
+
+				PageCache *cache = node->GetPageCache(false);
+				KernReturn<void> result = cache->Flush();
+
+				if(!result.IsValid())
+				{
+					kprintf("Writeback of %s failed\n", node->GetName()->GetCString());
+					WritebackMarkDirty(node, 0);
+				}
+
+			});
+
+			nodes->Release();
+		}
+	}
+
+	void WritebackMarkDirty(Node *node, size_t pages)
+	{
+		spinlock_lock(&_writebackLock);
+
+		if(_writebackNodes->GetIndexOfObject(node) == IO::kNotFound)
+			_writebackNodes->AddObject(node);
+
+		spinlock_unlock(&_writebackLock);
+
+		if(_writebackPending.fetch_add(pages) + pages >= kWritebackBatch)
+			WritebackKick();
+	}
+
+	void WritebackKick()
+	{
+		_writebackPending = 0;
+
+		// The thread is started lazily, the first writes happen long after the scheduler came up
+		bool started = false;
+		if(_writebackStarted.compare_exchange(started, true))
+		{
+			OS::Task *task = OS::Scheduler::GetScheduler()->GetKernelTask();
+			KernReturn<OS::Thread *> thread = task->AttachThread(reinterpret_cast<OS::Thread::Entry>(&WritebackThread), OS::Thread::PriorityClassKernel, 16, nullptr);
+
+			if(!thread.IsValid())
+			{
+				_writebackStarted = false;
+				return;
+			}
+		}
+
+		spinlock_lock(&_writebackLock);
+		_writebackRequested = true;
+		spinlock_unlock(&_writebackLock);
+
+		OS::Wakeup(&_writebackNodes);
+	}
+
+	KernReturn<void> WritebackInit()
+	{
+		_writebackNodes = IO::Array::Alloc()->Init();
+		if(!_writebackNodes)
+			return Error(KERN_NO_MEMORY);
+
+		return ErrorNone;
+	}
+}